@@ -0,0 +1,131 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "curlcxx_stream.h"
+
+namespace libcurlcxx
+{
+	// curl_base_block_pool : curl_base_chunk_streamで使う固定サイズのブロックの再利用プール
+	//
+	// ブロックはストリームが破棄・clearされたときにここへ返され、次のストリームで使い回される
+	// 複数のスレッドのストリームから同時に使ってもよい
+	// 注意：必ずstd::make_shared<>で作成すること
+	class curl_base_block_pool
+	{
+	private:
+		std::mutex									lk;				// freeblocksの保護用
+		std::vector<std::unique_ptr<uint8_t[]>>		freeblocks;		// 返却されて空いているブロック
+		const size_t								block_size;		// ブロック1つのバイト数
+		const size_t								max_free;		// freeblocksに保持しておく最大数
+
+		// コピー禁止
+		curl_base_block_pool &operator=(curl_base_block_pool const &) = delete;
+		curl_base_block_pool(curl_base_block_pool const &) = delete;
+
+	public:
+		// 1ブロックのデフォルトのサイズ(バイト)
+		static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+		explicit curl_base_block_pool(size_t _block_size = DEFAULT_BLOCK_SIZE, size_t _max_free = 1024);
+		~curl_base_block_pool() noexcept{}
+
+		std::unique_ptr<uint8_t[]> acquire();
+		void release(std::unique_ptr<uint8_t[]> &&block) noexcept;
+
+		// プロセス全体で共有するデフォルトのプール
+		static const std::shared_ptr<curl_base_block_pool> &get_default();
+
+		// ブロック1つのバイト数を返す
+		inline size_t get_block_size() const noexcept	{ return block_size;}
+		// プールで待機しているブロック数を返す
+		inline size_t get_free_count()
+		{
+			std::lock_guard<std::mutex> lock(lk);
+			return freeblocks.size();
+		}
+	};
+
+	// 受信したデータを固定サイズのブロックのチェーンに貯めるストリームクラス
+	//
+	// curl_base_bytestreamはresizeで伸ばしていくため、新しい領域のゼロ埋めと、容量が足りなくなるたびの再確保とそれまでの全データのコピーが発生する
+	// このクラスはブロックが埋まったら次のブロックをプールから持ってきてつなげるだけなので、一度書いたデータは二度とコピーされない
+	// 受信したデータはget_spans / for_each_spanでブロックごとのspanとして読める
+	// どうしても連続したメモリが必要な場合はflattenを呼ぶと、一度だけ全体を1つのバッファにまとめる
+	class curl_base_chunk_stream : public curl_base_stream_object
+	{
+	private:
+		std::shared_ptr<curl_base_block_pool>		pool;			// ブロックの借り先
+		std::vector<std::unique_ptr<uint8_t[]>>		blocks;			// 受信データのチェーン
+		size_t										tail_used;		// 最後のブロックの使用済みバイト数
+		std::unique_ptr<uint8_t[]>					flat;			// flattenでまとめたデータ
+		size_t										flat_size;		// flatのバイト数
+		size_t										total_size;		// 受信した全体のバイト数
+
+		size_t internal_write(char *buffer, size_t realsize);
+		static size_t _callback_func(char *buffer, size_t size, size_t nitems, void *outstream);
+
+		void release_blocks() noexcept;
+
+		// コピー禁止
+		curl_base_chunk_stream &operator=(curl_base_chunk_stream const &) = delete;
+		curl_base_chunk_stream(curl_base_chunk_stream const &) = delete;
+
+	public:
+		curl_base_chunk_stream();
+		explicit curl_base_chunk_stream(const std::shared_ptr<curl_base_block_pool> &_pool);
+		virtual ~curl_base_chunk_stream();
+
+		std::vector<std::span<const uint8_t>> get_spans() const;
+		std::span<const uint8_t> flatten();
+		void clear() noexcept;
+
+		virtual std::string get_string() const &;
+		virtual void set_expected_size(size_t size);
+
+		// 受信したデータをspanごとに先頭から順にfuncに渡す
+		// func: void(std::span<const uint8_t>)の形の関数
+		template<class F> void for_each_span(F &&func) const
+		{
+			if(flat_size != 0) func(std::span<const uint8_t>(flat.get(), flat_size));
+			const size_t bsize = pool->get_block_size();
+			for(size_t i = 0; i < blocks.size(); i++){
+				const size_t len = (i + 1 == blocks.size()) ? tail_used : bsize;
+				if(len != 0) func(std::span<const uint8_t>(blocks[i].get(), len));
+			}
+		}
+
+		// 受信したデータの全体のバイト数を返す
+		inline size_t size() const noexcept		{ return total_size;}
+		// 受信したデータがあるかを返す
+		inline bool empty() const noexcept		{ return total_size == 0;}
+	};
+}  // namespace libcurlcxx
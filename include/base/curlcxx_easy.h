@@ -32,13 +32,17 @@
 #include <curl/easy.h>
 
 #include "curlcxx_base_object.h"
+#include "curlcxx_result.h"
 #include "curlcxx_stream.h"
+#include "curlcxx_upload.h"
 #include "curlcxx_mime.h"
 
 namespace libcurlcxx
 {
 	class curl_base_mime;
 	class curl_base_easy;
+	class curl_base_easy_pool;
+	class curl_base_share;
 
 	// プログレスを使うときのコールバック関数
 	// この形式で外部から定義すること
@@ -53,14 +57,12 @@ namespace libcurlcxx
 
 	// EasyハンドルのDeleter専用
 	// Easyハンドルがどこからも参照がなくなった場合に呼ばれて安全に解放される
+	// curl_base_easy_poolから借りたハンドルの場合は解放せずにプールへ返す
 	struct _curl_easy_handle_deleter
 	{
-		void operator()(CURL *_ceh) const
-		{
-			if (_ceh == nullptr) return;  // nullptrのときは何もしない
-//  std::cout << "clean easy" << std::endl;
-			curl_easy_cleanup(_ceh);
-		}
+		std::weak_ptr<curl_base_easy_pool> pool;		// 借りたハンドルの場合は返却先。空ならcurl_easy_cleanupする
+
+		void operator()(CURL *_ceh) const;
 	};
 	// CURLのunique_ptr ハンドル構造。ユニークなポインタとする
 	typedef std::unique_ptr<CURL, _curl_easy_handle_deleter> curl_easy_unique_handle;
@@ -73,6 +75,8 @@ namespace libcurlcxx
 		std::string				url;		// 設定したURL
 		std::shared_ptr<curl_base_mime>	mime;  // 設定したmime
 		std::shared_ptr<curl_base_stream_object>	streamer;  // 設定したstreamer
+		std::shared_ptr<curl_base_upload_object>	uploader;  // 設定したuploader(送信するbody)
+		std::shared_ptr<curl_base_share>	share;  // 設定したshare
 		long int				connect_timeout;		// 接続タイムアウト秒数(デフォルトは300秒＝CURLのデフォルトと同じ)
 
 		void									*prog_data;	   // progress用データ
@@ -90,11 +94,17 @@ namespace libcurlcxx
 		static int _xfer_callback_func(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
 		virtual int internal_xfer_callback(curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
 
+		static size_t _header_callback_func(char *buffer, size_t size, size_t nitems, void *userdata);
+		virtual size_t internal_header_callback(char *buffer, size_t realsize);
+		void init_header_callback() noexcept;
+
 		bool move_set_mime(std::shared_ptr<curl_base_mime> &_mime);
 
 	public:
 		curl_base_easy();
 		explicit curl_base_easy(const std::shared_ptr<curl_base_stream_object> &_streamer);
+		explicit curl_base_easy(const std::shared_ptr<curl_base_easy_pool> &pool);
+		curl_base_easy(const std::shared_ptr<curl_base_stream_object> &_streamer, const std::shared_ptr<curl_base_easy_pool> &pool);
 
 		curl_base_easy(curl_base_easy &&) noexcept;
 		curl_base_easy &operator= (curl_base_easy &&) noexcept;
@@ -104,18 +114,26 @@ namespace libcurlcxx
 		~curl_base_easy() noexcept;
 
 		virtual void perform();
+		virtual curl_easy_result try_perform();
 
 		// Streamerを設定する
 		void set_streamer(const std::shared_ptr<curl_base_stream_object> &_streamer);
 		// Streamerを取得する
 		inline curl_base_stream_object* get_streamer() const { return streamer.get();}
 
+		// Uploaderを設定する
+		void set_uploader(const std::shared_ptr<curl_base_upload_object> &_uploader);
+		// Uploaderを取得する
+		inline curl_base_upload_object* get_uploader() const { return uploader.get();}
+
 		bool set_url(std::string_view _url);
 		// 設定したURLを取得
 		inline std::string get_url() const noexcept { return url;}
 
 		bool set_mime(const std::shared_ptr<curl_base_mime> &_mime);
 
+		bool set_share(const std::shared_ptr<curl_base_share> &_share);
+
 		void set_progress_function(bool onoff, curl_base_easy_progress_callback func = nullptr, void *param = nullptr);
 
 		void set_verbose(bool onoff);
@@ -133,6 +151,7 @@ namespace libcurlcxx
 
 		inline CURLcode set_write_callback(curl_write_callback param) noexcept 			{return curl_easy_setopt(handle.get(), CURLOPT_WRITEFUNCTION, param);};
 		inline CURLcode set_xferinfo_callback(curl_xferinfo_callback param) noexcept 	{return curl_easy_setopt(handle.get(), CURLOPT_XFERINFOFUNCTION, param);};
+		inline CURLcode set_header_callback(curl_write_callback param) noexcept 		{return curl_easy_setopt(handle.get(), CURLOPT_HEADERFUNCTION, param);};
 
 		inline CURLcode set_debug_callback(curl_debug_callback param) noexcept 			{return curl_easy_setopt(handle.get(), CURLOPT_DEBUGFUNCTION, param);};
 
@@ -0,0 +1,86 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <curl/curl.h>
+#include <curl/easy.h>
+
+#include "curlcxx_easy.h"
+
+namespace libcurlcxx
+{
+	// curl_base_easy_pool : curl Easyハンドルの再利用プール
+	//
+	// curl_easy_init / curl_easy_cleanup をリクエストごとに行うと、ハンドルの確保と
+	// ハンドルが持っている接続キャッシュ・DNSキャッシュ・TLSセッションを毎回捨てることになる
+	// このプールから借りたハンドルは、curl_base_easyが破棄されたときに
+	// curl_easy_resetで設定だけを初期化してプールへ戻されるので、次のリクエストで接続などが再利用される
+	//
+	// 使い方
+	//  auto pool = std::make_shared<curl_base_easy_pool>();
+	//  curl_http_request req(std::make_shared<curl_base_stringstream>(), pool);
+	//
+	// 注意：必ずstd::make_shared<>で作成すること(返却先をweak_ptrで保持するため)
+	//       プールが先に破棄された場合、借りていたハンドルは返却されずにcurl_easy_cleanupされる
+	//       ハンドルの返却はどのスレッドから行っても良い
+	class curl_base_easy_pool : public std::enable_shared_from_this<curl_base_easy_pool>
+	{
+	private:
+		std::mutex					lk;					// idleの保護用
+		std::vector<CURL *>			idle;				// 返却されて空いているハンドル
+		size_t						max_idle;			// idleに保持しておく最大数
+
+		std::atomic<size_t>			created;			// curl_easy_initした数
+		std::atomic<size_t>			reused;				// プールから再利用した数
+
+		// コピー禁止
+		curl_base_easy_pool &operator=(curl_base_easy_pool const &) = delete;
+		curl_base_easy_pool(curl_base_easy_pool const &) = delete;
+
+	public:
+		explicit curl_base_easy_pool(size_t _max_idle = 64);
+		~curl_base_easy_pool() noexcept;
+
+		curl_easy_unique_handle acquire();
+		void release(CURL *_ceh) noexcept;
+
+		void shrink() noexcept;
+
+		// プールで待機しているハンドル数を返す
+		inline size_t get_idle_count()
+		{
+			std::lock_guard<std::mutex> lock(lk);
+			return idle.size();
+		}
+		// これまでcurl_easy_initしたハンドル数を返す
+		inline size_t get_created_count() const noexcept	{ return created.load(std::memory_order_relaxed);}
+		// これまでプールから再利用したハンドル数を返す
+		inline size_t get_reused_count() const noexcept	{ return reused.load(std::memory_order_relaxed);}
+	};
+}  // namespace libcurlcxx
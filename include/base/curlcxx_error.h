@@ -29,7 +29,7 @@
 #include <utility>
 #include <deque>
 #include <algorithm>
-#include <mutex>
+#include <cstdint>
 #include <curl/curl.h>
 
 #include "curlcxx_base_object.h"
@@ -37,41 +37,67 @@
 namespace libcurlcxx
 {
 	// エラーログ用構造
+	// 文字列は固定長の配列にコピーして持つ。入りきらない分は切り捨てる
+	// ヒープを使わないので、例外を作るときやログに積むときにメモリ確保が起きない
 	class curl_base_error
 	{
+	public:
+		static constexpr size_t message_max = 200;		// メッセージの最大長
+		static constexpr size_t funcname_max = 120;		// 関数名の最大長
+
 	private:
-		std::string message;            // 詳細なエラーメッセージ
-		std::string funcname;           // エラーを起こした関数名
-		int         funcline;           // エラーを起こした行番号
-		int         errorcode;          // Curlのエラーコード(あれば)
+		char		message[message_max + 1];		// 詳細なエラーメッセージ
+		char		funcname[funcname_max + 1];		// エラーを起こした関数名
+		int			funcline;						// エラーを起こした行番号
+		int			errorcode;						// Curlのエラーコード(あれば)
+		uint64_t	timestamp;						// 発生時刻(steady_clockのナノ秒)。ログを並べるのに使う
+
+		static void copy_str(char *dst, size_t max, std::string_view src) noexcept;
 
 	public:
+		curl_base_error() noexcept;
 		curl_base_error(std::string_view mess, std::string_view func, const int line) noexcept;
 		curl_base_error(const libcurlcxx::curl_base_object* obj, std::string_view func, const int line) noexcept;
 
 		inline std::string get_message() const noexcept {return message;}
 		inline std::string get_funcname() const noexcept {return funcname;}
 		inline int get_funcline()         const noexcept {return funcline;}
+		inline int get_errorcode()        const noexcept {return errorcode;}
+		inline uint64_t get_timestamp()   const noexcept {return timestamp;}
+		// コピーせずに参照する版
+		inline const char *message_cstr() const noexcept  {return message;}
+		inline const char *funcname_cstr() const noexcept {return funcname;}
 	};
 
-	// エラー構造ログを貯めるためのキュー定義
+	// エラー構造ログを返すためのキュー定義。新しいものが先頭
 	using curl_base_errqueue = std::deque<curl_base_error>;
 
 	// cURLにまつわるエラー例外クラス
+	//
+	// エラーログはスレッドごとに固定長のリングバッファ(errlog_ring_size件)に積み、古いものから上書きされる
+	// 積むときはロックを取らないので、多数のスレッドで同時にエラーが起きてもお互いを待たせない
+	// get_errlogを呼んだときに、すべてのスレッドのログを時刻順にまとめて返す
+	//
+	// what()の文字列は例外を作るときに固定長の配列へ整形しておく。ヒープは使わない
+	// 作った後は書き換えないので、同じ例外オブジェクトのwhat()を複数のスレッドから呼んでもよい(shared_futureで投げ直した場合など)
 	class curl_base_exception : public std::exception
 	{
+	public:
+		static constexpr size_t errlog_ring_size = 64;		// スレッドごとに残すログの件数
+
 	private:
-		static curl_base_errqueue errlog;       // エラーログ。これはStaticで持っているので全共通
-		static std::mutex errlog_lk;            // errlog用Mutex。これはStaticで持っているので全共通
+		curl_base_error		err;						// 直近のエラー
+		char				err_mes[curl_base_error::message_max + curl_base_error::funcname_max + 40];	// what()で返す文字列
 
-		std::string err_mes;                    // 直近のエラーメッセージ
+		void format_mes() noexcept;
+		static void push_errlog(const curl_base_error &e) noexcept;
 
 	public:
 		curl_base_exception(std::string_view mess, std::string_view func, const int line) noexcept;
 		curl_base_exception(const libcurlcxx::curl_base_object* obj, std::string_view func, const int line) noexcept;
 		curl_base_exception(const curl_base_exception &) noexcept;
 
-		curl_base_exception & operator=(curl_base_exception const&);
+		curl_base_exception & operator=(curl_base_exception const&) noexcept;
 
 		~curl_base_exception() noexcept override = default;
 
@@ -79,8 +105,10 @@ namespace libcurlcxx
 
 		static curl_base_errqueue get_errlog();
 		static void print_errlog();
-		static void clear_errlog();
+		static void clear_errlog() noexcept;
 		// 直近で発生したエラーメッセージを取得する
-		inline std::string get_errmes() const noexcept {return err_mes;}
+		inline std::string get_errmes() const noexcept {return what();}
+		// 直近で発生したエラーを取得する
+		inline const curl_base_error &get_error() const noexcept {return err;}
 	};
 }  // namespace libcurlcxx
@@ -0,0 +1,98 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "curlcxx_stream.h"
+
+namespace libcurlcxx
+{
+	// 受信したデータをmmapしたファイルに直接書き込むストリームクラス
+	//
+	// curl_base_fstr_ptr(std::fstream)のようにストリームのバッファを経由したり、
+	// curl_base_bytestreamのように一旦全部メモリに貯めてから書き出したりせずに、
+	// libcurlから来たデータをファイルをmmapした窓(window)へそのままコピーする
+	// 窓を移動するたびに前の窓はmunmapするので、数GBのファイルでもプロセスのメモリ使用量は窓の大きさ程度で済む
+	//
+	// Content-Lengthが分かっている場合は、bodyを受信する前にposix_fallocateでファイルの領域をまとめて確保する
+	// 分からない場合は、足りなくなるたびにgrow_stepずつファイルを伸ばす
+	// mmapできない場合(ファイルシステムが対応していないなど)はpwriteで書き込む
+	// 受信が終わったらclose()を呼ぶこと。実際に受信したサイズにファイルを切り詰めて閉じる(デストラクタでも呼ばれる)
+	//
+	// 注意：POSIX(Linuxなど)専用
+	class curl_base_mmap_filestream : public curl_base_stream_object
+	{
+	private:
+		int				fd;				// 書き込み先ファイル
+		std::string		path;			// 書き込み先ファイルのパス
+		size_t			window_size;	// 一度にmmapする大きさ(ページサイズの倍数)
+		size_t			grow_step;		// サイズが分からない場合にファイルを伸ばす単位
+		bool			use_mmap;		// falseならpwriteで書く
+		bool			failed;			// 書き込みに失敗したか
+
+		unsigned char	*window;		// 現在mmapしている窓
+		size_t			window_off;		// 窓のファイル上の位置
+		size_t			window_len;		// 現在の窓の大きさ。受信サイズが分かっている場合は最後の窓が短くなる
+		size_t			expected_end;	// 受信サイズから分かったファイルの終わり。分からない場合は0
+		size_t			file_size;		// 現在のファイルのサイズ(確保済みの領域)
+		size_t			written;		// 書き込んだバイト数
+
+		size_t internal_write(char *buffer, size_t realsize);
+		static size_t _callback_func(char *buffer, size_t size, size_t nitems, void *outstream);
+
+		bool ensure_file_size(size_t size);
+		bool map_window(size_t pos);
+		void unmap_window() noexcept;
+		bool write_pwrite(const char *buffer, size_t size);
+
+		// コピー禁止
+		curl_base_mmap_filestream &operator=(curl_base_mmap_filestream const &) = delete;
+		curl_base_mmap_filestream(curl_base_mmap_filestream const &) = delete;
+
+	public:
+		// 一度にmmapするデフォルトの大きさ
+		static constexpr size_t DEFAULT_WINDOW_SIZE = 64 * 1024 * 1024;
+		// サイズが分からない場合にファイルを伸ばすデフォルトの単位
+		static constexpr size_t DEFAULT_GROW_STEP = 256 * 1024 * 1024;
+
+		explicit curl_base_mmap_filestream(std::string_view _path, size_t _window_size = DEFAULT_WINDOW_SIZE, size_t _grow_step = DEFAULT_GROW_STEP);
+		virtual ~curl_base_mmap_filestream();
+
+		virtual void set_expected_size(size_t size);
+
+		bool close() noexcept;
+
+		// mmapを使わずにpwriteで書き込むようにする。最初のデータを受信する前に呼ぶこと
+		inline void set_use_mmap(bool onoff) noexcept		{ use_mmap = onoff;}
+
+		// 書き込んだバイト数を返す
+		inline size_t size() const noexcept			{ return written;}
+		// 書き込みに失敗したかを返す
+		inline bool is_failed() const noexcept		{ return failed;}
+		// 書き込み先ファイルのパスを返す
+		inline const std::string &get_path() const noexcept	{ return path;}
+	};
+}  // namespace libcurlcxx
@@ -28,6 +28,7 @@
 #include <string>
 #include <memory>
 #include "curlcxx_easy.h"
+#include "curlcxx_slist.h"
 
 namespace libcurlcxx
 {
@@ -45,6 +46,45 @@ namespace libcurlcxx
 	// curl_mime のunique_ptr ハンドル構造。ユニークなポインタとする
 	typedef std::unique_ptr<curl_mime, _curl_mime_handle_deleter> curl_mime_unique_handle;
 
+	// curl_base_mimeのread/seekコールバックでpartのデータを渡すための読み出しクラス
+	// これを派生してreadを実装し、curl_base_mime::add_reader_partに渡す
+	// 大きなデータを全部メモリに載せずに、送信する分だけ少しずつ読み出して渡すことができる
+	// オブジェクトはmimeが破棄されるときに手放される
+	class curl_base_mime_reader
+	{
+	public:
+		curl_base_mime_reader(){}
+		virtual ~curl_base_mime_reader(){}
+
+		// 送信するデータをbufferに最大sizeバイトまで書き込む
+		// return: 書き込んだバイト数。終わりなら0。エラーの場合はCURL_READFUNC_ABORT
+		virtual size_t read(char *buffer, size_t size) = 0;
+		// 読み出し位置を変更する。リダイレクトや認証で送り直すときにlibcurlから呼ばれる
+		// offset, origin: fseekと同じ(originはSEEK_SET / SEEK_CUR / SEEK_END)
+		// return: true = 変更できた false = 変更できない(送り直しは失敗する)
+		virtual bool seek(curl_off_t offset, int origin)	{ return false;}
+	};
+
+	// curl_base_mimeに追加したpartに、Content-Typeやファイル名、ヘッダを後から設定するためのクラス
+	// add_part系の戻り値として返される。mimeが破棄されたあとは使ってはいけない
+	// 例: mime->add_file_part("file", "a.png").set_type("image/png");
+	class curl_base_mime_part
+	{
+	private:
+		curl_mimepart	*part;		// 設定対象のpart。所有しない
+
+	public:
+		explicit curl_base_mime_part(curl_mimepart *_part) noexcept : part(_part){}
+
+		curl_base_mime_part &set_type(std::string_view type);
+		curl_base_mime_part &set_filename(std::string_view filename);
+		curl_base_mime_part &set_encoder(std::string_view encoding);
+		curl_base_mime_part &set_headers(curl_base_slist &&headers);
+
+		// 外向けにpart構造を返す
+		inline curl_mimepart* get_partptr() const noexcept {return part;}
+	};
+
 	// curl_mimeをラッピングしたクラス。CURLでPOSTするときの引数を渡す目的がほとんど
 	class curl_base_mime
 	{
@@ -55,13 +95,20 @@ namespace libcurlcxx
 		void set_name_part(curl_mimepart *part, std::string_view name);
 		curl_mimepart* create_part();
 
+		static size_t _read_callback(char *buffer, size_t size, size_t nitems, void *arg);
+		static int _seek_callback(void *arg, curl_off_t offset, int origin);
+		static void _free_callback(void *arg);
+
 		// コピー禁止
 		curl_base_mime &operator=(curl_base_mime const &) = delete;
 		curl_base_mime(curl_base_mime const &) = delete;
 
 	public:
-		void add_part(std::string_view name, std::string_view str);
-		void add_part(std::string_view name, const char* data, size_t size);
+		curl_base_mime_part add_part(std::string_view name, std::string_view str);
+		curl_base_mime_part add_part(std::string_view name, const char* data, size_t size);
+		curl_base_mime_part add_file_part(std::string_view name, std::string_view path);
+		curl_base_mime_part add_reader_part(std::string_view name, const std::shared_ptr<curl_base_mime_reader> &reader, curl_off_t size = -1);
+		curl_base_mime_part add_borrowed_part(std::string_view name, const char* data, size_t size);
 
 		// 外向けにmime構造を返す
 		inline const curl_mime* get_mimeptr() const {return _mime.get();}
@@ -0,0 +1,95 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace libcurlcxx
+{
+	// 複数スレッドから入れて1スレッドから取り出すロックフリーなキュー(MPSC)
+	// 入れる側はCASで先頭に積むだけなのでロックを取らない
+	// 取り出す側はconsume_allでまとめて取り出す。取り出しは入れた順(FIFO)になる
+	template<typename T> class curl_base_mpsc_queue
+	{
+	private:
+		struct node
+		{
+			T		value;
+			node	*next;
+		};
+		std::atomic<node*> head;		// 最後に入れたもの。nextをたどると古いものになる
+
+		// コピー禁止
+		curl_base_mpsc_queue &operator=(curl_base_mpsc_queue const &) = delete;
+		curl_base_mpsc_queue(curl_base_mpsc_queue const &) = delete;
+
+	public:
+		curl_base_mpsc_queue() : head(nullptr) {}
+		~curl_base_mpsc_queue()
+		{
+			node *n = head.exchange(nullptr);
+			while(n != nullptr){
+				node *next = n->next;
+				delete n;
+				n = next;
+			}
+		}
+
+		// キューに入れる。どのスレッドから呼んでもよい
+		void push(T &&value)
+		{
+			node *n = new node{std::move(value), head.load(std::memory_order_relaxed)};
+			while(!head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)){}
+		}
+
+		// 溜まっているものを入れた順にすべて取り出してfuncに渡す
+		// 取り出す側のスレッドは一つだけにすること
+		// return: 取り出した数
+		template<class F> size_t consume_all(F func)
+		{
+			node *n = head.exchange(nullptr, std::memory_order_acquire);
+			// 新しい順に並んでいるので逆順にする
+			node *fifo = nullptr;
+			while(n != nullptr){
+				node *next = n->next;
+				n->next = fifo;
+				fifo = n;
+				n = next;
+			}
+			size_t count = 0;
+			while(fifo != nullptr){
+				node *next = fifo->next;
+				func(std::move(fifo->value));
+				delete fifo;
+				fifo = next;
+				count++;
+			}
+			return count;
+		}
+
+		// 空かどうか。他のスレッドが入れている最中の場合は正確ではない
+		inline bool empty() const noexcept		{ return head.load(std::memory_order_acquire) == nullptr;}
+	};
+}  // namespace libcurlcxx
@@ -23,7 +23,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 #include <unordered_map>
 
@@ -70,15 +73,38 @@ namespace libcurlcxx
 		inline curl_base_easy* get_easy() const 		{return _easy.lock().get();}
 	};
 
+	// drain_doneで返す、転送が終わったもの1つ分
+	// easyはmultiに登録されたままなので、removeするまでは有効である
+	struct curl_base_multi_done
+	{
+		curl_base_easy	*easy;		// 対象のEasyオブジェクト
+		CURLcode		code;		// 転送結果
+	};
+
+	// 転送が終わったときに呼ばれるハンドラ。run/run_until_idleの中から呼ばれる
+	// easy: 転送が終わったEasyオブジェクト。呼ばれた時点でmultiからは登録解除されている
+	// code: 転送結果
+	using curl_base_multi_done_handler = std::function<void(const std::shared_ptr<curl_base_easy> &easy, CURLcode code)>;
+
+	// multiに登録したEasyオブジェクト1つ分
+	// CURLOPT_PRIVATEにこれのポインタを入れておき、転送終了時にマップを引かずにたどれるようにしている
+	struct curl_base_multi_entry
+	{
+		std::shared_ptr<curl_base_easy>	easy;		// 所有権は保持しないといけないのでSharedPtrである
+		curl_base_multi_done_handler	handler;	// 転送が終わったときに呼ぶハンドラ(なければ空)
+	};
+
 	// cURLのmultiハンドルをラッピングしたクラス。Easyとは異なりスレッドを使用すること無く複数同時リクエストに対応している
 	class curl_base_multi : public curl_base_object
 	{
-	private:
+	protected:
 		curl_multi_unique_handle _multi;										// multiハンドル実体
 		int active_transfers;													// 残り転送数
 
-		std::unordered_map<CURL*, std::shared_ptr<curl_base_easy>> handles;		// Addで登録しているEasyハンドルとオブジェクトのマップ
-																				// 所有権は保持しないといけないのでSharedPtrである
+		std::unordered_map<CURL*, curl_base_multi_entry> handles;				// Addで登録しているEasyハンドルとオブジェクトのマップ
+		std::vector<curl_base_multi_done> done_batch;							// drain_doneで返すバッファ。使い回す
+		size_t handler_entries;													// ハンドラ付きで登録しているものの数
+		std::atomic<bool> stop_requested;										// runを抜けるかどうか
 		// コピー禁止
 		curl_base_multi &operator=(curl_base_multi const &) = delete;
 		curl_base_multi(curl_base_multi const &) = delete;
@@ -86,30 +112,59 @@ namespace libcurlcxx
 	protected:
 		virtual void set_error(const int curl_code) noexcept;
 
+		virtual void run_step(int timeout_ms);
+		static curl_base_multi_entry *get_entry(CURL *easy_handle) noexcept;
+		curl_multi_result try_remove(CURL *h);
+
 	public:
 		curl_base_multi();
 
 		curl_base_multi(curl_base_multi&&) noexcept;
 		curl_base_multi& operator=(curl_base_multi&&) noexcept;
 
-		~curl_base_multi() noexcept;
+		virtual ~curl_base_multi() noexcept;
 
 		void add(const std::shared_ptr<curl_base_easy> &easy);
+		void add(const std::shared_ptr<curl_base_easy> &easy, curl_base_multi_done_handler handler);
 		void remove(const std::shared_ptr<curl_base_easy> &easy);
 		void remove(const libcurlcxx::curl_base_multi_message &msg);
 		void clear();
 
 		bool get_next_message(curl_base_multi_message &rmsg, int &msg_in_queue);
+		std::span<const curl_base_multi_done> drain_done();
+		size_t dispatch_done();
 		bool perform();
 
+		void run();
+		void run_until_idle();
+		void stop();
+
 		void wait(struct curl_waitfd [], unsigned int, int, int *);
 		void poll(struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms, int *numfds);
-		void wakeup();
+		virtual void wakeup();
 
 		void timeout(long *);
 
+		void socket_action(curl_socket_t sockfd, int ev_bitmask);
+
+		// 例外を投げない版。libcurlのエラーは結果として返す
+		// 失敗した場合はget_errorcode/get_errorstrにも同じものが入る
+		curl_multi_result try_add(const std::shared_ptr<curl_base_easy> &easy);
+		curl_multi_result try_add(const std::shared_ptr<curl_base_easy> &easy, curl_base_multi_done_handler handler);
+		curl_multi_result try_remove(const std::shared_ptr<curl_base_easy> &easy);
+		curl_multi_result try_remove(const libcurlcxx::curl_base_multi_message &msg);
+		curl_multi_result try_perform();
+		curl_multi_result try_wait(struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms, int *numfds);
+		curl_multi_result try_poll(struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms, int *numfds);
+		virtual curl_multi_result try_wakeup();
+		curl_multi_result try_timeout(long *timeout);
+		curl_multi_result try_socket_action(curl_socket_t sockfd, int ev_bitmask);
+
 		// curl_multi_setoptを直接呼び出しするためのもの
 		inline CURLMcode set_option(CURLMoption option, long param) noexcept	{return curl_multi_setopt(_multi.get(), option, param);};
+		inline CURLMcode set_option(CURLMoption option, void *param) noexcept	{return curl_multi_setopt(_multi.get(), option, param);};
+		inline CURLMcode set_option(CURLMoption option, curl_socket_callback param) noexcept	{return curl_multi_setopt(_multi.get(), option, param);};
+		inline CURLMcode set_option(CURLMoption option, curl_multi_timer_callback param) noexcept	{return curl_multi_setopt(_multi.get(), option, param);};
 
 		// perform後の残り転送数を取得
 		inline int get_active_transfers() const noexcept	{ return active_transfers;}
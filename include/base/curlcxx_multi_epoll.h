@@ -0,0 +1,81 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <curl/curl.h>
+#include <curl/multi.h>
+#include <sys/epoll.h>
+
+#include "curlcxx_multi.h"
+
+namespace libcurlcxx
+{
+	// curl_base_multiをepollとcurl_multi_socket_actionで駆動するクラス
+	// CURLMOPT_SOCKETFUNCTION/CURLMOPT_TIMERFUNCTIONでlibcurlから監視すべきソケットとタイマーを教えてもらい、
+	// epollで準備ができたソケットだけをcurl_multi_socket_actionに渡す
+	// performのように毎回全転送を走査しないので、同時転送数が多い場合に効果がある
+	//
+	// add/remove/get_next_messageなどはcurl_base_multiと同じように使える
+	// performの代わりにrun_onceを呼ぶこと。run/run_until_idleはそのまま使える
+	class curl_base_multi_epoll : public curl_base_multi
+	{
+	private:
+		int epoll_fd;													// epollのファイルディスクリプタ
+		int wakeup_fd;													// wakeup用のeventfd
+		bool timer_active;												// libcurlからタイムアウトを要求されているかどうか
+		std::chrono::steady_clock::time_point timer_deadline;			// 次にCURL_SOCKET_TIMEOUTを通知するべき時刻
+		std::vector<struct epoll_event> events;							// epoll_waitの受け取りバッファ
+
+		// コールバックにthisを渡しているのでコピーもムーブも禁止
+		curl_base_multi_epoll &operator=(curl_base_multi_epoll const &) = delete;
+		curl_base_multi_epoll(curl_base_multi_epoll const &) = delete;
+		curl_base_multi_epoll(curl_base_multi_epoll &&) = delete;
+		curl_base_multi_epoll &operator=(curl_base_multi_epoll &&) = delete;
+
+		static int _socket_callback_func(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp);
+		int internal_socket_callback(curl_socket_t s, int what, void *socketp);
+
+		static int _timer_callback_func(CURLM *multi, long timeout_ms, void *userp);
+		int internal_timer_callback(long timeout_ms);
+
+		int next_timeout(int timeout_ms) const;
+		void drain_wakeup();
+
+	protected:
+		void run_step(int timeout_ms) override;
+
+	public:
+		curl_base_multi_epoll();
+		~curl_base_multi_epoll() noexcept;
+
+		int run_once(int timeout_ms);
+		curl_multi_result try_wakeup() override;
+
+		// epollの生ディスクリプタを取得する。他のイベントループに組み込みたい場合に使う
+		inline int get_epoll_fd() const noexcept		{ return epoll_fd;}
+	};
+}  // namespace libcurlcxx
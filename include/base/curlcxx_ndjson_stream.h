@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "curlcxx_stream.h"
+
+namespace libcurlcxx
+{
+	// 改行区切りのJSON(NDJSON / JSON Lines)を受信しながらレコードごとに切り出すストリームクラス
+	//
+	// 受信したチャンクを64バイトずつSIMD(AVX2かSSE2、使えなければmemchr)で'\n'と比較して改行の位置をビットマスクにし、
+	// マスクのビットを順にたどって、1行揃うたびにそのレコードをstring_viewでコールバック関数に渡す
+	// チャンク内で完結しているレコードは受信バッファを直接指すのでコピーしない
+	// チャンクの境目をまたいだレコードだけを小さなバッファに貯め、バッファは使い回す
+	// 行末のCRは取り除き、空行は渡さない
+	//
+	// 最後のレコードが改行で終わっていない場合があるので、perform()のあとでflush()を呼ぶこと
+	class curl_base_ndjson_stream : public curl_base_stream_object
+	{
+	public:
+		// レコードが1つ揃うたびに呼ばれるコールバック関数
+		// record: 改行を含まない1行。コールバック関数の中でだけ有効
+		// return: falseを返すと受信を中断する(performはCURLE_WRITE_ERRORで失敗する)
+		using record_callback = std::function<bool(std::string_view record)>;
+
+	private:
+		record_callback		callback;			// レコードごとに呼ぶ関数
+		std::string			tail;				// チャンクの境目をまたいだレコードの前半
+		size_t				record_count;		// これまでに渡したレコード数
+
+		size_t internal_write(char *buffer, size_t realsize);
+		static size_t _callback_func(char *buffer, size_t size, size_t nitems, void *outstream);
+
+		bool emit(std::string_view record);
+		bool on_newline(const char *rec, const char *nl);
+
+		// コピー禁止
+		curl_base_ndjson_stream &operator=(curl_base_ndjson_stream const &) = delete;
+		curl_base_ndjson_stream(curl_base_ndjson_stream const &) = delete;
+
+	public:
+		explicit curl_base_ndjson_stream(record_callback func);
+		virtual ~curl_base_ndjson_stream(){}
+
+		bool flush();
+		void clear() noexcept;
+
+		// 改行を探すのに使われている実装の名前を返す("avx2" "sse2" "memchr")
+		// 実行しているCPUで使える一番速い実装が起動時に選ばれる
+		static const char *get_kernel_name() noexcept;
+
+		// これまでにコールバック関数に渡したレコード数を返す
+		inline size_t get_record_count() const noexcept		{ return record_count;}
+		// まだ改行が来ていない途中のレコードを返す
+		inline std::string_view get_tail() const noexcept	{ return tail;}
+	};
+}  // namespace libcurlcxx
@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <string_view>
+
+#include <curl/curl.h>
+
+namespace libcurlcxx
+{
+	// curl_base_result : 例外を投げない版のAPI(try_perform、try_addなど)が返す結果
+	// C++23のstd::expected<void, エラー>のように、成功か、失敗ならそのエラーコードとメッセージを持つ
+	// メッセージはlibcurlの*_strerrorが返す静的な文字列を指すだけなので、作るときにメモリ確保や文字列の整形はしない
+	//
+	// 使い方
+	//  if(auto r = req.try_perform(); !r){
+	//      std::cerr << r.error() << " " << r.message() << std::endl;		// 例外を投げずにリトライなどをする
+	//  }
+	//
+	// Code: CURLcodeやCURLMcode
+	// OkCode: 成功を表す値(CURLE_OKなど)
+	template <typename Code, Code OkCode>
+	class curl_base_result
+	{
+	private:
+		Code		code;			// エラーコード
+		const char	*mess;			// エラーメッセージ。静的な文字列を指す
+
+	public:
+		// 成功
+		constexpr curl_base_result() noexcept : code(OkCode), mess("") {}
+		// 失敗。_messは結果を使い終わるまで有効な文字列であること(文字列リテラルや*_strerrorの戻り値)
+		constexpr curl_base_result(Code _code, const char *_mess) noexcept : code(_code), mess(_mess ? _mess : "") {}
+
+		// 成功したかどうか
+		constexpr bool has_value() const noexcept				{ return code == OkCode;}
+		constexpr explicit operator bool() const noexcept		{ return has_value();}
+		// エラーコード。成功ならOkCode
+		constexpr Code error() const noexcept					{ return code;}
+		// エラーメッセージ。成功なら空文字
+		constexpr std::string_view message() const noexcept		{ return mess;}
+	};
+
+	// Easy(curl_easy_*)の結果
+	using curl_easy_result = curl_base_result<CURLcode, CURLE_OK>;
+	// Multi(curl_multi_*)の結果
+	using curl_multi_result = curl_base_result<CURLMcode, CURLM_OK>;
+
+	// CURLcodeから結果を作る
+	inline curl_easy_result make_easy_result(CURLcode code) noexcept
+	{
+		if(code == CURLE_OK) return curl_easy_result();
+		return curl_easy_result(code, curl_easy_strerror(code));
+	}
+
+	// CURLMcodeから結果を作る
+	inline curl_multi_result make_multi_result(CURLMcode code) noexcept
+	{
+		if(code == CURLM_OK) return curl_multi_result();
+		return curl_multi_result(code, curl_multi_strerror(code));
+	}
+}  // namespace libcurlcxx
@@ -0,0 +1,97 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+
+#include <curl/curl.h>
+
+#include "curlcxx_base_object.h"
+
+namespace libcurlcxx
+{
+	// shareハンドルのDeleter専用
+	// shareハンドルの参照がどこからもなくなったときに呼ばれて安全に解放される
+	struct _curl_share_handle_deleter
+	{
+		void operator()(CURLSH *_csh) const
+		{
+			if (_csh == nullptr) return;  // nullptrのときは何もしない
+			curl_share_cleanup(_csh);
+		}
+	};
+
+	// CURLSHのunique_ptr ハンドル構造。ユニークなポインタとする
+	using curl_share_unique_handle = std::unique_ptr<CURLSH, _curl_share_handle_deleter>;
+
+	// curl_base_share : curl_shareをC++で実装したもの
+	// 複数のEasyハンドルの間で接続キャッシュ・DNSキャッシュ・TLSセッションなどを共有する
+	// 別々のcurl_http_requestで同じホストへ続けてリクエストする場合に、接続やTLSハンドシェイクをやり直さずに済む
+	//
+	// 使い方
+	//  auto share = std::make_shared<curl_base_share>();
+	//  share->share(CURL_LOCK_DATA_CONNECT);		// 1つのスレッドからだけ使うなら接続も共有できる
+	//  req.set_share(share);
+	//
+	// デフォルトではDNSキャッシュとTLSセッションを共有する
+	// 接続キャッシュはlibcurlの制限により、別スレッドで同時に使うハンドル間では共有しないこと
+	//
+	// 別スレッドのEasyハンドルからも使えるよう、共有するデータの種類(curl_lock_data)ごとに
+	// 読み書きロック(std::shared_mutex)を持っている。読み込みだけのアクセスは同時に行える
+	// 注意：必ずstd::make_shared<>で作成してcurl_base_easy::set_shareに渡すこと
+	//
+	// see also:
+	// https://curl.se/libcurl/c/libcurl-share.html
+	class curl_base_share : public curl_base_object
+	{
+	private:
+		curl_share_unique_handle	handle;								// shareハンドルそのものを管理
+		std::shared_mutex			locks[CURL_LOCK_DATA_LAST];			// curl_lock_dataごとのロック
+		bool						locked_exclusive[CURL_LOCK_DATA_LAST] = {};	// 排他ロックで取られているかどうか。ロックを持っている間だけ触る
+
+		static void _lock_callback_func(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+		static void _unlock_callback_func(CURL *handle, curl_lock_data data, void *userptr);
+
+		// コピー禁止
+		curl_base_share &operator=(curl_base_share const &) = delete;
+		curl_base_share(curl_base_share const &) = delete;
+
+	protected:
+		virtual void set_error(const int curl_code) noexcept;
+
+	public:
+		explicit curl_base_share(bool share_default = true);
+		~curl_base_share() noexcept;
+
+		bool share(curl_lock_data data);
+		bool unshare(curl_lock_data data);
+
+		// curl_share_setopt直接呼び出し
+		inline CURLSHcode set_option(CURLSHoption option, long param) noexcept 	{return curl_share_setopt(handle.get(), option, param);};
+
+		// CURLSHの生ハンドルを取得する
+		inline CURLSH *get_shandle() const noexcept	{ return handle.get();}
+	};
+}  // namespace libcurlcxx
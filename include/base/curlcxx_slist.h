@@ -25,8 +25,11 @@
 
 #include <curl/curl.h>
 #include <algorithm>
+#include <initializer_list>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace libcurlcxx
 {
@@ -69,11 +72,74 @@ namespace libcurlcxx
 		// 外向けにslist構造を返すが所有権を放棄するため自動でRemoveが掛からなくなる。mimeに渡すためのもの。使うには注意すること
 		inline curl_slist* release_slistptr() {return _slist.release();}
 
+		curl_slist* get_lastptr() noexcept;
+
 		// SList構造が有効かどうか
 		inline bool isempty() const noexcept {
 			if(_slist) return false;
 			return true;		// 空である
 		}
 	};
+
+	// コンパイル時に作る、変更できないヘッダのリスト
+	// curl_slistのノードもconstinitの静的領域に置かれるので、実行時のmallocもコピーも一切ない
+	// 例: static constinit curl_base_static_headers api_headers("User-Agent: xxx", "Accept: application/json");
+	template<size_t N> class curl_base_static_headers
+	{
+		static_assert(N > 0, "curl_base_static_headers needs at least one header");
+	private:
+		curl_slist		nodes[N];		// 文字列リテラルを指すノード。次のノードへつないである
+
+	public:
+		template<class... T> constexpr explicit curl_base_static_headers(const T&... lines) : nodes{}
+		{
+			const char *arr[N] = {lines...};
+			for(size_t i = 0; i < N; i++){
+				// libcurlはHTTPHEADERのリストを書き換えないので、リテラルをそのまま指してよい
+				nodes[i].data = const_cast<char *>(arr[i]);
+				nodes[i].next = (i + 1 < N) ? &nodes[i + 1] : nullptr;
+			}
+		}
+		// 外向けにslist構造を返す
+		inline const curl_slist* get_slistptr() const noexcept	{ return &nodes[0];}
+		// ヘッダの数を返す
+		static constexpr size_t size() noexcept					{ return N;}
+	};
+	template<class... T> curl_base_static_headers(const T&...) -> curl_base_static_headers<sizeof...(T)>;
+
+	// 複数のリクエストで共有する、変更できないヘッダのセット
+	// 一度作ったらshared_ptrで各リクエストのsetHeaderSetに渡す。リクエストごとにmallocや文字列のコピーは起きない
+	// 実行時に作る場合は、全部の文字列を1つの領域に詰めて、ノードも1つの配列に並べる(確保は2回だけ)
+	// curl_base_static_headersから作る場合は静的領域のノードをそのまま指す
+	// 注意：必ずstd::make_shared<>かcreateで作成すること
+	class curl_base_header_set
+	{
+	private:
+		std::unique_ptr<char[]>			arena;		// ヘッダ文字列をNULL区切りで並べたもの
+		std::unique_ptr<curl_slist[]>	nodes;		// arenaを指すノード
+		const curl_slist				*head;		// リストの先頭
+		size_t							count;		// ヘッダの数
+
+		void build(const std::string_view *lines, size_t n);
+
+		// コピー禁止
+		curl_base_header_set &operator=(curl_base_header_set const &) = delete;
+		curl_base_header_set(curl_base_header_set const &) = delete;
+
+	public:
+		explicit curl_base_header_set(std::initializer_list<std::string_view> lines);
+		explicit curl_base_header_set(const std::vector<std::string> &lines);
+		// 静的なリストを指す。listはこのオブジェクトより長生きすること(static constinitで作ったものなら問題ない)
+		template<size_t N> explicit curl_base_header_set(const curl_base_static_headers<N> &list) noexcept
+			: head(list.get_slistptr()), count(N){}
+		~curl_base_header_set() noexcept{}
+
+		static std::shared_ptr<const curl_base_header_set> create(std::initializer_list<std::string_view> lines);
+
+		// 外向けにslist構造を返す。空ならnullptr
+		inline const curl_slist* get_slistptr() const noexcept	{ return head;}
+		// ヘッダの数を返す
+		inline size_t size() const noexcept						{ return count;}
+	};
 }  // namespace libcurlcxx
 
@@ -0,0 +1,97 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "curlcxx_stream.h"
+
+namespace libcurlcxx
+{
+	// Server-Sent Eventsのイベント1つ分
+	// 中身はコールバック関数の中でだけ有効。残しておきたい場合はコピーすること
+	struct curl_base_sse_event
+	{
+		std::string_view	event;		// イベントの種類。event:がなかった場合は"message"
+		std::string_view	data;		// data:の内容。複数行の場合は'\n'でつながる
+		std::string_view	id;			// このイベントの時点での最後のイベントID
+	};
+
+	// Server-Sent Events(text/event-stream)を受信しながら解析するストリームクラス
+	//
+	// bodyを全部受信するまで待たずに、イベントが1つ揃った(空行が来た)時点でコールバック関数を呼ぶ
+	// 行がチャンクの境目をまたいだ場合はまたいだ行の分だけを持っておき、body全体を貯めることはしない
+	// 行の終わりはCRLF、LF、CRのどれでもよい(CRLFがチャンクの境目で分かれていてもよい)
+	//
+	// 切れたあとでつなぎ直す場合は、reset()を呼んでから同じストリームでリクエストし直し、
+	// get_resume_header()で得た"Last-Event-ID: ..."をヘッダに追加すると、サーバは続きのイベントから送ってくる
+	class curl_base_sse_stream : public curl_base_stream_object
+	{
+	public:
+		// イベントが1つ揃うたびに呼ばれるコールバック関数
+		// return: falseを返すと受信を中断する(performはCURLE_WRITE_ERRORで失敗する)
+		using event_callback = std::function<bool(const curl_base_sse_event &ev)>;
+
+	private:
+		event_callback		callback;			// イベントごとに呼ぶ関数
+		std::string			line;				// チャンクの境目をまたいだ行の前半
+		std::string			data;				// 組み立て中のイベントのdata
+		std::string			event_type;			// 組み立て中のイベントのevent
+		std::string			id_buffer;			// id:で受け取った値。イベントが揃ったらlast_event_idになる
+		std::string			last_event_id;		// 最後に揃ったイベントの時点のID
+		long				retry;				// retry:で指定された再接続までの時間(ms)。指定がなければ-1
+		size_t				event_count;		// これまでに呼んだイベント数
+		bool				pending_cr;			// 前のチャンクがCRで終わっていた(次のLFを読み飛ばす)
+		bool				first_line;			// 最初の行(BOMを取り除く)
+
+		size_t internal_write(char *buffer, size_t realsize);
+		static size_t _callback_func(char *buffer, size_t size, size_t nitems, void *outstream);
+
+		bool process_line(std::string_view l);
+		bool dispatch();
+
+		// コピー禁止
+		curl_base_sse_stream &operator=(curl_base_sse_stream const &) = delete;
+		curl_base_sse_stream(curl_base_sse_stream const &) = delete;
+
+	public:
+		explicit curl_base_sse_stream(event_callback func);
+		virtual ~curl_base_sse_stream(){}
+
+		void reset() noexcept;
+		std::string get_resume_header() const;
+
+		// 最後に揃ったイベントの時点のIDを返す。なければ空
+		inline const std::string &get_last_event_id() const noexcept	{ return last_event_id;}
+		// 最後のイベントIDを設定する。前回の接続のIDから始めたい場合にreset()の前に呼ぶ
+		inline void set_last_event_id(std::string_view id)				{ last_event_id = id;}
+		// サーバがretry:で指定した再接続までの時間(ms)を返す。指定がなければ-1
+		inline long get_retry() const noexcept							{ return retry;}
+		// これまでにコールバック関数を呼んだイベント数を返す
+		inline size_t get_event_count() const noexcept					{ return event_count;}
+	};
+}  // namespace libcurlcxx
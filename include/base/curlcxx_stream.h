@@ -46,6 +46,16 @@ namespace libcurlcxx
 			if(buffer == nullptr) return 0;
 			return realsize;
 		}
+
+		// stringstreamの中のstringを、これまでの内容+sizeバイト分だけreserveし直す
+		// stringstreamにはreserveがないので、一旦stringを取り出して(C++20ではムーブになる)reserveしてから戻す
+		inline void _reserve_stringstream(std::stringstream &ss, size_t size)
+		{
+			std::string s = std::move(ss).str();
+			s.reserve(s.size() + size);
+			ss.str(std::move(s));
+			ss.seekp(0, std::ios_base::end);		// 書き込み位置を戻した内容の末尾にする
+		}
 	}  // namespace writef
 
 	// すべてのCurl Streamの根底となるクラス。easyはこれを使うのでこのクラスを派生して使用すること
@@ -67,6 +77,10 @@ namespace libcurlcxx
 		inline virtual std::string get_string() const & {
 			return "";
 		}
+		// ヘッダを受信し終わってbodyが来る前に、Content-Lengthが分かっている場合に呼ばれる
+		// 派生クラスでオーバライドして、受信するサイズ分の領域を一度に確保しておくと再確保とコピーが起きない
+		// size: これから受信するbodyのバイト数
+		virtual void set_expected_size(size_t size) {}
 
 		curl_base_stream_object(){}
 		virtual ~curl_base_stream_object(){}
@@ -116,6 +130,14 @@ namespace libcurlcxx
 		// ストリームへのポインタを返す。これは一時的なものである。解放してはいけない
 		T* get_stream() const noexcept {return _pstream.get();}
 
+		// 受信サイズが分かったときに呼ばれる。stringstreamの場合は中のstringを一度だけreserveする
+		virtual void set_expected_size(size_t size)
+		{
+			if constexpr (std::is_same_v<T, std::stringstream>){
+				writef::_reserve_stringstream(*_pstream, size);
+			}
+		}
+
 		// Stringの取得
 		inline virtual std::string get_string() const &
 		{
@@ -162,6 +184,14 @@ namespace libcurlcxx
 		// ストリームのSharedPtrをセットする
 		virtual void set_streamptr(std::shared_ptr<T>& pstreame) noexcept { _pstream = pstreame;}
 
+		// 受信サイズが分かったときに呼ばれる。stringstreamの場合は中のstringを一度だけreserveする
+		virtual void set_expected_size(size_t size)
+		{
+			if constexpr (std::is_same_v<T, std::stringstream>){
+				if(auto ptr = _pstream.lock()) writef::_reserve_stringstream(*ptr, size);
+			}
+		}
+
 		// Stringの取得
 		inline virtual std::string get_string() const &
 		{
@@ -186,10 +216,8 @@ namespace libcurlcxx
 		size_t internal_write(char *buffer, size_t realsize)
 		{
 			std::vector<Ty>* const pvec = get_stream();
-			const auto oldsize = pvec->size();
-
-			pvec->resize(oldsize + realsize);
-			std::copy(buffer, buffer+realsize, pvec->begin()+oldsize);
+			// resizeしてからコピーするとゼロ埋めしてから上書きすることになるので、直接末尾に追加する
+			pvec->insert(pvec->end(), buffer, buffer + realsize);
 
 			return realsize;
 		}
@@ -211,6 +239,12 @@ namespace libcurlcxx
 		virtual ~curl_base_unique_vec_stream(){}
 		// 一時的なベクタへのポインタを返す
 		std::vector<Ty>* get_stream() const noexcept {return _pvec.get();}
+
+		// 受信サイズが分かったときに呼ばれる。受信する分を一度だけreserveする
+		virtual void set_expected_size(size_t size)
+		{
+			_pvec->reserve(_pvec->size() + size);
+		}
 	};
 
 
@@ -226,11 +260,8 @@ namespace libcurlcxx
 		size_t internal_write(char *buffer, size_t realsize)
 		{
 			if(auto pvec = _pvec.lock()){
-				const auto oldsize = pvec->size();
-
-				pvec->resize(oldsize + realsize);
-				std::copy_n(buffer, realsize, std::next(pvec->begin(), oldsize));
-//  std::copy(buffer, buffer+realsize, pvec->begin()+oldsize);
+				// resizeしてからコピーするとゼロ埋めしてから上書きすることになるので、直接末尾に追加する
+				pvec->insert(pvec->end(), buffer, buffer + realsize);
 			}
 			return realsize;
 		}
@@ -252,6 +283,12 @@ namespace libcurlcxx
 		virtual ~curl_base_weak_vec_stream(){}
 		// ストリームのSharedPtrをセットする
 		virtual void set_streamptr(std::shared_ptr<std::vector<Ty>>& vec) noexcept { _pvec = vec;}
+
+		// 受信サイズが分かったときに呼ばれる。受信する分を一度だけreserveする
+		virtual void set_expected_size(size_t size)
+		{
+			if(auto pvec = _pvec.lock()) pvec->reserve(pvec->size() + size);
+		}
 	};
 
 	// 基本的に使用されると思われるストリームの型宣言
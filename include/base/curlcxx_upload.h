@@ -0,0 +1,166 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <curl/curl.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace libcurlcxx
+{
+	// 送信するデータ(リクエストのbody)を渡すクラスの根底となるクラス
+	// 受信側のcurl_base_stream_objectと対になるもので、CURLOPT_READFUNCTIONとCURLOPT_SEEKFUNCTIONで使われる
+	// このクラスを派生して、read/seekのコールバック関数と送信するサイズを設定すること
+	class curl_base_upload_object
+	{
+	private:
+		curl_read_callback	_read_callback;		// CURLOPT_READFUNCTIONで設定するコールバック関数
+		curl_seek_callback	_seek_callback;		// CURLOPT_SEEKFUNCTIONで設定するコールバック関数
+	protected:
+		// コールバック関数のセット
+		void set_read_callback(curl_read_callback fcallbk) noexcept		{ _read_callback = fcallbk;}
+		void set_seek_callback(curl_seek_callback fcallbk) noexcept		{ _seek_callback = fcallbk;}
+
+	public:
+		// コールバック関数の取得。CURLOPT_READFUNCTION / CURLOPT_SEEKFUNCTIONで設定する時に使う
+		curl_read_callback get_read_function() const noexcept		{ return _read_callback;}
+		curl_seek_callback get_seek_function() const noexcept		{ return _seek_callback;}
+
+		// 送信する全体のバイト数を返す。分からない場合は-1(HTTP/1.1ではchunkedで送られる)
+		virtual curl_off_t get_size() const		{ return -1;}
+		// easyに設定されたときに呼ばれる。同じオブジェクトで何度も送れるよう、読み出し位置を先頭に戻す
+		virtual void rewind() {}
+
+		curl_base_upload_object() : _read_callback(nullptr), _seek_callback(nullptr){}
+		virtual ~curl_base_upload_object(){}
+	};
+
+	// 複数のバッファを順に並べて1つのbodyとして送るクラス(writevのiovecのようなもの)
+	// ヘッダ部分とペイロード部分などを1つの文字列につなげずにそのまま送ることができる
+	// append(ptr, size)で追加したバッファはコピーしないので、performが終わるまで呼び出し元で保持すること
+	// append(std::string&&)で追加したものはこのクラスが引き取って保持する
+	class curl_base_iovec_upload : public curl_base_upload_object
+	{
+	private:
+		struct segment
+		{
+			const char		*data;
+			size_t			size;
+		};
+		std::vector<segment>		segments;		// 送るバッファの並び
+		std::deque<std::string>		owned;			// 引き取った文字列(dequeなので追加しても中身は動かない)
+		size_t						total;			// 全体のバイト数
+		size_t						index;			// 読み出し中のsegment
+		size_t						offset;			// segments[index]の中の読み出し位置
+
+		size_t internal_read(char *buffer, size_t realsize);
+		bool internal_seek(curl_off_t pos);
+		static size_t _read_func(char *buffer, size_t size, size_t nitems, void *instream);
+		static int _seek_func(void *instream, curl_off_t offset, int origin);
+
+		// コピー禁止
+		curl_base_iovec_upload &operator=(curl_base_iovec_upload const &) = delete;
+		curl_base_iovec_upload(curl_base_iovec_upload const &) = delete;
+
+	public:
+		curl_base_iovec_upload();
+		virtual ~curl_base_iovec_upload(){}
+
+		void append(const void *data, size_t size);
+		void append(std::string_view data);
+		void append(std::string &&data);
+		void clear() noexcept;
+
+		virtual curl_off_t get_size() const		{ return static_cast<curl_off_t>(total);}
+		virtual void rewind()					{ index = 0; offset = 0;}
+		// 追加したバッファの数を返す
+		inline size_t get_count() const noexcept	{ return segments.size();}
+	};
+
+	// 送るデータを関数で少しずつ作って渡すクラス
+	// 送信するたびにgeneratorが呼ばれ、bufferに最大sizeバイトまで書き込んで書いたバイト数を返す。終わりなら0を返す
+	// rewindを指定しておくと、リダイレクトや認証で送り直す場合に最初から作り直せる
+	class curl_base_generator_upload : public curl_base_upload_object
+	{
+	public:
+		using generator_func = std::function<size_t(char *buffer, size_t size)>;
+		using rewind_func = std::function<bool()>;
+
+	private:
+		generator_func		generator;		// データを作る関数
+		rewind_func			rewinder;		// 最初に戻す関数。なければ送り直しはできない
+		curl_off_t			size;			// 全体のバイト数。分からない場合は-1
+
+		static size_t _read_func(char *buffer, size_t size, size_t nitems, void *instream);
+		static int _seek_func(void *instream, curl_off_t offset, int origin);
+
+		// コピー禁止
+		curl_base_generator_upload &operator=(curl_base_generator_upload const &) = delete;
+		curl_base_generator_upload(curl_base_generator_upload const &) = delete;
+
+	public:
+		explicit curl_base_generator_upload(generator_func gen, curl_off_t _size = -1, rewind_func _rewind = nullptr);
+		virtual ~curl_base_generator_upload(){}
+
+		virtual curl_off_t get_size() const		{ return size;}
+		void rewind() override;
+	};
+
+	// 長さの分からないデータを、別のスレッドから届いた分だけchunkedで送るクラス
+	// 送る側のスレッドはpushでデータを積み、最後にfinishを呼ぶ
+	// performしているスレッドは、データが積まれるまでread関数の中で待つ
+	// 注意：待つ間はperformしているスレッドが止まるので、multiのループでは使わないこと
+	class curl_base_chunked_upload : public curl_base_upload_object
+	{
+	private:
+		std::mutex					lk;				// 以下の保護用
+		std::condition_variable		cv;				// pushかfinishされたら起こす
+		std::deque<std::string>		queue;			// まだ送っていないデータ
+		size_t						front_offset;	// queue.front()の中の送信済みバイト数
+		bool						finished;		// finishされたか
+		bool						aborted;		// abortされたか
+
+		size_t internal_read(char *buffer, size_t realsize);
+		static size_t _read_func(char *buffer, size_t size, size_t nitems, void *instream);
+
+		// コピー禁止
+		curl_base_chunked_upload &operator=(curl_base_chunked_upload const &) = delete;
+		curl_base_chunked_upload(curl_base_chunked_upload const &) = delete;
+
+	public:
+		curl_base_chunked_upload();
+		virtual ~curl_base_chunked_upload(){}
+
+		void push(std::string_view data);
+		void push(std::string &&data);
+		void finish();
+		void abort();
+	};
+}  // namespace libcurlcxx
@@ -0,0 +1,157 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <curl/curl.h>
+
+#include "curlcxx_base_object.h"
+
+namespace libcurlcxx
+{
+	// curl_base_url_parts : RFC3986に従ってURLを成分ごとに切り分けたもの
+	// 各成分は元のURL文字列を指すstring_viewなので、元の文字列より長く使わないこと
+	// 正規表現は使わず、先頭から1回なめるだけで切り分ける。メモリ確保もしない
+	//
+	// 使い方
+	//  auto p = curl_base_url_parts::parse("https://user@example.com:8080/a/b.jpg?x=1#top");
+	//  p.scheme     -> "https"
+	//  p.authority  -> "user@example.com:8080"
+	//  p.userinfo   -> "user"
+	//  p.host       -> "example.com"		(IPv6アドレスは"[::1]"のように括弧付きで入る)
+	//  p.port       -> "8080"
+	//  p.path       -> "/a/b.jpg"
+	//  p.query      -> "x=1"
+	//  p.fragment   -> "top"
+	//  p.filename() -> "b.jpg"
+	//
+	// 切り分けはRFC3986 Appendix Bの正規表現と同じ結果になる。URLとして正しいかどうかの検査はしない
+	// 検査や正規化が必要な場合はcurl_base_urlを使うこと
+	//
+	// see also:
+	// https://datatracker.ietf.org/doc/html/rfc3986#appendix-B
+	struct curl_base_url_parts
+	{
+		std::string_view	scheme;			// "http"など。":"は含まない
+		std::string_view	authority;		// "//"の後から次の"/?#"まで
+		std::string_view	userinfo;		// authorityの"@"より前
+		std::string_view	host;			// authorityからuserinfoとportを除いたもの
+		std::string_view	port;			// authorityの最後の":"の後
+		std::string_view	path;			// authorityの後から"?#"まで
+		std::string_view	query;			// "?"の後から"#"まで。"?"は含まない
+		std::string_view	fragment;		// "#"の後すべて。"#"は含まない
+
+		bool	has_scheme		= false;
+		bool	has_authority	= false;	// "//"があったか (空のauthorityと区別するため)
+		bool	has_query		= false;	// "?"があったか (空のqueryと区別するため)
+		bool	has_fragment	= false;	// "#"があったか (空のfragmentと区別するため)
+
+		static curl_base_url_parts parse(std::string_view url) noexcept;
+
+		// pathからディレクトリ部分を抜いた"b.jpg"のようなファイル名を返す
+		std::string_view filename() const noexcept;
+		// portを数値で返す。portがない、または数値でない場合は-1
+		int port_number() const noexcept;
+	};
+
+	// CURLUハンドルのDeleter専用
+	struct _curl_url_handle_deleter
+	{
+		void operator()(CURLU *_cuh) const
+		{
+			if (_cuh == nullptr) return;  // nullptrのときは何もしない
+			curl_url_cleanup(_cuh);
+		}
+	};
+
+	// CURLUのunique_ptr ハンドル構造。ユニークなポインタとする
+	using curl_url_unique_handle = std::unique_ptr<CURLU, _curl_url_handle_deleter>;
+
+	// curl_base_url : libcurlのURL API(CURLU)をC++で実装したもの
+	// URLの組み立て・書き換えと、libcurlと同じ規則での検査・正規化を行う
+	// 成分を読み出すだけならcurl_base_url_partsの方が速い
+	//
+	// 使い方
+	//  curl_base_url base("https://api.example.com/v1/search");	// 正しくないURLなら例外
+	//  curl_base_url u = base.dup();								// 元のURLをコピーしてから
+	//  u.append_query("q=hello world");							// リクエストごとのクエリを足す
+	//  req.RequestSetupGet(u.get_url());							// "https://api.example.com/v1/search?q=hello+world"
+	//
+	// 失敗した場合はset_系はfalseを返し、get_errorstr()で原因が取れる
+	//
+	// see also:
+	// https://curl.se/libcurl/c/libcurl-url.html
+	class curl_base_url : public curl_base_object
+	{
+	private:
+		curl_url_unique_handle	handle;
+
+		// コピー禁止。複製したい場合はdup()を使う
+		curl_base_url &operator=(curl_base_url const &) = delete;
+		curl_base_url(curl_base_url const &) = delete;
+
+		explicit curl_base_url(CURLU *_cuh);
+
+	protected:
+		virtual void set_error(const int curl_code) noexcept;
+
+	public:
+		curl_base_url();
+		explicit curl_base_url(std::string_view url, unsigned int flags = 0);
+		curl_base_url(curl_base_url &&) noexcept = default;
+		curl_base_url &operator=(curl_base_url &&) noexcept = default;
+		~curl_base_url() noexcept = default;
+
+		curl_base_url dup() const;
+
+		bool set(CURLUPart part, std::string_view value, unsigned int flags = 0);
+		std::string get(CURLUPart part, unsigned int flags = 0) const;
+
+		// 成分ごとの設定。valueが空ならその成分を消す
+		inline bool set_url(std::string_view url, unsigned int flags = 0)	{ return set(CURLUPART_URL, url, flags);}
+		inline bool set_scheme(std::string_view value)		{ return set(CURLUPART_SCHEME, value);}
+		inline bool set_host(std::string_view value)		{ return set(CURLUPART_HOST, value);}
+		inline bool set_port(std::string_view value)		{ return set(CURLUPART_PORT, value);}
+		inline bool set_path(std::string_view value)		{ return set(CURLUPART_PATH, value, CURLU_URLENCODE);}
+		inline bool set_query(std::string_view value)		{ return set(CURLUPART_QUERY, value);}
+		inline bool set_fragment(std::string_view value)	{ return set(CURLUPART_FRAGMENT, value);}
+		// "name=value"をクエリの最後に"&"でつないで足す。値はURLエンコードされる
+		inline bool append_query(std::string_view value)	{ return set(CURLUPART_QUERY, value, CURLU_APPENDQUERY | CURLU_URLENCODE);}
+
+		// 成分ごとの取得。ない場合は空文字を返す
+		inline std::string get_url() const		{ return get(CURLUPART_URL);}
+		inline std::string get_scheme() const	{ return get(CURLUPART_SCHEME);}
+		inline std::string get_host() const		{ return get(CURLUPART_HOST);}
+		inline std::string get_port() const		{ return get(CURLUPART_PORT);}
+		inline std::string get_path() const		{ return get(CURLUPART_PATH);}
+		inline std::string get_query() const	{ return get(CURLUPART_QUERY);}
+		inline std::string get_fragment() const	{ return get(CURLUPART_FRAGMENT);}
+
+		// CURLUの生ハンドルを取得する (CURLOPT_CURLUに渡す場合など)
+		inline CURLU *get_uhandle() const noexcept	{ return handle.get();}
+	};
+}  // namespace libcurlcxx
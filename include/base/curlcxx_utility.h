@@ -31,9 +31,10 @@
 #include <vector>
 #include <algorithm>
 #include <mutex>
-#include <regex>
 #include <curl/curl.h>
 
+#include "curlcxx_url.h"
+
 #include <cstdio>
 
 
@@ -52,75 +53,57 @@ namespace libcurlcxx
 
 	class curl_base_utility
 	{
-	private:
-		// regexを用いてURL文字から切り出す
-		// indexは範囲超えていても構わないので気にしなくていいがマッチしない場合は空文字を返す
-		// index: https://datatracker.ietf.org/doc/html/rfc3986#appendix-B
-		// 2 = scheme
-		// 4 = authority
-		// 5 = path
-		// 7 = query
-		// 9 = fragment
-		// これ以外の値はあまり意味がない
-		static inline std::string _url_match_regex(std::string_view url, int index)
-		{
-			// see also RFC3986 https://datatracker.ietf.org/doc/html/rfc3986#appendix-B
-			constexpr std::string_view url_pattern = "^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\\?([^#]*))?(#(.*))?";
-			std::regex pattern(url_pattern.data());
-			std::smatch matches;
-			std::string fstr(url);      // regex_searchはbasic_string &しかとってくれないのでこうしないといけない...
-			if (!std::regex_search(fstr, matches, pattern)) return "";
-			// ここは範囲をはみ出しても問題ない(空文字が帰ってくる)
-			return matches[index];
-		}
-
 	public:
 		static time_t get_date(std::string_view format);
 
 		static std::string url_escape(std::string_view url);
 		static std::string url_unescape(std::string_view url);
 
+		// 呼び出し側のバッファに書き込むURLエンコード・デコード
+		// 英数字と"-._~"以外を"%XX"にする。libcurlのcurl_easy_escape/curl_easy_unescapeと同じ結果になる
+		// form: trueならapplication/x-www-form-urlencodedの形式で、空白を"+"にする(デコードでは"+"を空白に戻す)
+		//
+		// url_escape_toのdstはurl_escaped_length(src, form)バイト以上(上限はurl_escape_bound(src.size()))、url_unescape_toのdstはsrc.size()バイト以上必要
+		// 戻り値はdstに書き込んだバイト数。0終端はしない
+		// _appendの方はoutの最後に足していくので、クエリ文字列を1つの文字列に組み立てる場合に使う
+		static constexpr size_t url_escape_bound(size_t len) noexcept	{ return len * 3;}
+		static size_t url_escaped_length(std::string_view src, bool form = false) noexcept;
+		static size_t url_escape_to(std::string_view src, char *dst, bool form = false) noexcept;
+		static size_t url_unescape_to(std::string_view src, char *dst, bool form = false) noexcept;
+		static void url_escape_append(std::string &out, std::string_view src, bool form = false);
+		static void url_unescape_append(std::string &out, std::string_view src, bool form = false);
+
 		// RFC3986に基づくURLからの文字切り出し関連
+		// 中身はcurl_base_url_partsで切り分けている。何度も成分を取り出すならcurl_base_url_parts::parseを直接使う方がよい
 		// urlから"http"の文字を取得
 		static std::string url_from_scheme(std::string_view url){
-			return _url_match_regex(url, 2);
+			return std::string(curl_base_url_parts::parse(url).scheme);
 		}
 		// urlから"google.com"のサーバ(とポート番号があればポート番号)を示す文字を取得
 		// サーバー名だけが欲しい場合はurl_from_servernameを使うこと
 		static std::string url_from_authority(std::string_view url){
-			return _url_match_regex(url, 4);
+			return std::string(curl_base_url_parts::parse(url).authority);
 		}
 		// urlから"/pathname/filename.jpg"のパス名とファイル名を示す文字を取得
 		static std::string url_from_path(std::string_view url){
-			return _url_match_regex(url, 5);
+			return std::string(curl_base_url_parts::parse(url).path);
 		}
 		// urlから"?=aaa"のクエリを示す文字を取得
 		static std::string url_from_query(std::string_view url){
-			return _url_match_regex(url, 7);
+			return std::string(curl_base_url_parts::parse(url).query);
 		}
 		// urlから"#aaa"のフラグメントを取得
 		static std::string url_from_fragment(std::string_view url){
-			return _url_match_regex(url, 9);
+			return std::string(curl_base_url_parts::parse(url).fragment);
 		}
 		// urlからパス名を完全に抜いた"filename.jpg"というようなファイル名だけを取得
 		static std::string url_from_filename(std::string_view url){
-			std::string fpath = url_from_path(url);
-			if(fpath.empty()) return fpath;
-
-			size_t found = fpath.find_last_of("/\\");
-			if (found != std::string::npos) {
-				return fpath.substr(found + 1);
-			}
-			return fpath;		// セパレータがない場合はファイル名だけを返す。これでよいはず
+			return std::string(curl_base_url_parts::parse(url).filename());
 		}
 		// urlからサーバ名だけを取得。ポート名も欲しい場合はurl_from_authorityを使うこと
+		// "user@host"のuserinfoや、"[::1]:8080"のようなIPv6アドレスのポートも正しく取り除く
 		static std::string url_from_servername(std::string_view url){
-			std::string authority = curl_base_utility::url_from_authority(url);
-			size_t colonPos = authority.find(':');
-			if(colonPos != std::string::npos) {
-				return authority.substr(0, colonPos);
-			}
-			return authority;		// ":"が見つからん場合はそのまま返す
+			return std::string(curl_base_url_parts::parse(url).host);
 		}
 
 		static unsigned int get_curl_version_number() noexcept;
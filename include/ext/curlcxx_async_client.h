@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include "curlcxx_multi.h"
+#include "curlcxx_mpsc_queue.h"
+#include "curlcxx_http_req.h"
+
+namespace libcurlcxx
+{
+	// I/O専用スレッドで1つのcurl_base_multiを回し、どのスレッドからでもリクエストを投げられるようにしたもの
+	// curl_base_multiはスレッドセーフではないので、複数のスレッドから使いたい場合はこれを使う
+	// すべてのリクエストが1つの接続キャッシュとpollループを共有する
+	class curl_async_client
+	{
+	public:
+		// リクエストの完了時に呼ばれるコールバック関数
+		// I/Oスレッドから呼ばれるので、重い処理はしないこと。例外も投げないこと
+		// code: 転送結果のCURLcode。クライアントの破棄で中断された場合はCURLE_ABORTED_BY_CALLBACK
+		using callback_type = std::function<void(const std::shared_ptr<curl_http_request> &req, CURLcode code)>;
+
+	private:
+		// async_performされた1リクエスト分。futureで返すかcallbackで返すかのどちらか
+		struct async_job
+		{
+			std::shared_ptr<curl_http_request>	req;
+			callback_type						callback;
+			std::promise<CURLcode>				promise;
+			bool								use_promise;
+		};
+
+		curl_base_multi								multi;		// I/Oスレッドだけが触る
+		curl_base_mpsc_queue<async_job>				queue;		// 他のスレッドから受け付けたリクエスト
+		std::unordered_map<CURL*, async_job>		running;	// 実行中のリクエスト。I/Oスレッドだけが触る
+		std::atomic<bool>							stopping;	// 破棄中かどうか
+		std::thread									th;			// I/Oスレッド
+
+		// コピー禁止
+		curl_async_client &operator=(curl_async_client const &) = delete;
+		curl_async_client(curl_async_client const &) = delete;
+
+		void io_main();
+		void start_job(async_job &&job);
+		void drain_done();
+		static void finish_job(async_job &job, CURLcode code);
+		void enqueue(async_job &&job);
+
+	public:
+		curl_async_client();
+		~curl_async_client();
+
+		std::future<CURLcode> async_perform(const std::shared_ptr<curl_http_request> &req);
+		void async_perform(const std::shared_ptr<curl_http_request> &req, callback_type callback);
+	};
+}  // namespace libcurlcxx
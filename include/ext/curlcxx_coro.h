@@ -0,0 +1,103 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <unordered_map>
+
+#include "curlcxx_multi_epoll.h"
+#include "curlcxx_http_req.h"
+
+namespace libcurlcxx
+{
+	class curl_http_awaiter;
+
+	// コルーチンの戻り値型
+	// 呼び出すとすぐに実行が始まり、co_awaitで転送を待つところで中断される(投げっぱなしで使う)
+	// コルーチン内で処理されなかった例外はcurl_coro_loop::run_tasksから投げ直される
+	//
+	// curl_task fetch(curl_coro_loop &loop, std::string url)
+	// {
+	//     curl_http_request req(std::make_shared<curl_base_stringstream>());
+	//     req.RequestSetupGet(url);
+	//     CURLcode code = co_await req.async_perform(loop);
+	//     ...
+	// }
+	class curl_task
+	{
+	public:
+		struct promise_type
+		{
+			curl_task get_return_object() noexcept			{ return curl_task();}
+			std::suspend_never initial_suspend() noexcept	{ return {};}
+			std::suspend_never final_suspend() noexcept		{ return {};}
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept;
+		};
+	};
+
+	// async_performを待つためのループ
+	// curl_base_multi_epollで転送を進め、転送が終わったらそれを待っていたコルーチンをこのループのスレッドで再開する
+	class curl_coro_loop : public curl_base_multi_epoll
+	{
+	private:
+		std::unordered_map<CURL*, curl_http_awaiter*> waiters;		// 転送中のEasyハンドルと、それを待っているもの
+
+	public:
+		curl_coro_loop();
+		~curl_coro_loop() noexcept;
+
+		void start(curl_http_awaiter *awaiter);
+		void run_tasks();
+
+		// 完了を待っているコルーチンの数
+		inline size_t get_waiting() const noexcept		{ return waiters.size();}
+	};
+
+	// curl_http_request::async_performが返すもの。co_awaitすると転送が終わるまで中断する
+	// co_awaitの結果は転送結果のCURLcodeとなる
+	class curl_http_awaiter
+	{
+		friend class curl_coro_loop;
+	private:
+		curl_coro_loop			&loop;
+		curl_http_request		&req;
+		std::coroutine_handle<>	waiter;
+		CURLcode				result;
+
+	public:
+		curl_http_awaiter(curl_coro_loop &_loop, curl_http_request &_req) noexcept
+			: loop(_loop), req(_req), result(CURLE_OK) {}
+
+		bool await_ready() const noexcept		{ return false;}
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			waiter = h;
+			loop.start(this);
+		}
+		CURLcode await_resume() const noexcept	{ return result;}
+	};
+}  // namespace libcurlcxx
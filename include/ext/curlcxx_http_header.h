@@ -0,0 +1,105 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace libcurlcxx
+{
+	// curl_http_response_header : 受信したHTTPレスポンスヘッダを貯めて引けるようにするクラス
+	//
+	// ヘッダ1行ごとにstd::stringを作ったりstd::mapに入れたりせず、受信したヘッダの生データを
+	// 1つのバッファ(arena)にそのまま追記し、名前と値の位置(オフセット)と名前のハッシュ値だけを記録しておく
+	// 名前の比較は大文字小文字を区別しない。検索はハッシュ値で絞ってから比較する
+	// 次のレスポンスではバッファの容量はそのまま使い回すので、何度使ってもメモリ確保はほとんど起きない
+	//
+	// リダイレクトや100 Continueで複数のレスポンスを受けた場合は、最後のレスポンスのヘッダだけが残る
+	// 返すstring_viewは次のレスポンスを受信するかclearするまで有効
+	class curl_http_response_header
+	{
+	private:
+		// ヘッダ1つ分の位置情報。位置はarenaの先頭からのオフセット
+		struct entry
+		{
+			uint32_t	hash;			// 名前のハッシュ値(小文字にしたもの)
+			uint32_t	name_off;		// 名前の位置
+			uint32_t	name_len;		// 名前の長さ
+			uint32_t	value_off;		// 値の位置
+			uint32_t	value_len;		// 値の長さ
+		};
+
+		std::string				arena;			// 受信したヘッダの生データ
+		std::vector<entry>		entries;		// ヘッダの位置情報。受信順
+		uint32_t				status_len;		// arenaの先頭にあるステータス行の長さ
+		bool					complete;		// ヘッダを最後(空行)まで受信したか
+
+		static uint32_t hash_name(std::string_view name) noexcept;
+		static bool equal_name(std::string_view a, std::string_view b) noexcept;
+
+		inline std::string_view view(uint32_t off, uint32_t len) const noexcept
+		{
+			return std::string_view(arena.data() + off, len);
+		}
+
+	public:
+		curl_http_response_header();
+		~curl_http_response_header() noexcept{}
+
+		void feed(const char *buffer, size_t size);
+		void clear() noexcept;
+
+		bool find(std::string_view name, std::string_view &value) const noexcept;
+		std::string_view get(std::string_view name) const noexcept;
+
+		// 同じ名前のヘッダ(Set-Cookieなど)をすべて受信順にfuncに渡す
+		// func: void(std::string_view value)の形の関数
+		template<class F> void for_each(std::string_view name, F &&func) const
+		{
+			const uint32_t h = hash_name(name);
+			for(const auto &e : entries){
+				if(e.hash == h && equal_name(view(e.name_off, e.name_len), name)){
+					func(view(e.value_off, e.value_len));
+				}
+			}
+		}
+		// すべてのヘッダを受信順にfuncに渡す
+		// func: void(std::string_view name, std::string_view value)の形の関数
+		template<class F> void for_each(F &&func) const
+		{
+			for(const auto &e : entries){
+				func(view(e.name_off, e.name_len), view(e.value_off, e.value_len));
+			}
+		}
+
+		// ステータス行(HTTP/1.1 200 OKなど)を返す
+		inline std::string_view get_status_line() const noexcept	{ return view(0, status_len);}
+		// ヘッダの数を返す
+		inline size_t size() const noexcept						{ return entries.size();}
+		// ヘッダを最後まで受信したかを返す
+		inline bool is_complete() const noexcept				{ return complete;}
+	};
+}  // namespace libcurlcxx
@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace libcurlcxx
+{
+	// HTTP get 用のリクエストデータ定義。Key=Valueの形でマップ型の定義
+	// 名前順に並び替えられる。登録順に送りたい場合や、何度も組み立てる場合はcurl_http_param_listを使う
+	using curl_http_request_param = std::map<std::string, std::string>;
+
+	// curl_http_param_list : GETのクエリやPOSTのフォームに使う Key=Value のパラメータを登録順に持つクラス
+	//
+	// std::mapのように1要素ごとにstd::stringを作らず、名前と値を1つのバッファ(arena)に追記して位置(オフセット)だけを記録しておく
+	// 追加するときにURLエンコード後の長さも数えておくので、組み立てるときは出力の大きさがはじめから正確にわかり
+	// 1回確保して1回なめるだけで"a=1&b=2"の形にできる
+	// clearしてもバッファの容量はそのまま使い回すので、同じオブジェクトを使い続ければメモリ確保はほとんど起きない
+	//
+	// 使い方
+	//  curl_http_param_list para{{"q", "hello world"}, {"limit", "20"}};
+	//  para.add("lang", "ja");
+	//  req.RequestSetupGet(url, para);			// url?q=hello%20world&limit=20&lang=ja
+	//  req.RequestSetupPost(url, para);			// application/x-www-form-urlencodedのボディ q=hello+world&limit=20&lang=ja
+	//
+	// ファイルを送るなどmultipartが本当に必要な場合はcurl_base_mimeを使うこと
+	class curl_http_param_list
+	{
+	private:
+		// パラメータ1つ分の位置情報。位置はarenaの先頭からのオフセット
+		struct entry
+		{
+			uint32_t	name_off;		// 名前の位置
+			uint32_t	name_len;		// 名前の長さ
+			uint32_t	value_off;		// 値の位置
+			uint32_t	value_len;		// 値の長さ
+			uint32_t	query_len;		// クエリ形式でエンコードした"name=value"の長さ
+			uint32_t	form_len;		// フォーム形式でエンコードした"name=value"の長さ
+		};
+
+		std::string				arena;			// 名前と値の生データ
+		std::vector<entry>		entries;		// パラメータの位置情報。登録順
+
+		inline std::string_view view(uint32_t off, uint32_t len) const noexcept
+		{
+			return std::string_view(arena.data() + off, len);
+		}
+
+	public:
+		curl_http_param_list() = default;
+		curl_http_param_list(std::initializer_list<std::pair<std::string_view, std::string_view>> params);
+		explicit curl_http_param_list(const curl_http_request_param &params);
+		~curl_http_param_list() noexcept{}
+
+		void add(std::string_view name, std::string_view value);
+		void reserve(size_t count, size_t bytes);
+		void clear() noexcept;
+
+		size_t encoded_size(bool form = false) const noexcept;
+		size_t encode_to(char *dst, bool form = false) const noexcept;
+		void encode_append(std::string &out, bool form = false) const;
+
+		// "a=1&b=2"のクエリ文字列を返す。空白は"%20"になる
+		inline std::string to_query() const		{ std::string s; encode_append(s, false); return s;}
+		// application/x-www-form-urlencodedのボディを返す。空白は"+"になる
+		inline std::string to_form() const		{ std::string s; encode_append(s, true); return s;}
+
+		// i番目の名前と値を返す
+		inline std::string_view name(size_t i) const noexcept	{ return view(entries[i].name_off, entries[i].name_len);}
+		inline std::string_view value(size_t i) const noexcept	{ return view(entries[i].value_off, entries[i].value_len);}
+		// パラメータの数を返す
+		inline size_t size() const noexcept		{ return entries.size();}
+		inline bool empty() const noexcept		{ return entries.empty();}
+	};
+}  // namespace libcurlcxx
@@ -26,16 +26,20 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
 #include "curlcxx_easy.h"
+#include "curlcxx_easy_pool.h"
+#include "curlcxx_http_header.h"
+#include "curlcxx_http_param.h"
 #include "curlcxx_multi.h"
+#include "curlcxx_share.h"
 #include "curlcxx_slist.h"
 
 namespace libcurlcxx
 {
 	class curl_base_mime;
-
-	// HTTP get 用のリクエストデータ定義。Key=Valueの形でマップ型の定義
-	using curl_http_request_param = std::map<std::string, std::string>;
+	class curl_coro_loop;
+	class curl_http_awaiter;
 
 	class curl_http_request : public curl_base_easy
 	{
@@ -47,20 +51,34 @@ namespace libcurlcxx
 		long int				proxyport;				// Proxyのポート番号
 
 		curl_base_slist			http_header;		// 設定したカスタムヘッダ
+		std::shared_ptr<const curl_base_header_set>	header_set;	// 共有のヘッダセット。http_headerの後ろにつなぐ
+		curl_slist				*linked_tail;		// header_setをnextにつないだhttp_headerの最後のノード。つないでいなければnullptr
+		curl_http_response_header	response_header;	// 受信したレスポンスヘッダ
+		std::shared_ptr<const void>	post_body;			// CURLOPT_POSTFIELDSで渡しているデータの持ち主。転送が終わるまで保持する
+
+		// prePerformで同じ設定を毎回curl_easy_setoptしないためのフラグ
+		bool					opts_applied;		// 固定のオプションをセット済みか
+		bool					proxy_dirty;		// Proxy設定が変更されたか
+		bool					header_dirty;		// カスタムヘッダが変更されたか
 
 		// コピー禁止
 		curl_http_request &operator=(curl_http_request const &) = delete;
 		curl_http_request(curl_http_request const &) = delete;
 
-		std::string build_get_param(const curl_http_request_param& params);
+		void unlinkHeaderSet() noexcept;
+
 		bool build_post_param(const curl_http_request_param& params);
 
 	protected:
 		void setInternalProxy();
+		bool setInternalPostBody(std::shared_ptr<const void> &&owner, const void *data, size_t size);
+		virtual size_t internal_header_callback(char *buffer, size_t realsize);
 
 	public:
 		curl_http_request();
 		explicit curl_http_request(const std::shared_ptr<curl_base_stream_object> &_streamer);
+		explicit curl_http_request(const std::shared_ptr<curl_base_easy_pool> &pool);
+		curl_http_request(const std::shared_ptr<curl_base_stream_object> &_streamer, const std::shared_ptr<curl_base_easy_pool> &pool);
 
 		curl_http_request(curl_http_request &&) noexcept;
 		curl_http_request &operator= (curl_http_request &&) noexcept;
@@ -69,16 +87,30 @@ namespace libcurlcxx
 
 		virtual bool RequestSetupGet(std::string_view url);
 		virtual bool RequestSetupGet(std::string_view url, const curl_http_request_param& params);
+		virtual bool RequestSetupGet(std::string_view url, const curl_http_param_list& params);
 
 		virtual bool RequestSetupPost(std::string_view url, const std::shared_ptr<curl_base_mime> &mimes);
 		virtual bool RequestSetupPost(std::string_view url, const curl_http_request_param& params);
+		virtual bool RequestSetupPost(std::string_view url, const curl_http_param_list& params);
 		virtual bool RequestSetupPost(std::string_view url, std::string_view strdata);
+		virtual bool RequestSetupPost(std::string_view url, const char *strdata);
+		virtual bool RequestSetupPost(std::string_view url, std::string &&strdata);
+		virtual bool RequestSetupPost(std::string_view url, std::vector<uint8_t> &&data);
+		virtual bool RequestSetupPost(std::string_view url, const std::shared_ptr<const std::string> &data);
+		virtual bool RequestSetupPost(std::string_view url, const std::shared_ptr<const std::vector<uint8_t>> &data);
+		virtual bool RequestSetupPost(std::string_view url, const std::shared_ptr<curl_base_upload_object> &uploader);
+		virtual bool RequestSetupPut(std::string_view url, const std::shared_ptr<curl_base_upload_object> &uploader);
 
 		virtual void prePerform();
 		virtual void perform();
+		virtual curl_easy_result try_perform();
+		curl_http_awaiter async_perform(curl_coro_loop &loop);
 
 		virtual void appendHeader(std::string_view data);
 		virtual void removeHeader();
+		void setHeaderSet(const std::shared_ptr<const curl_base_header_set> &set);
+		// 設定した共有のヘッダセットを返す
+		inline const std::shared_ptr<const curl_base_header_set> &getHeaderSet() const noexcept	{ return header_set;}
 
 		// httpのレスポンスコードを返す
 		inline const long get_responceCode() noexcept
@@ -102,6 +134,18 @@ namespace libcurlcxx
 			get_info(CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, length);
 			return length;
 		}
+		// 受信したレスポンスヘッダを返す
+		// 返したオブジェクトの中身は次にperformするまで有効
+		inline const curl_http_response_header &get_ResponseHeader() const noexcept
+		{
+			return response_header;
+		}
+		// 受信したレスポンスヘッダから指定した名前の値を返す。大文字小文字は区別しない
+		// 見つからない場合は空を返す。返した値は次にperformするまで有効
+		inline std::string_view get_HeaderValue(std::string_view name) const noexcept
+		{
+			return response_header.get(name);
+		}
 		// performした結果、サーバから帰ってきたデータをStringで受け取る(streamがstringを返せる場合のみ)
 		inline std::string get_ContentString() const &
 		{
@@ -114,6 +158,7 @@ namespace libcurlcxx
 			proxyuser = user;
 			proxypass = passwd;
 			proxyport = port;
+			proxy_dirty = true;
 		}
 	};
 
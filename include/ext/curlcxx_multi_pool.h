@@ -0,0 +1,106 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "curlcxx_multi_epoll.h"
+#include "curlcxx_http_req.h"
+
+namespace libcurlcxx
+{
+	// 複数のcurl_base_multiのループを複数のスレッドで回すプール
+	// 一つのcurl_base_multiは1スレッドでしか動かせないので、CPUコアを使い切りたい場合はこれを使う
+	//
+	// 同じホストへのリクエストは必ず同じループに割り振られるので、HTTP/2の接続はループ内で再利用される
+	// 暇になったループは忙しいループの未実行のリクエストを盗んで実行する
+	class curl_multi_pool
+	{
+	public:
+		// リクエストの完了時に呼ばれるコールバック関数
+		// リクエストを実行したループのスレッドから呼ばれる。例外を投げないこと
+		// code: 転送結果のCURLcode。プールの破棄で中断された場合はCURLE_ABORTED_BY_CALLBACK
+		using callback_type = std::function<void(const std::shared_ptr<curl_http_request> &req, CURLcode code)>;
+
+	private:
+		// submitされた1リクエスト分
+		struct pool_job
+		{
+			std::shared_ptr<curl_http_request>	req;
+			callback_type						callback;
+		};
+
+		// 1スレッド分のループ
+		struct pool_worker
+		{
+			curl_base_multi_epoll					multi;		// このループが所有するmulti
+			std::mutex								lk;			// pendingの保護用
+			std::deque<pool_job>					pending;	// まだmultiに登録していないリクエスト。他のループから盗まれることもある
+			std::unordered_map<CURL*, pool_job>		running;	// 実行中のリクエスト。このループのスレッドからしか触らない
+			std::atomic<size_t>						nrunning;	// runningの数(他のスレッドから見る用)
+			std::atomic<bool>						idle;		// 何も実行していないかどうか
+			std::thread								th;
+
+			pool_worker() : nrunning(0), idle(false) {}
+		};
+
+		std::vector<std::unique_ptr<pool_worker>> workers;
+		size_t max_transfers;						// 1ループあたりの同時転送数の上限
+		std::atomic<bool> stopping;					// 破棄中かどうか
+
+		std::mutex done_lk;							// outstandingの保護用
+		std::condition_variable done_cv;			// wait用
+		size_t outstanding;							// 完了していないリクエストの数
+
+		// コピー禁止
+		curl_multi_pool &operator=(curl_multi_pool const &) = delete;
+		curl_multi_pool(curl_multi_pool const &) = delete;
+
+		void worker_main(pool_worker &w);
+		void fill_worker(pool_worker &w);
+		bool steal_work(pool_worker &w);
+		void drain_worker(pool_worker &w);
+		void abort_worker(pool_worker &w);
+		void finish_job(pool_job &job, CURLcode code);
+		size_t select_worker(const std::shared_ptr<curl_http_request> &req) const;
+
+	public:
+		explicit curl_multi_pool(size_t nloops = 0, size_t max_transfers_per_loop = 64);
+		~curl_multi_pool();
+
+		void submit(const std::shared_ptr<curl_http_request> &req, callback_type callback = nullptr);
+		void wait();
+
+		// ループ(スレッド)の数を返す
+		inline size_t get_loop_count() const noexcept		{ return workers.size();}
+	};
+}  // namespace libcurlcxx
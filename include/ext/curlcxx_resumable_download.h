@@ -0,0 +1,131 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "curlcxx_http_req.h"
+
+namespace libcurlcxx
+{
+	// 途中で切れても続きからダウンロードし直せるダウンロードクラス
+	//
+	// 受信しながら、保存先ファイルの横にチェックポイントファイル(保存先 + ".ckpt")を定期的に書く
+	// チェックポイントにはURL、ETagかLast-Modified、受信済みの範囲、受信済みのデータのハッシュ値(任意)が入る
+	// 次にdownloadを呼ぶとチェックポイントを読み、続きの位置からRangeとIf-Rangeでリクエストする
+	// サーバ上のファイルが変わっていた場合はサーバが206ではなく200で全体を返してくるので、途中までのデータは捨てて最初から書き直す
+	// ETagもLast-Modifiedもないサーバでは安全に続きを取れないので、常に最初からになる
+	//
+	// 転送が途中で切れた場合は、同じdownloadの中でもmax_retries回まで続きから取り直す
+	// 最後まで受信できたらチェックポイントファイルは消す
+	class curl_resumable_download
+	{
+	public:
+		// 進捗通知用のコールバック関数
+		// downloaded: ダウンロード済みのバイト数(前回までの分を含む)
+		// total: 全体のバイト数(不明な場合は0)
+		using progress_callback = std::function<void(size_t downloaded, size_t total)>;
+
+	private:
+		class resume_stream;
+
+		// チェックポイントの内容
+		struct checkpoint
+		{
+			std::string		url;			// ダウンロードするURL
+			std::string		validator;		// If-Rangeに使うETagかLast-Modified
+			size_t			total;			// 全体のサイズ(不明な場合は0)
+			size_t			done;			// 受信済みの範囲[0, done)
+			uint64_t		hash;			// [0, done)のハッシュ値(FNV-1a)
+			bool			has_hash;		// hashが有効か
+		};
+
+		std::vector<std::string>	headers;			// 追加するヘッダ
+		size_t						checkpoint_bytes;	// これだけ受信するごとにチェックポイントを書く
+		std::chrono::milliseconds	checkpoint_interval;	// 前回からこれだけ経っていればチェックポイントを書く
+		bool						use_hash;			// ハッシュ値で途中までのファイルを検証するか
+		int							max_retries;		// 切れた場合の取り直し回数
+		std::chrono::milliseconds	retry_wait;			// 取り直す前に待つ時間
+		progress_callback			progress;			// 進捗通知
+
+		int							fd;					// 保存先ファイル
+		std::string					path;				// 保存先ファイルのパス
+		std::string					ckpt_path;			// チェックポイントファイルのパス
+		checkpoint					ck;					// 現在の状態
+		size_t						resumed_from;		// 最初に続きから始めた位置
+		size_t						unsaved;			// 前回チェックポイントを書いてから受信したバイト数
+		std::chrono::steady_clock::time_point	last_saved;	// 前回チェックポイントを書いた時刻
+
+		// コピー禁止
+		curl_resumable_download &operator=(curl_resumable_download const &) = delete;
+		curl_resumable_download(curl_resumable_download const &) = delete;
+
+		bool load_checkpoint(std::string_view url);
+		bool save_checkpoint();
+		bool verify_partial();
+		bool attempt();
+		void close_file() noexcept;
+
+		static uint64_t hash_update(uint64_t h, const char *buffer, size_t size) noexcept;
+
+	public:
+		curl_resumable_download();
+		~curl_resumable_download() noexcept;
+
+		void download(std::string_view url, std::string_view _path);
+
+		// リクエストに追加するヘッダを設定する。downloadの前に呼ぶこと
+		inline void appendHeader(std::string_view data)			{ headers.emplace_back(data);}
+		// 進捗通知のコールバック関数を設定する。受信するたびに呼ばれる
+		inline void set_progress_callback(progress_callback func)	{ progress = std::move(func);}
+		// チェックポイントを書く間隔を設定する。bytes受信するかintervalが経過するたびに書く
+		inline void set_checkpoint_interval(size_t bytes, std::chrono::milliseconds interval) noexcept
+		{
+			checkpoint_bytes = bytes;
+			checkpoint_interval = interval;
+		}
+		// 続きから始める前に、途中までのファイルがチェックポイントのハッシュ値と一致するか検証するかを設定する
+		// 検証する場合は、途中までの分を一度読み直すことになる
+		inline void set_verify_hash(bool onoff) noexcept		{ use_hash = onoff;}
+		// 切れた場合の取り直し回数と、取り直す前に待つ時間を設定する
+		inline void set_max_retries(int retries, std::chrono::milliseconds wait = std::chrono::milliseconds(1000)) noexcept
+		{
+			max_retries = retries;
+			retry_wait = wait;
+		}
+
+		// 全体のサイズを返す(不明な場合は0)
+		inline size_t get_size() const noexcept				{ return ck.total;}
+		// 受信済みのバイト数を返す
+		inline size_t get_downloaded() const noexcept		{ return ck.done;}
+		// 前回のチェックポイントから続きを始めた位置を返す(最初からの場合は0)
+		inline size_t get_resumed_from() const noexcept		{ return resumed_from;}
+	};
+}  // namespace libcurlcxx
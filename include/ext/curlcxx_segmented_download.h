@@ -0,0 +1,130 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "curlcxx_multi.h"
+#include "curlcxx_http_req.h"
+
+namespace libcurlcxx
+{
+	// 1つのファイルを複数のRangeリクエストに分けて、1つのcurl_base_multiで並列にダウンロードするクラス
+	//
+	// 1本のTCP接続では帯域を使い切れない太い回線で、大きいファイルを速くダウンロードするためのもの
+	// 1. HEADでサイズとRange対応(Accept-Ranges: bytes)を調べる
+	// 2. 出力ファイルをposix_fallocateで確保し、ファイルをいくつかの区間(segment)に分けてそれぞれをRangeリクエストで取る
+	//    受信したデータは各区間の位置にpwriteで直接書き込む
+	// 3. 定期的に区間ごとのスループットを測り、全体のスループットが伸びているうちは区間を増やす(max_segmentsまで)
+	//    区間を増やすときや、区間が終わって空きができたときは、残り時間が一番長い区間を半分に分けて後ろ半分を新しい区間にする
+	// Range非対応やサイズ不明の場合は、普通に1本のリクエストでダウンロードする
+	//
+	// 途中で切れた区間は、受信済みの位置から取り直す(max_retriesまで)
+	// ETagがある場合はIf-Rangeを付けるので、途中でファイルが変わった場合は失敗になる
+	class curl_segmented_download
+	{
+	public:
+		// 進捗通知用のコールバック関数
+		// downloaded: ダウンロード済みのバイト数
+		// total: 全体のバイト数(不明な場合は0)
+		// segments: 現在転送中の区間の数
+		using progress_callback = std::function<void(size_t downloaded, size_t total, size_t segments)>;
+
+	private:
+		class segment_stream;
+
+		// 区間1つ分。[pos, end)がまだ取っていない範囲
+		struct segment
+		{
+			size_t								start;			// 区間の先頭(リクエストを出した位置)
+			size_t								pos;			// 次に書き込む位置
+			size_t								end;			// 区間の終わり(これを含まない)。分割されると縮む
+			std::shared_ptr<curl_http_request>	req;			// 転送中のリクエスト
+			size_t								tick_bytes;		// 前回の計測からの受信バイト数
+			double								rate;			// 受信速度(バイト/秒)
+			int									retries;		// 取り直した回数
+			bool								io_error;		// 書き込みに失敗したか
+			bool								bad_response;	// 206以外が返ってきたか
+		};
+
+		std::string								url;				// ダウンロードするURL(リダイレクト後のもの)
+		std::vector<std::string>				headers;			// 追加するヘッダ
+		std::string								if_range;			// If-Rangeヘッダ
+		size_t									max_segments;		// 同時に転送する区間の最大数
+		size_t									initial_segments;	// 最初に分ける区間の数
+		size_t									min_segment_size;	// これより小さくは分けない
+		int										max_retries;		// 区間ごとの取り直し回数の上限
+		progress_callback						progress;			// 進捗通知
+
+		curl_base_multi							multi;
+		std::vector<std::unique_ptr<segment>>	segments;			// 全区間。ストリームがポインタを持つのでunique_ptrで持つ
+		int										fd;					// 出力ファイル
+		size_t									total;				// ファイル全体のサイズ
+		size_t									downloaded;			// ダウンロード済みのバイト数
+		size_t									active;				// 転送中の区間の数
+		size_t									target;				// 現在目標にしている同時転送数
+		size_t									peak;				// 同時転送数の最大
+		double									last_rate;			// 前回区間を増やしたときの全体の受信速度
+		std::string								error;				// 失敗の理由
+
+		// コピー禁止
+		curl_segmented_download &operator=(curl_segmented_download const &) = delete;
+		curl_segmented_download(curl_segmented_download const &) = delete;
+
+		bool probe(std::string_view _url);
+		void download_single(std::string_view path);
+		void download_ranged(std::string_view path);
+
+		void start_segment(segment *seg);
+		void on_segment_done(segment *seg, CURLcode code);
+		bool split_slowest();
+		void adapt(double dt);
+		void fail(std::string_view mess);
+
+	public:
+		explicit curl_segmented_download(size_t _max_segments = 8, size_t _initial_segments = 2, size_t _min_segment_size = 1024 * 1024);
+		~curl_segmented_download() noexcept;
+
+		void download(std::string_view _url, std::string_view path);
+
+		// リクエストに追加するヘッダを設定する。downloadの前に呼ぶこと
+		inline void appendHeader(std::string_view data)			{ headers.emplace_back(data);}
+		// 進捗通知のコールバック関数を設定する。転送中に定期的に呼ばれる
+		inline void set_progress_callback(progress_callback func)	{ progress = std::move(func);}
+		// 区間ごとの取り直し回数の上限を設定する
+		inline void set_max_retries(int retries) noexcept		{ max_retries = retries;}
+
+		// ファイル全体のサイズを返す
+		inline size_t get_size() const noexcept					{ return total;}
+		// 同時に転送した区間の数の最大を返す(Range非対応で1本で取った場合は1)
+		inline size_t get_peak_segments() const noexcept		{ return peak;}
+		// 分けた区間の数を返す
+		inline size_t get_total_segments() const noexcept		{ return segments.size();}
+	};
+}  // namespace libcurlcxx
@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <map>
 #include <string>
 #include <memory>
@@ -47,12 +48,13 @@ namespace libcurlcxx
 
 		curl_base_slist			http_header;		// 設定したカスタムヘッダ
 
-		std::string build_get_param(const curl_http_request_param& params);
-
 		bool	isconnected;					// 接続中かどうか
 		bool	sendrecv_debug;					// sendとrecvのデバッグフラグ
 		size_t	internal_rbufsize;				// 内部受取バッファサイズ
 
+		CURLcode wait_readable(const std::chrono::steady_clock::time_point *deadline);
+		template<typename F> curl_easy_result recv_frame(F &&append, int timeout_ms);
+
 	public:
 		curl_websocket();
 		explicit curl_websocket(std::string_view url);
@@ -65,9 +67,11 @@ namespace libcurlcxx
 
 		virtual bool RequestSetupGet(std::string_view url);
 		virtual bool RequestSetupGet(std::string_view url, const curl_http_request_param& params);
+		virtual bool RequestSetupGet(std::string_view url, const curl_http_param_list& params);
 
 		virtual void prePerform();
 		virtual void perform();
+		virtual curl_easy_result try_perform();
 
 		void close();
 
@@ -130,6 +134,13 @@ namespace libcurlcxx
 		bool recv_text(std::string &rtext);
 		bool recv_text(std::stringstream &rtextstr);
 
+		// タイムアウト付きの受信。データが来るまではソケットをpollで待つので、待っている間CPUを使わない
+		// timeout_ms: 最大の待ち時間(ミリ秒)。-1ならデータが来るまで待つ
+		curl_easy_result recv_binary(std::vector<uint8_t> &rvec, int timeout_ms);
+		curl_easy_result recv_text(std::string &rtext, int timeout_ms);
+		curl_easy_result recv_text(std::stringstream &rtextstr, int timeout_ms);
+		bool wait_recved(bool &istext, bool &iserr, int timeout_ms);
+
 		// 何か受信したかを返す
 		// これは次に続くデータがTextかBinaryかの判断にも必要
 		// なにも受信がなければブロッキングせずに帰ってくる(iserr=false, return=false)
@@ -47,6 +47,7 @@ using libcurlcxx::curl_base_stringstream;
 using libcurlcxx::curl_base_utility;
 using libcurlcxx::curl_base_exception;
 using libcurlcxx::curl_base_mime;
+using libcurlcxx::curl_base_share;
 
 using libcurlcxx::curl_http_request;
 using libcurlcxx::curl_http_request_param;
@@ -60,6 +61,15 @@ using std::map;
 // 使用の際はこれの定義が必要
 static libcurlcxx::curl_base_cdtor _libcurl;
 
+// 3つのリクエストで接続・DNS・TLSセッションを使い回すためのshare
+// 同じサーバに続けてリクエストするので、2回目以降はハンドシェイクを省略できる
+static auto _share = []() {
+	auto share = std::make_shared<curl_base_share>();
+	// このサンプルは1つのスレッドで順番にリクエストするので接続も共有する
+	share->share(CURL_LOCK_DATA_CONNECT);
+	return share;
+}();
+
 // エンドポイント
 static constexpr string_view bluesky_resolve_handle_endp("com.atproto.identity.resolveHandle");
 static constexpr string_view bluesky_create_session_endp("com.atproto.server.createSession");
@@ -74,6 +84,7 @@ static constexpr string_view bluesky_server("https://bsky.social/xrpc/");
 static std::string resolveHandletoDid(string_view server_url, string_view user_handle)
 {
 	curl_http_request req(std::make_shared<curl_base_stringstream>());
+	req.set_share(_share);
 	curl_http_request_param para;
 	std::string url(server_url);
 
@@ -144,6 +155,7 @@ static std::string resolveHandletoDid(string_view server_url, string_view user_h
 static std::string createSession(string_view server_url, string_view did, string_view ap_pass)
 {
 	curl_http_request req(std::make_shared<curl_base_stringstream>());
+	req.set_share(_share);
 	std::string url(server_url);
 
 	url += bluesky_create_session_endp;
@@ -158,7 +170,7 @@ static std::string createSession(string_view server_url, string_view did, string
 	_root.add("password", ap_pass);
 	poststr = _root.serialize();
 
-	req.RequestSetupPost(url, poststr);
+	req.RequestSetupPost(url, std::move(poststr));		// 作った文字列はコピーせずにそのまま渡す
 
 //  std::cout << "url: " << req.get_url() << std::endl;
 	try {
@@ -218,6 +230,7 @@ static std::string createSession(string_view server_url, string_view did, string
 static std::string getTimeline(string_view server_url, string_view bearer, int limits)
 {
 	curl_http_request req(std::make_shared<curl_base_stringstream>());
+	req.set_share(_share);
 	curl_http_request_param para;
 	std::string url(server_url);
 
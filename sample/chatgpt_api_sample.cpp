@@ -24,10 +24,12 @@
 // OpenAIのAPIを使用してChatGPTに質問するサンプル
 // 事前にOpenAIにAPI使用の申請が必要です
 
+#include <chrono>
 #include <map>
 #include <memory>
 #include "curlcxx_cdtor.h"
 #include "curlcxx_http_req.h"
+#include "curlcxx_sse_stream.h"
 #include "curlcxx_utility.h"
 #include "curlcxx_error.h"
 
@@ -39,6 +41,8 @@ using libcurlcxx::curl_base_stringstream;
 using libcurlcxx::curl_base_utility;
 using libcurlcxx::curl_base_exception;
 using libcurlcxx::curl_base_mime;
+using libcurlcxx::curl_base_sse_stream;
+using libcurlcxx::curl_base_sse_event;
 
 using libcurlcxx::curl_http_request;
 using libcurlcxx::curl_http_request_param;
@@ -177,12 +181,14 @@ static bool parseJson(const std::string &src, std::string &r_message)
 // {"model": "gpt-3.5-turbo","messages": [{"role": "user", "content": "Hello!"}]}
 // みたいなJsonデータを生成
 // message: 問いたいメッセージを指定する
+// stream: trueにすると"stream": trueを付けて、結果をServer-Sent Eventsで少しずつ返してもらう
 // ret:
 //  json形式に直したものが出てくる。これをそのまま投げること
-std::string create_message_json(std::string_view message)
+std::string create_message_json(std::string_view message, bool stream = false)
 {
 	picojson_helper::writer _root;
 	_root.add("model", "gpt-3.5-turbo-1106");		// 現在は1106
+	if(stream) _root.add("stream", stream);
 
 	std::vector<chatgpt_send_messages_json> vec;
 	chatgpt_send_messages_json sh;
@@ -279,6 +285,83 @@ int chat(const string &user_message)
 	return 0;
 }
 
+// ストリーミングで来るイベント1つ分のJSONから、追加された文字列を取り出す
+// choices[0].delta.content に入っている。最初と最後のイベントにはcontentがない
+static bool parseDeltaJson(std::string_view src, std::string &r_message)
+{
+	picojson::value jsonval;
+	string json_err;
+
+	r_message.clear();
+	picojson::parse(jsonval, src.begin(), src.end(), &json_err);
+	if(!json_err.empty() || !jsonval.is<picojson::object>()) return false;
+
+	try{
+		auto &delta = jsonval.get<picojson::object>()["choices"].get<picojson::array>()[0].get<picojson::object>()["delta"].get<picojson::object>();
+		if(delta["content"].is<std::string>()) r_message = delta["content"].get<std::string>();
+	}catch(...){
+		return false;
+	}
+	return true;
+}
+
+// OpenAIのAPIにstream付きで問い合わせる
+// 全部の返答が揃うのを待たずに、イベントが届くたびにその分を表示する
+int chat_stream(const string &user_message)
+{
+	string api_kerstr;
+	if(!getAPIKey(api_kerstr)) return -1;
+
+	const auto start = std::chrono::steady_clock::now();
+	bool first = true;
+	bool done = false;
+
+	auto sse = std::make_shared<curl_base_sse_stream>([&](const curl_base_sse_event &ev) {
+		// 最後は data: [DONE] が来る
+		if(ev.data == "[DONE]"){
+			done = true;
+			return false;
+		}
+		std::string delta;
+		if(!parseDeltaJson(ev.data, delta)) return true;
+		if(first){
+			first = false;
+			const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "(first event " << ms << " ms)" << std::endl;
+		}
+		std::cout << delta << std::flush;
+		return true;
+	});
+
+	curl_http_request req(sse);
+	req.appendHeader("Content-Type: application/json");
+	req.appendHeader("Accept: text/event-stream");
+	req.appendHeader(libcurlcxx::format("Authorization: Bearer %s", api_kerstr.data()));
+	req.RequestSetupPost(chatgpt_endpoint, create_message_json(user_message, true));
+
+	std::cout << "url: " << req.get_url() << std::endl;
+	try {
+		std::cout << "contacting openai..... " << std::endl;
+		req.perform();
+	} catch (curl_base_exception &error) {
+		// [DONE]でコールバックがfalseを返して中断した場合もここに来る
+		if(!done){
+			std::cerr << error.what() << std::endl;
+			return -1;
+		}
+	}
+	std::cout << std::endl;
+	if(req.get_responceCode() != 200){
+		std::cout << "http code error " << req.get_responceCode() << std::endl;
+		return -1;
+	}
+	if(first){
+		std::cout << "no streaming event. content type: " << req.get_ContentType() << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
 // chatgpt の choice配列の再現のためのクラス構造
 class chatgpt_choice
 {
@@ -340,12 +423,19 @@ int main(int argc, char *argv[])
 	int ret;
 	string message;
 #if 1
+	// --stream を付けるとストリーミングで問い合わせる
+	bool stream = false;
+	if (argc > 1 && string(argv[1]) == "--stream") {
+		stream = true;
+		argc--;
+		argv++;
+	}
 	if (argc <= 1) {
 		message = "hello!!";
 	}else{
 		message	= argv[1];
 	}
-	ret = chat(message);
+	ret = stream ? chat_stream(message) : chat(message);
 #else
 	ret = jsontest();		// TEST
 #endif
@@ -0,0 +1,131 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_chunk_stream.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_bytestream;
+using libcurlcxx::curl_base_chunk_stream;
+using libcurlcxx::curl_base_stream_object;
+using libcurlcxx::curl_base_exception;
+
+using libcurlcxx::curl_http_request;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// libcurlが1回のコールバックで渡してくる最大サイズ
+static constexpr size_t write_size = CURL_MAX_WRITE_SIZE;
+
+// libcurlの代わりにwrite関数をtotalバイト分呼び出して、ストリームに書き込む時間だけを計る
+// 通信を挟まないので、純粋にストリームの書き込み速度の比較になる
+static double feed(curl_base_stream_object &stream, const std::vector<char> &src, size_t total)
+{
+	auto func = stream.get_write_function();
+	const auto start = std::chrono::steady_clock::now();
+	for(size_t pos = 0; pos < total; pos += write_size){
+		size_t n = std::min(write_size, total - pos);
+		func(const_cast<char *>(src.data()), 1, n, &stream);
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void print_result(std::string_view name, size_t total, int rounds, double sec)
+{
+	std::cout << name << ": " << (static_cast<double>(total) * rounds / (1024.0 * 1024.0)) / sec << " MB/s"
+			  << " (" << sec << " sec)" << std::endl;
+}
+
+// curl_base_bytestreamとcurl_base_chunk_streamで受信データの書き込みスループットを比べるベンチマーク
+// 第1引数: 1回の受信サイズ(MB)  第2引数: 繰り返し回数
+// 第3引数にURLを指定すると、実際にそのURLをダウンロードして時間を比べる
+// 例: ./chunk_stream_bench 1024 4
+//     ./chunk_stream_bench 50 2 http://127.0.0.1:8080/big.bin
+int main(int argc, char *argv[])
+{
+	size_t mbytes = 512;
+	int rounds = 4;
+	std::string url;
+	if(argc > 1) mbytes = std::stoul(argv[1]);
+	if(argc > 2) rounds = std::stoi(argv[2]);
+	if(argc > 3) url = argv[3];
+	const size_t total = mbytes * 1024 * 1024;
+
+	if(url.empty()){
+		std::cout << "size: " << mbytes << " MB rounds: " << rounds << std::endl;
+		std::vector<char> src(write_size, 'x');
+
+		double sec = 0;
+		for(int i = 0; i < rounds; i++){
+			curl_base_bytestream stream;
+			sec += feed(stream, src, total);
+		}
+		print_result("curl_base_bytestream", total, rounds, sec);
+
+		sec = 0;
+		double flat_sec = 0;
+		for(int i = 0; i < rounds; i++){
+			curl_base_chunk_stream stream;
+			sec += feed(stream, src, total);
+			// 連続したメモリが必要になった場合の1回だけのまとめ
+			const auto start = std::chrono::steady_clock::now();
+			stream.flatten();
+			flat_sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		print_result("curl_base_chunk_stream", total, rounds, sec);
+		print_result("curl_base_chunk_stream + flatten", total, rounds, sec + flat_sec);
+		return 0;
+	}
+
+	std::cout << "url: " << url << " rounds: " << rounds << std::endl;
+	try{
+		auto run = [&](std::string_view name, auto make_stream) {
+			double sec = 0;
+			size_t bytes = 0;
+			for(int i = 0; i < rounds; i++){
+				auto stream = make_stream();
+				curl_http_request req(stream);
+				req.RequestSetupGet(url);
+				const auto start = std::chrono::steady_clock::now();
+				req.perform();
+				sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				bytes += req.get_ContentLength();
+			}
+			print_result(name, bytes / rounds, rounds, sec);
+		};
+		run("curl_base_bytestream", []() { return std::make_shared<curl_base_bytestream>(); });
+		run("curl_base_chunk_stream", []() { return std::make_shared<curl_base_chunk_stream>(); });
+	}catch (curl_base_exception &error){
+		// エラー内容表示
+		std::cerr << error.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_easy_pool.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_bytestream;
+using libcurlcxx::curl_base_easy_pool;
+using libcurlcxx::curl_base_exception;
+
+using libcurlcxx::curl_http_request;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// latencyの配列からパーセンタイル値を返す
+static double percentile(std::vector<double> &lat, double p)
+{
+	if(lat.empty()) return 0;
+	size_t n = static_cast<size_t>(p * (lat.size() - 1));
+	std::nth_element(lat.begin(), lat.begin() + n, lat.end());
+	return lat[n];
+}
+
+// total回、リクエストの作成・GET・破棄を逐次実行して1回ごとの時間を計測する
+// make_req: curl_http_requestを作る関数
+template<class MAKE>
+static void run_bench(std::string_view name, MAKE make_req, std::string_view url, int total)
+{
+	std::vector<double> lat;
+	lat.reserve(total);
+	int failed = 0;
+
+	for(int i = 0; i < total; i++){
+		const auto start = std::chrono::steady_clock::now();
+		{
+			auto req = make_req();
+			req.RequestSetupGet(url);
+			try{
+				req.perform();
+				if(req.get_responceCode() != 200) failed++;
+			}catch (curl_base_exception &error){
+				failed++;
+			}
+		}
+		lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+	double p50 = percentile(lat, 0.50);
+	double p99 = percentile(lat, 0.99);
+	std::cout << name << ": requests " << total << " failed " << failed
+			  << " p50 " << p50 << " usec"
+			  << " p99 " << p99 << " usec" << std::endl;
+}
+
+// リクエストごとにcurl_easy_initするcurl_http_requestと、curl_base_easy_poolからハンドルを借りるものとで
+// 逐次GETのレイテンシ(p50/p99)を比べるベンチマーク
+// プール側はハンドルが持っている接続キャッシュやTLSセッションが再利用される
+// 例: ./easy_pool_bench https://example.com/ 10000
+int main(int argc, char *argv[])
+{
+	std::string url = "http://127.0.0.1:8080/";
+	int total = 10000;
+	if(argc > 1) url = argv[1];
+	if(argc > 2) total = std::stoi(argv[2]);
+
+	std::cout << "url: " << url << " requests: " << total << std::endl;
+
+	try{
+		run_bench("curl_easy_init per request", [&]() {
+			return curl_http_request(std::make_shared<curl_base_bytestream>());
+		}, url, total);
+
+		auto pool = std::make_shared<curl_base_easy_pool>(1);
+		run_bench("curl_base_easy_pool", [&]() {
+			return curl_http_request(std::make_shared<curl_base_bytestream>(), pool);
+		}, url, total);
+		std::cout << "pool: created " << pool->get_created_count() << " reused " << pool->get_reused_count() << std::endl;
+	}catch (curl_base_exception &error){
+		// エラー内容表示
+		std::cerr << error.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
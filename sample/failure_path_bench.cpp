@@ -0,0 +1,106 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_bytestream;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_easy_result;
+
+using libcurlcxx::curl_http_request;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// threads個のスレッドでそれぞれcount回、必ず失敗するリクエストを実行して1回あたりの時間を返す
+// use_try: trueならtry_perform、falseならperformを呼んで例外をcatchする
+static double run_bench(std::string_view url, int threads, int count, bool use_try, size_t &failed)
+{
+	std::vector<std::thread> th;
+	std::vector<size_t> fails(threads, 0);
+	const auto start = std::chrono::steady_clock::now();
+	for(int t = 0; t < threads; t++){
+		th.emplace_back([&, t]() {
+			curl_http_request req(std::make_shared<curl_base_bytestream>());
+			req.set_connect_timeout(1);
+			for(int i = 0; i < count; i++){
+				req.RequestSetupGet(url);
+				if(use_try){
+					if(!req.try_perform()) fails[t]++;
+				}else{
+					try{
+						req.perform();
+					}catch(curl_base_exception &e){
+						fails[t]++;
+					}
+				}
+			}
+		});
+	}
+	for(auto &x : th) x.join();
+	const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	failed = 0;
+	for(size_t f : fails) failed += f;
+	return sec;
+}
+
+// 転送が失敗したときのコストを、例外を投げるperformと例外を投げないtry_performとで比べるベンチマーク
+// デフォルトではlibcurlが知らないスキームのURLを使うので、通信をせずにすぐ失敗する。失敗の処理だけの時間になる
+// 接続拒否などを試したい場合は"http://127.0.0.1:1/"のようなURLを指定する
+// 第1引数: スレッド数  第2引数: スレッドごとの回数  第3引数: URL
+// 例: ./failure_path_bench 8 100000
+int main(int argc, char *argv[])
+{
+	int threads = 4;
+	int count = 100000;
+	std::string url = "nosuchscheme://example.com/";
+	if(argc > 1) threads = std::stoi(argv[1]);
+	if(argc > 2) count = std::stoi(argv[2]);
+	if(argc > 3) url = argv[3];
+
+	// 失敗の理由を1回だけ表示する
+	{
+		curl_http_request req(std::make_shared<curl_base_bytestream>());
+		req.RequestSetupGet(url);
+		const curl_easy_result r = req.try_perform();
+		std::cout << "url: " << url << " threads: " << threads << " count: " << count << std::endl;
+		std::cout << "result: " << r.error() << " " << r.message() << std::endl;
+	}
+
+	const double total = static_cast<double>(threads) * count;
+	size_t failed = 0;
+	double sec = run_bench(url, threads, count, false, failed);
+	std::cout << "perform + catch: " << (sec * 1e9 / total) << " ns/op (" << sec << " sec, failed " << failed << ")" << std::endl;
+	sec = run_bench(url, threads, count, true, failed);
+	std::cout << "try_perform    : " << (sec * 1e9 / total) << " ns/op (" << sec << " sec, failed " << failed << ")" << std::endl;
+	return 0;
+}
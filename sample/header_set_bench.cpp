@@ -0,0 +1,191 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include "curlcxx_easy_pool.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+#include "curlcxx_slist.h"
+
+using libcurlcxx::curl_base_easy_pool;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_base_header_set;
+using libcurlcxx::curl_base_static_headers;
+using libcurlcxx::curl_base_stringstream;
+
+using libcurlcxx::curl_http_request;
+
+// このベンチマークはlibcurlのmallocを数えるためにcurl_global_init_memを使うので、curl_base_cdtorは定義しない
+// (curl_global_init_memは他のどのcurl関数よりも先に呼ぶ必要がある)
+
+// 確保の回数。C++のnewとlibcurlの中のmalloc系の両方を数える
+static std::atomic<size_t> _alloc_count(0);
+
+// newとdeleteの中身はインライン展開させない関数に分けておく
+// 展開されるとコンパイラからnewで取ったものをfreeしているように見えて、-Wmismatched-new-deleteの警告が出る
+[[gnu::noinline]] static void *_counted_new(size_t size)
+{
+	_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	if(void *p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+[[gnu::noinline]] static void _counted_delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void *operator new(size_t size)							{ return _counted_new(size);}
+void operator delete(void *p) noexcept					{ _counted_delete(p);}
+void operator delete(void *p, size_t) noexcept			{ _counted_delete(p);}
+
+static void *count_malloc(size_t size)
+{
+	_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size);
+}
+static void *count_realloc(void *ptr, size_t size)
+{
+	_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	return std::realloc(ptr, size);
+}
+static char *count_strdup(const char *str)
+{
+	_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	return strdup(str);
+}
+static void *count_calloc(size_t nmemb, size_t size)
+{
+	_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	return std::calloc(nmemb, size);
+}
+
+// どのリクエストにも付ける共通のヘッダ。ノードごと静的領域に置かれる
+static constinit curl_base_static_headers api_headers(
+	"User-Agent: libcurlcxx-bench/1.0",
+	"Accept: application/json",
+	"Accept-Language: ja,en;q=0.8",
+	"Content-Type: application/json",
+	"Cache-Control: no-cache",
+	"X-Client-Version: 1.2.3",
+	"X-Request-Source: bench"
+);
+
+// total回、プールから借りたハンドルでリクエストを作ってヘッダを設定し、prePerform(とURLがあればperform)する
+// 1リクエストあたりの確保回数と時間を表示する
+template<class SETUP>
+static void run_bench(std::string_view name, SETUP setup, const std::shared_ptr<curl_base_easy_pool> &pool, std::string_view url, int total)
+{
+	const std::string_view target = url.empty() ? std::string_view("http://127.0.0.1/") : url;
+	int failed = 0;
+	const size_t before = _alloc_count.load();
+	const auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < total; i++){
+		curl_http_request req(pool);
+		setup(req, i);
+		req.RequestSetupGet(target);
+		if(url.empty()){
+			req.prePerform();
+			continue;
+		}
+		req.set_streamer(std::make_shared<curl_base_stringstream>());
+		try{
+			req.perform();
+			if(req.get_responceCode() != 200) failed++;
+		}catch (curl_base_exception &error){
+			failed++;
+		}
+	}
+	const double usec = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	const size_t allocs = _alloc_count.load() - before;
+	std::cout << name << ": allocations/request " << static_cast<double>(allocs) / total
+			  << " time/request " << usec / total << " usec";
+	if(!url.empty()) std::cout << " failed " << failed;
+	std::cout << std::endl;
+}
+
+// 8個のヘッダを付けたリクエストを作るときの確保回数を、appendHeaderで毎回作る場合と共有のヘッダセットを使う場合とで比べるベンチマーク
+// URLを指定しない場合はperformせずに、ヘッダの設定とprePerformまでを計る
+// 第1引数: リクエスト数  第2引数: URL(省略可)
+// 例: ./header_set_bench 100000
+//     ./header_set_bench 2000 http://127.0.0.1:8080/
+int main(int argc, char *argv[])
+{
+	int total = 100000;
+	std::string url;
+	if(argc > 1) total = std::stoi(argv[1]);
+	if(argc > 2) url = argv[2];
+
+	if(curl_global_init_mem(CURL_GLOBAL_ALL, count_malloc, std::free, count_realloc, count_strdup, count_calloc) != CURLE_OK){
+		std::cerr << "curl_global_init_mem failed" << std::endl;
+		return -1;
+	}
+	{
+		auto pool = std::make_shared<curl_base_easy_pool>();
+		// 実行時に作る共有のヘッダセット(静的なリストと同じ内容)
+		const auto runtime_set = curl_base_header_set::create({
+			"User-Agent: libcurlcxx-bench/1.0",
+			"Accept: application/json",
+			"Accept-Language: ja,en;q=0.8",
+			"Content-Type: application/json",
+			"Cache-Control: no-cache",
+			"X-Client-Version: 1.2.3",
+			"X-Request-Source: bench",
+		});
+		const auto static_set = std::make_shared<const curl_base_header_set>(api_headers);
+		const std::string token = "Authorization: Bearer 0123456789abcdef";
+
+		// ハンドルを先にプールに作っておく
+		run_bench("warmup", [](curl_http_request &, int) {}, pool, url, 10);
+
+		run_bench("appendHeader x8", [&](curl_http_request &req, int) {
+			req.appendHeader("User-Agent: libcurlcxx-bench/1.0");
+			req.appendHeader("Accept: application/json");
+			req.appendHeader("Accept-Language: ja,en;q=0.8");
+			req.appendHeader("Content-Type: application/json");
+			req.appendHeader("Cache-Control: no-cache");
+			req.appendHeader("X-Client-Version: 1.2.3");
+			req.appendHeader("X-Request-Source: bench");
+			req.appendHeader(token);
+		}, pool, url, total);
+		run_bench("runtime header set + appendHeader x1", [&](curl_http_request &req, int) {
+			req.setHeaderSet(runtime_set);
+			req.appendHeader(token);
+		}, pool, url, total);
+		run_bench("static header set + appendHeader x1", [&](curl_http_request &req, int) {
+			req.setHeaderSet(static_set);
+			req.appendHeader(token);
+		}, pool, url, total);
+		run_bench("static header set only", [&](curl_http_request &req, int) {
+			req.setHeaderSet(static_set);
+		}, pool, url, total);
+	}
+	curl_global_cleanup();
+	return 0;
+}
@@ -0,0 +1,97 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <future>
+#include <mutex>
+#include <thread>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_utility.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+#include "curlcxx_async_client.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_stringstream;
+using libcurlcxx::curl_base_exception;
+
+using libcurlcxx::curl_http_request;
+using libcurlcxx::curl_async_client;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// curl_async_clientのサンプル
+// 複数のワーカスレッドが1つのクライアント(1つのI/Oスレッドと接続キャッシュ)を共有してリクエストを投げる
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> urls;
+	for(int i = 1; i < argc; i++) urls.push_back(argv[i]);
+	if(urls.empty()){
+		urls.push_back("http://abehiroshi.la.coocan.jp/");
+		urls.push_back("https://www.yahoo.com");
+		urls.push_back("https://www.wikipedia.org");
+	}
+
+	curl_async_client client;
+	std::mutex out_lk;
+
+	// URLごとにワーカスレッドを立てて、それぞれがfutureで結果を待つ
+	std::vector<std::thread> workers;
+	for(const auto &url : urls){
+		workers.emplace_back([&client, &out_lk, url]() {
+			auto req = std::make_shared<curl_http_request>(std::make_shared<curl_base_stringstream>());
+			req->RequestSetupGet(url);
+			try{
+				std::future<CURLcode> result = client.async_perform(req);
+				// 他の処理をしてから待ってもよい
+				const CURLcode code = result.get();
+
+				std::scoped_lock lk{out_lk};
+				if(code != CURLE_OK){
+					std::cout << "CURL error code:" << code << " " << url << std::endl;
+					return;
+				}
+				std::cout << req->get_responceCode() << " " << url << " length: " << req->get_ContentString().size() << std::endl;
+			}catch (curl_base_exception &error){
+				std::scoped_lock lk{out_lk};
+				std::cerr << error.what() << std::endl;
+			}
+		});
+	}
+	for(auto &th : workers){
+		th.join();
+	}
+
+	// コールバックで受け取る場合はこのようにする
+	std::promise<void> done;
+	auto req = std::make_shared<curl_http_request>(std::make_shared<curl_base_stringstream>());
+	req->RequestSetupGet(urls.front());
+	client.async_perform(req, [&done](const std::shared_ptr<curl_http_request> &r, CURLcode code) {
+		std::cout << "callback: code " << code << " " << r->get_url() << std::endl;
+		done.set_value();
+	});
+	done.get_future().wait();
+
+	std::cerr << "end of program" << std::endl;
+	return 0;
+}
@@ -0,0 +1,88 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "curlcxx_cdtor.h"
+#include "curlcxx_utility.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+#include "curlcxx_coro.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_stringstream;
+using libcurlcxx::curl_base_exception;
+
+using libcurlcxx::curl_http_request;
+using libcurlcxx::curl_coro_loop;
+using libcurlcxx::curl_task;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// 1つのURLを取得するコルーチン
+// co_awaitのところで中断し、転送が終わるとloop.run_tasks()の中で再開される
+static curl_task fetch(curl_coro_loop &loop, std::string url)
+{
+	curl_http_request req(std::make_shared<curl_base_stringstream>());
+	req.RequestSetupGet(url);
+
+	const CURLcode code = co_await req.async_perform(loop);
+	if(code != CURLE_OK){
+		std::cout << "CURL error code:" << code << " " << url << std::endl;
+		co_return;
+	}
+	std::cout << req.get_responceCode() << " " << url << " length: " << req.get_ContentString().size() << std::endl;
+
+	// 続けて同じように書ける
+	req.RequestSetupGet(url);
+	if(co_await req.async_perform(loop) == CURLE_OK){
+		std::cout << "second request " << req.get_responceCode() << " " << url << std::endl;
+	}
+}
+
+// コルーチンを使ったmultiリクエストサンプル
+// http_multi_sampleと同じことを、メッセージを取ってくるループを書かずに行う
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> urls;
+	for(int i = 1; i < argc; i++) urls.push_back(argv[i]);
+	if(urls.empty()){
+		urls.push_back("http://abehiroshi.la.coocan.jp/");
+		urls.push_back("https://www.yahoo.com");
+		urls.push_back("https://www.wikipedia.org");
+	}
+
+	try{
+		curl_coro_loop loop;
+		for(const auto &url : urls){
+			fetch(loop, url);		// 最初のco_awaitまで進んで戻ってくる
+		}
+		// すべてのコルーチンが終わるまで回す
+		loop.run_tasks();
+	}catch (curl_base_exception &error){
+		// エラー内容表示
+		std::cerr << error.what() << std::endl;
+		return -1;
+	}
+	std::cerr << "end of program" << std::endl;
+	return 0;
+}
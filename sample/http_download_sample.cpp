@@ -25,6 +25,7 @@
 #include <memory>
 #include "curlcxx_cdtor.h"
 #include "curlcxx_http_req.h"
+#include "curlcxx_file_stream.h"
 #include "curlcxx_utility.h"
 #include "curlcxx_error.h"
 
@@ -32,6 +33,7 @@ using libcurlcxx::curl_base_cdtor;
 using libcurlcxx::curl_base_easy;
 using libcurlcxx::curl_base_stringstream;
 using libcurlcxx::curl_base_bytestream;
+using libcurlcxx::curl_base_mmap_filestream;
 using libcurlcxx::curl_base_utility;
 using libcurlcxx::curl_base_exception;
 
@@ -64,18 +66,27 @@ static int download_progress_callback(curl_base_easy *easy, void *pdata, curl_of
 }
 
 // 単にダウンロードとプログレス表示をするサンプル
+// 受信したデータはメモリに貯めずにcurl_base_mmap_filestreamで直接ファイルに書き込む
 int main()
 {
-	curl_http_request req(std::make_shared<curl_base_bytestream>());		// 対象がバイナリの可能性がある場合は、bytestreamを使います
-	req.appendHeader("User-Agent: curl/7.81.0");		// UAを指定
-	req.appendHeader("Accept-Language: *");
-	req.RequestSetupGet(download_url_object);
-	req.set_progress_function(true, download_progress_callback);			// ダウンロード中にユーザ定義のコールバック関数で進捗表示させる場合はこのようにする
 	// URLからファイル名を抽出
-	std::string save_fname = curl_base_utility::url_from_filename(req.get_url());
+	std::string save_fname = curl_base_utility::url_from_filename(download_url_object);
 	if(save_fname.empty()){
 		save_fname = "data.dat";		// わからんのでこうなります
 	}
+	std::shared_ptr<curl_base_mmap_filestream> fstream;
+	try {
+		fstream = std::make_shared<curl_base_mmap_filestream>(save_fname);
+	} catch (curl_base_exception &derror) {
+		std::cerr << derror.what() << std::endl;
+		return -1;
+	}
+
+	curl_http_request req(fstream);
+	req.appendHeader("User-Agent: curl/7.81.0");		// UAを指定
+	req.appendHeader("Accept-Language: *");
+	req.RequestSetupGet(download_url_object);
+	req.set_progress_function(true, download_progress_callback);			// ダウンロード中にユーザ定義のコールバック関数で進捗表示させる場合はこのようにする
 
 	// 詳細なデバッグをしたい場合は以下のコメントを外す
 //  req.set_debugdump(false);
@@ -101,27 +112,15 @@ int main()
 	std::cout << "  content type: " << req.get_ContentType() << std::endl;
 	std::cout << "  length: " << req.get_ContentLength() << std::endl;
 
-	std::vector<uint8_t> *datvec;
-	datvec = (static_cast<curl_base_bytestream* >(req.get_streamer()))->get_stream();
-	// からじゃないときは処理する
-	if(datvec->empty()){
-		std::cout << "content is empty... " << std::endl;
-		return 0;
-	}
-
-	std::cout << "saveing.... " << save_fname << std::endl;
-	std::ofstream file(save_fname, std::ios::out|std::ios::binary|std::ios::trunc);
-	// ファイルが正常に開かれたか確認
-	if (!file.is_open()) {
-		std::cerr << "error :can not open " << save_fname << std::endl;
-		return -1;
-	}
-	file.write(reinterpret_cast<const char* >(datvec->data()), datvec->size());
-	file.flush();				// flushしてからじゃないと正確なことはわからない(buffering)
-	if (file.fail()) {
+	// 実際に受信したサイズに切り詰めて閉じる
+	if(!fstream->close()){
 		std::cout << "error: file save missing !! " << save_fname << std::endl;
 		return -1;
 	}
+	if(fstream->size() == 0){
+		std::cout << "content is empty... " << std::endl;
+		return 0;
+	}
 	std::cout << "file saved " << save_fname << std::endl;
 	return 0;
 }
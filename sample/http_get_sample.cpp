@@ -34,7 +34,7 @@ using libcurlcxx::curl_base_utility;
 using libcurlcxx::curl_base_exception;
 
 using libcurlcxx::curl_http_request;
-using libcurlcxx::curl_http_request_param;
+using libcurlcxx::curl_http_param_list;
 
 using std::string;
 using std::ostream;
@@ -48,10 +48,10 @@ static libcurlcxx::curl_base_cdtor _libcurl;
 int main()
 {
 	std::string_view url("https://httpbin.org/get");
-	curl_http_request_param para;
+	curl_http_param_list para;
 	// Getリクエストで投げるパラメータを準備。登録順で設定される
-	para["param1"] = "ABC";
-	para["param2"] = "D  EF";
+	para.add("param1", "ABC");
+	para.add("param2", "D  EF");
 
 	curl_http_request req(std::make_shared<curl_base_stringstream>());
 	req.appendHeader("User-Agent: testman/0.1");
@@ -78,6 +78,9 @@ int main()
 	}
 	std::cout << "content type: " << req.get_ContentType() << std::endl;
 	std::cout << "length: " << req.get_ContentLength() << std::endl;
+	// レスポンスヘッダは名前(大文字小文字は区別しない)で引ける
+	std::cout << "date: " << req.get_HeaderValue("date") << std::endl;
+	std::cout << "server: " << req.get_HeaderValue("Server") << std::endl;
 	std::cout << req.get_ContentString() << std::endl;
 
 	return 0;
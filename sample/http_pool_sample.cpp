@@ -0,0 +1,82 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <mutex>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_utility.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+#include "curlcxx_multi_pool.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_stringstream;
+using libcurlcxx::curl_base_exception;
+
+using libcurlcxx::curl_http_request;
+using libcurlcxx::curl_multi_pool;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// curl_multi_poolのサンプル
+// 複数のスレッドでmultiのループを回し、リクエストを振り分けて実行する
+// 引数にURLを指定するとそれを取得する
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> urls;
+	for(int i = 1; i < argc; i++) urls.push_back(argv[i]);
+	if(urls.empty()){
+		urls.push_back("http://abehiroshi.la.coocan.jp/");
+		urls.push_back("https://www.yahoo.com");
+		urls.push_back("https://www.wikipedia.org");
+	}
+
+	std::mutex out_lk;		// コールバックは複数のスレッドから呼ばれるので表示が混ざらないようにする
+	try{
+		// ループの数を省略するとCPUのコア数になる
+		curl_multi_pool pool;
+		std::cout << "loops: " << pool.get_loop_count() << std::endl;
+
+		for(const auto &url : urls){
+			auto req = std::make_shared<curl_http_request>(std::make_shared<curl_base_stringstream>());
+			req->RequestSetupGet(url);
+			// 完了したらループのスレッドから呼ばれる
+			pool.submit(req, [&out_lk](const std::shared_ptr<curl_http_request> &r, CURLcode code) {
+				std::scoped_lock lk{out_lk};
+				if(code != CURLE_OK){
+					std::cout << "CURL error code:" << code << " " << r->get_url() << std::endl;
+					return;
+				}
+				std::cout << r->get_responceCode() << " " << r->get_url() << " length: " << r->get_ContentString().size() << std::endl;
+			});
+		}
+		// 全部終わるまで待つ
+		pool.wait();
+	}catch (curl_base_exception &error){
+		// エラー内容表示
+		std::cerr << error.what() << std::endl;
+		return -1;
+	}
+	std::cerr << "end of program" << std::endl;
+	return 0;
+}
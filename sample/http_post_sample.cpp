@@ -36,7 +36,7 @@ using libcurlcxx::curl_base_exception;
 using libcurlcxx::curl_base_mime;
 
 using libcurlcxx::curl_http_request;
-using libcurlcxx::curl_http_request_param;
+using libcurlcxx::curl_http_param_list;
 
 using std::string;
 using std::ostream;
@@ -61,13 +61,14 @@ int main()
 		auto mime = std::make_shared<curl_base_mime>(req);
 		mime->add_part("name", "aaa");
 		mime->add_part("pass", "psps");
+		// ファイルはメモリに読み込まず、送信しながら少しずつ読まれる
+		mime->add_file_part("file", "/etc/hostname").set_type("text/plain");
 		req.RequestSetupPost(url, mime);
 #else
 		// POSTとして投げるデータを設定。
-		// 文字列だけならcurl_http_request_paramを使ったほうが楽
-		curl_http_request_param para;
-		para["name"] = "aaa";
-		para["pass"] = "psps";
+		// 文字列だけならcurl_http_param_listを使ったほうが楽
+		// multipartではなくapplication/x-www-form-urlencodedで送られるので、送るバイト数も少ない
+		curl_http_param_list para{{"name", "aaa"}, {"pass", "psps"}};
 		req.RequestSetupPost(url, para);
 #endif
 	} catch (curl_base_exception &error) {
@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_resumable_download.h"
+#include "curlcxx_utility.h"
+#include "curlcxx_error.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_utility;
+using libcurlcxx::curl_base_exception;
+
+using libcurlcxx::curl_resumable_download;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// get linux-kernel-source (135M)
+static constexpr std::string_view download_url_object("https://cdn.kernel.org/pub/linux/kernel/v6.x/linux-6.7.4.tar.xz");
+
+// 途中で止めても続きからダウンロードできるサンプル
+// Ctrl+Cなどで止めてからもう一度実行すると、チェックポイントファイル(保存先.ckpt)を読んで続きから取ります
+// 第1引数: URL
+// 例: ./http_resumable_download_sample https://cdn.kernel.org/pub/linux/kernel/v6.x/linux-6.7.4.tar.xz
+int main(int argc, char *argv[])
+{
+	std::string url(download_url_object);
+	if(argc > 1) url = argv[1];
+
+	// URLからファイル名を抽出
+	std::string save_fname = curl_base_utility::url_from_filename(url);
+	if(save_fname.empty()){
+		save_fname = "data.dat";		// わからんのでこうなります
+	}
+	std::cout << "url: " << url << std::endl;
+	std::cout << "save_filename: " << save_fname << std::endl;
+
+	curl_resumable_download dl;
+	dl.appendHeader("User-Agent: curl/7.81.0");		// UAを指定
+	dl.set_verify_hash(true);						// 続きから取る前に途中までのファイルを検証する
+	dl.set_checkpoint_interval(4 * 1024 * 1024, std::chrono::milliseconds(1000));
+	dl.set_progress_callback([](size_t downloaded, size_t total) {
+		std::cout << "\r\e[1m\e[7m --- downloading: " << downloaded << " / " << total << " ---\e[0m" << std::flush;
+	});
+
+	try {
+		dl.download(url, save_fname);
+	} catch (curl_base_exception &derror) {
+		// エラー内容表示
+		std::cout << std::endl << derror.what() << std::endl;
+		return -1;
+	}
+
+	std::cout << "\ndownload done!" << std::endl;
+	std::cout << "  length: " << dl.get_size() << std::endl;
+	std::cout << "  resumed from: " << dl.get_resumed_from() << std::endl;
+	std::cout << "file saved " << save_fname << std::endl;
+	return 0;
+}
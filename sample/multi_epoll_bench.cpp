@@ -0,0 +1,141 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <sys/resource.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_multi.h"
+#include "curlcxx_multi_epoll.h"
+#include "curlcxx_error.h"
+#include "curlcxx_http_req.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_bytestream;
+using libcurlcxx::curl_base_multi;
+using libcurlcxx::curl_base_multi_epoll;
+using libcurlcxx::curl_base_multi_message;
+using libcurlcxx::curl_base_exception;
+
+using libcurlcxx::curl_http_request;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// 計測結果
+struct bench_result
+{
+	int		done = 0;			// 完了したリクエスト数
+	int		failed = 0;			// 失敗したリクエスト数
+	double	wall_sec = 0;		// 経過時間
+	double	cpu_sec = 0;		// 消費したCPU時間(user + sys)
+};
+
+// このプロセスが消費したCPU時間を秒で返す
+static double cpu_seconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// total個のリクエストを常にconcurrency個同時に実行し続けて計測する
+// step: 転送処理を進める関数。perform()かrun_once()を呼ぶ
+template<class MULTI, class STEP>
+static bench_result run_bench(MULTI &multi, STEP step, std::string_view url, int total, int concurrency)
+{
+	bench_result res;
+	int started = 0;
+
+	auto start_one = [&]() {
+		auto req = std::make_shared<curl_http_request>(std::make_shared<curl_base_bytestream>());
+		req->RequestSetupGet(url);
+		req->prePerform();
+		multi.add(req);
+		started++;
+	};
+
+	const auto wall_start = std::chrono::steady_clock::now();
+	const double cpu_start = cpu_seconds();
+
+	while(started < total && started < concurrency) start_one();
+	while(res.done < total){
+		step();
+		int msgs_left = 0;
+		curl_base_multi_message mes;
+		while(multi.get_next_message(mes, msgs_left)){
+			if(mes.get_code() != CURLE_OK) res.failed++;
+			multi.remove(mes);
+			res.done++;
+			if(started < total) start_one();
+		}
+	}
+
+	res.cpu_sec = cpu_seconds() - cpu_start;
+	res.wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+	return res;
+}
+
+static void print_result(std::string_view name, const bench_result &res)
+{
+	std::cout << name << ": requests " << res.done << " failed " << res.failed
+			  << " wall " << res.wall_sec << " sec"
+			  << " cpu " << res.cpu_sec << " sec"
+			  << " cpu/request " << (res.cpu_sec * 1e6 / res.done) << " usec" << std::endl;
+}
+
+// curl_base_multi::perform()のビジーループとcurl_base_multi_epollのrun_once()でリクエストあたりのCPU時間を比べるベンチマーク
+// ローカルにHTTPサーバを立ててから実行すると良い
+// 例: python3 -m http.server 8080 & ./multi_epoll_bench http://127.0.0.1:8080/ 2000 200
+int main(int argc, char *argv[])
+{
+	std::string url = "http://127.0.0.1:8080/";
+	int total = 1000;
+	int concurrency = 100;
+	if(argc > 1) url = argv[1];
+	if(argc > 2) total = std::stoi(argv[2]);
+	if(argc > 3) concurrency = std::stoi(argv[3]);
+
+	std::cout << "url: " << url << " requests: " << total << " concurrency: " << concurrency << std::endl;
+
+	try{
+		{
+			curl_base_multi multi;
+			// サンプルと同じく、performを休まず呼び続ける
+			auto res = run_bench(multi, [&]() { multi.perform(); }, url, total, concurrency);
+			print_result("perform loop", res);
+		}
+		{
+			curl_base_multi_epoll multi;
+			// 準備ができたソケットがあるかタイムアウトするまで寝て待つ
+			auto res = run_bench(multi, [&]() { multi.run_once(1000); }, url, total, concurrency);
+			print_result("epoll socket_action", res);
+		}
+	}catch (curl_base_exception &error){
+		// エラー内容表示
+		std::cerr << error.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,145 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_ndjson_stream.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_ndjson_stream;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// libcurlが1回のコールバックで渡してくる最大サイズ
+static constexpr size_t write_size = CURL_MAX_WRITE_SIZE;
+
+// それっぽいNDJSONをtotalバイト分作る。レコードの長さはmin_len〜max_lenでばらつかせる
+static std::string make_ndjson(size_t total, size_t min_len, size_t max_len)
+{
+	std::mt19937 rng(12345);
+	std::uniform_int_distribution<size_t> len_dist(min_len, max_len);
+	std::string src;
+	src.reserve(total + max_len);
+	size_t id = 0;
+	while(src.size() < total){
+		std::string rec = "{\"id\":" + std::to_string(id++) + ",\"text\":\"";
+		const size_t len = len_dist(rng);
+		while(rec.size() + 2 < len) rec.push_back(static_cast<char>('a' + rng() % 26));
+		rec += "\"}\n";
+		src += rec;
+	}
+	return src;
+}
+
+// 比較用。チャンクを文字列に足してからstd::string::findで改行を探し、使った分を消す
+class naive_splitter
+{
+private:
+	std::string		buf;
+public:
+	size_t			count = 0;
+	size_t			bytes = 0;
+
+	void write(const char *p, size_t n)
+	{
+		buf.append(p, n);
+		size_t pos = 0;
+		size_t nl;
+		while((nl = buf.find('\n', pos)) != std::string::npos){
+			count++;
+			bytes += nl - pos;
+			pos = nl + 1;
+		}
+		buf.erase(0, pos);
+	}
+};
+
+static void print_result(std::string_view name, size_t total, int rounds, double sec, size_t count)
+{
+	std::cout << name << ": " << (static_cast<double>(total) * rounds / (1024.0 * 1024.0 * 1024.0)) / sec << " GB/s"
+			  << " (" << sec << " sec, " << count << " records)" << std::endl;
+}
+
+// 改行区切りのJSONをレコードに切り出す速度を、curl_base_ndjson_streamと素朴なstd::string::findのループで比べるベンチマーク
+// libcurlの代わりにwrite関数をCURL_MAX_WRITE_SIZEずつ呼ぶので、通信を挟まない純粋な切り出しの速度になる
+// 第1引数: データのサイズ(MB)  第2引数: 繰り返し回数  第3引数: 1レコードの平均の長さ(バイト)
+// 例: ./ndjson_split_bench 256 8 200
+int main(int argc, char *argv[])
+{
+	size_t mbytes = 256;
+	int rounds = 8;
+	size_t avg_len = 200;
+	if(argc > 1) mbytes = std::stoul(argv[1]);
+	if(argc > 2) rounds = std::stoi(argv[2]);
+	if(argc > 3) avg_len = std::max<size_t>(std::stoul(argv[3]), 32);
+
+	const std::string src = make_ndjson(mbytes * 1024 * 1024, avg_len / 2, avg_len * 3 / 2);
+	std::cout << "size: " << src.size() << " bytes rounds: " << rounds << " avg record: " << avg_len << " bytes" << std::endl;
+	std::cout << "kernel: " << curl_base_ndjson_stream::get_kernel_name() << std::endl;
+
+	// 受信バッファはlibcurlと同じく毎回同じ領域に書かれてくるものとして、コピーしてから渡す
+	std::vector<char> chunk(write_size);
+
+	double sec = 0;
+	size_t count = 0;
+	for(int i = 0; i < rounds; i++){
+		naive_splitter sp;
+		const auto start = std::chrono::steady_clock::now();
+		for(size_t pos = 0; pos < src.size(); pos += write_size){
+			const size_t n = std::min(write_size, src.size() - pos);
+			std::memcpy(chunk.data(), src.data() + pos, n);
+			sp.write(chunk.data(), n);
+		}
+		sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		count = sp.count;
+	}
+	print_result("std::string::find", src.size(), rounds, sec, count);
+
+	sec = 0;
+	for(int i = 0; i < rounds; i++){
+		size_t bytes = 0;
+		curl_base_ndjson_stream stream([&](std::string_view rec) {
+			bytes += rec.size();
+			return true;
+		});
+		auto func = stream.get_write_function();
+		const auto start = std::chrono::steady_clock::now();
+		for(size_t pos = 0; pos < src.size(); pos += write_size){
+			const size_t n = std::min(write_size, src.size() - pos);
+			std::memcpy(chunk.data(), src.data() + pos, n);
+			func(chunk.data(), 1, n, &stream);
+		}
+		stream.flush();
+		sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		count = stream.get_record_count();
+	}
+	print_result("curl_base_ndjson_stream", src.size(), rounds, sec, count);
+	return 0;
+}
@@ -0,0 +1,129 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "curlcxx_cdtor.h"
+#include "curlcxx_error.h"
+#include "curlcxx_url.h"
+#include "curlcxx_utility.h"
+
+using libcurlcxx::curl_base_cdtor;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_base_url;
+using libcurlcxx::curl_base_url_parts;
+using libcurlcxx::curl_base_utility;
+
+// 使用の際はこれの定義が必要
+static libcurlcxx::curl_base_cdtor _libcurl;
+
+// 比較用。以前のcurl_base_utilityと同じく、呼ぶたびにstd::regexを作ってRFC3986 Appendix Bの正規表現で切り出す
+static std::string regex_servername(std::string_view url)
+{
+	constexpr std::string_view url_pattern = "^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\\?([^#]*))?(#(.*))?";
+	std::regex pattern(url_pattern.data());
+	std::smatch matches;
+	std::string fstr(url);
+	if (!std::regex_search(fstr, matches, pattern)) return "";
+	std::string authority = matches[4];
+	size_t colonPos = authority.find(':');
+	if(colonPos != std::string::npos) {
+		return authority.substr(0, colonPos);
+	}
+	return authority;
+}
+
+static void print_result(std::string_view name, size_t n, double sec, size_t check)
+{
+	std::cout << name << ": " << (sec * 1e9 / static_cast<double>(n)) << " ns/url"
+			  << " (" << sec << " sec, check " << check << ")" << std::endl;
+}
+
+// URLからホスト名を取り出す速度を、以前のstd::regexを使う方法と、curl_base_url_partsの1回なめるだけの方法、
+// libcurlのCURLU(curl_base_url)で解析する方法とで比べるベンチマーク
+// checkは取り出したホスト名の長さの合計で、3つとも同じになるはず
+// 第1引数: 繰り返し回数
+// 例: ./url_parse_bench 10000
+int main(int argc, char *argv[])
+{
+	size_t rounds = 10000;
+	if(argc > 1) rounds = std::stoul(argv[1]);
+
+	const std::vector<std::string> urls = {
+		"https://www.example.com/index.html",
+		"http://localhost:8080/api/v1/items?limit=20&offset=40",
+		"https://api.example.org/v2/search?q=libcurl#results",
+		"https://cdn.example.net/images/2023/09/photo_0001.jpg",
+		"http://192.168.0.10:3000/status",
+		"https://mastodon.example.jp/api/v1/timelines/public?local=true&limit=40",
+	};
+	const size_t n = rounds * urls.size();
+
+	try{
+		size_t check = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < rounds; i++){
+			for(const auto &u : urls) check += regex_servername(u).size();
+		}
+		print_result("std::regex", n, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), check);
+
+		check = 0;
+		start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < rounds; i++){
+			for(const auto &u : urls) check += curl_base_utility::url_from_servername(u).size();
+		}
+		print_result("curl_base_utility::url_from_servername", n, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), check);
+
+		check = 0;
+		start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < rounds; i++){
+			for(const auto &u : urls) check += curl_base_url_parts::parse(u).host.size();
+		}
+		print_result("curl_base_url_parts::parse", n, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), check);
+
+		check = 0;
+		curl_base_url cu;
+		start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < rounds; i++){
+			for(const auto &u : urls){
+				cu.set_url(u);
+				check += cu.get_host().size();
+			}
+		}
+		print_result("curl_base_url (CURLU)", n, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), check);
+
+		// ベースのURLを複製してリクエストごとのクエリを足す例
+		curl_base_url base("https://api.example.com/v1/search?lang=ja");
+		curl_base_url req = base.dup();
+		req.append_query("q=hello world");
+		std::cout << "dup + append_query: " << req.get_url() << std::endl;
+	}catch(curl_base_exception &e){
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,197 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <cstring>
+
+#include "curlcxx_chunk_stream.h"
+
+using libcurlcxx::curl_base_block_pool;
+using libcurlcxx::curl_base_chunk_stream;
+using libcurlcxx::writef::_check_callback_arg;
+
+// --------------------------------------------------
+// curl_base_block_pool : 固定サイズのブロックの再利用プール
+
+// コンストラクタ
+// _block_size: ブロック1つのバイト数
+// _max_free: 返却されたブロックを保持しておく最大数。これを超えて返却されたものは解放する
+curl_base_block_pool::curl_base_block_pool(size_t _block_size, size_t _max_free)
+	: block_size(_block_size == 0 ? DEFAULT_BLOCK_SIZE : _block_size), max_free(_max_free)
+{}
+
+// ブロックを1つ借りる。中身は初期化されていない
+std::unique_ptr<uint8_t[]> curl_base_block_pool::acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock(lk);
+		if(!freeblocks.empty()){
+			auto p = std::move(freeblocks.back());
+			freeblocks.pop_back();
+			return p;
+		}
+	}
+	// ゼロ埋めはしない
+	return std::make_unique_for_overwrite<uint8_t[]>(block_size);
+}
+
+// ブロックを返却する
+void curl_base_block_pool::release(std::unique_ptr<uint8_t[]> &&block) noexcept
+{
+	if(!block) return;
+	std::lock_guard<std::mutex> lock(lk);
+	if(freeblocks.size() < max_free){
+		freeblocks.push_back(std::move(block));
+	}else{
+		block.reset();
+	}
+}
+
+// プロセス全体で共有するデフォルトのプール
+// curl_base_chunk_streamをデフォルトコンストラクタで作るとこれを使う
+const std::shared_ptr<curl_base_block_pool> &curl_base_block_pool::get_default()
+{
+	static const std::shared_ptr<curl_base_block_pool> _default = std::make_shared<curl_base_block_pool>();
+	return _default;
+}
+
+// --------------------------------------------------
+// curl_base_chunk_stream : 受信データをブロックのチェーンに貯めるストリーム
+
+// コンストラクタ。デフォルトのプールからブロックを借りる
+curl_base_chunk_stream::curl_base_chunk_stream()
+	: curl_base_chunk_stream(curl_base_block_pool::get_default())
+{}
+
+// コンストラクタ
+// _pool: ブロックを借りるプール。ブロックサイズを変えたい場合などに指定する
+curl_base_chunk_stream::curl_base_chunk_stream(const std::shared_ptr<curl_base_block_pool> &_pool)
+	: pool(_pool), tail_used(0), flat_size(0), total_size(0)
+{
+	set_write_callback(_callback_func);
+}
+
+// デストラクタ。ブロックはプールに返す
+curl_base_chunk_stream::~curl_base_chunk_stream()
+{
+	release_blocks();
+}
+
+// 何かサーバからデータが来るとこれがCurlから呼ばれる
+size_t curl_base_chunk_stream::_callback_func(char *buffer, size_t size, size_t nitems, void *outstream)
+{
+	auto realsize = _check_callback_arg(buffer, size, nitems);
+	if(realsize == 0) return 0;
+	return static_cast<curl_base_chunk_stream*>(outstream)->internal_write(buffer, realsize);
+}
+
+// 最後のブロックの空きに詰め、足りなければ新しいブロックをつなげる
+// 既に書いたデータを動かすことはない
+size_t curl_base_chunk_stream::internal_write(char *buffer, size_t realsize)
+{
+	const size_t bsize = pool->get_block_size();
+	size_t left = realsize;
+	while(left != 0){
+		if(blocks.empty() || tail_used == bsize){
+			blocks.push_back(pool->acquire());
+			tail_used = 0;
+		}
+		const size_t n = std::min(left, bsize - tail_used);
+		std::memcpy(blocks.back().get() + tail_used, buffer, n);
+		tail_used += n;
+		buffer += n;
+		left -= n;
+	}
+	total_size += realsize;
+	return realsize;
+}
+
+// ブロックをすべてプールに返す
+void curl_base_chunk_stream::release_blocks() noexcept
+{
+	for(auto &b : blocks) pool->release(std::move(b));
+	blocks.clear();
+	tail_used = 0;
+}
+
+// 受信したデータを先頭から順にspanの配列で返す
+// spanはこのストリームがclear・flatten・破棄されるまで有効
+std::vector<std::span<const uint8_t>> curl_base_chunk_stream::get_spans() const
+{
+	std::vector<std::span<const uint8_t>> spans;
+	spans.reserve(blocks.size() + 1);
+	for_each_span([&spans](std::span<const uint8_t> s) { spans.push_back(s); });
+	return spans;
+}
+
+// 受信したデータを1つの連続したバッファにまとめて返す
+// まとめる際のコピーは1回だけで、まとめたあとのブロックはプールに返す
+// 既に1つのバッファに収まっている場合はコピーせずにそのまま返す
+// 返したspanはこのストリームがclear・flatten・破棄されるまで有効
+std::span<const uint8_t> curl_base_chunk_stream::flatten()
+{
+	if(blocks.empty()){
+		return std::span<const uint8_t>(flat.get(), flat_size);
+	}
+	if(flat_size == 0 && blocks.size() == 1){
+		return std::span<const uint8_t>(blocks.front().get(), tail_used);
+	}
+	auto p = std::make_unique_for_overwrite<uint8_t[]>(total_size);
+	size_t pos = 0;
+	for_each_span([&](std::span<const uint8_t> s) {
+		std::memcpy(p.get() + pos, s.data(), s.size());
+		pos += s.size();
+	});
+	release_blocks();
+	flat = std::move(p);
+	flat_size = total_size;
+	return std::span<const uint8_t>(flat.get(), flat_size);
+}
+
+// 受信したデータを破棄する。ブロックはプールに返す
+void curl_base_chunk_stream::clear() noexcept
+{
+	release_blocks();
+	flat.reset();
+	flat_size = 0;
+	total_size = 0;
+}
+
+// 受信サイズが分かったときに呼ばれる
+// ブロックの中身はプールから借りるので、ここではチェーンの配列だけを必要な分確保しておく
+void curl_base_chunk_stream::set_expected_size(size_t size)
+{
+	const size_t bsize = pool->get_block_size();
+	blocks.reserve(blocks.size() + (size + bsize - 1) / bsize);
+}
+
+// 受信したデータをStringで返す
+std::string curl_base_chunk_stream::get_string() const &
+{
+	std::string str;
+	str.reserve(total_size);
+	for_each_span([&str](std::span<const uint8_t> s) {
+		str.append(reinterpret_cast<const char *>(s.data()), s.size());
+	});
+	return str;
+}
@@ -23,13 +23,17 @@
 
 
 #include "curlcxx_easy.h"
+#include "curlcxx_easy_pool.h"
 #include "curlcxx_mime.h"
+#include "curlcxx_share.h"
 #include "curlcxx_error.h"
 
 #include "classfname.h"
 
 using libcurlcxx::curl_base_easy;
 using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_easy_result;
+using libcurlcxx::make_easy_result;
 using libcurlcxx::curl_easy_unique_handle;
 using libcurlcxx::curl_base_mime;
 
@@ -48,14 +52,18 @@ curl_base_easy::curl_base_easy()
 		throw curl_base_exception("handle return null", __FCNAME, __LINE__);
 	}
 	handle.reset(p);
+	init_header_callback();
 	prog_callbk = nullptr;
 	prog_data = nullptr;
 	connect_timeout = 300;
 }
 
 // デストラクタ
+// shareを設定している場合は、ハンドルの解放(プールへの返却)より先に切り離しておく
 curl_base_easy::~curl_base_easy()
-{}
+{
+	if(share && handle) clear_option(CURLOPT_SHARE);
+}
 
 // コンストラクタ。通常はこれを使用する
 // streamer: curl_base_stream_objectを派生したオブジェクトのポインタ
@@ -69,6 +77,32 @@ curl_base_easy::curl_base_easy(const std::shared_ptr<curl_base_stream_object> &_
 		throw curl_base_exception("handle return null", __FCNAME, __LINE__);
 	}
 	handle.reset(p);
+	init_header_callback();
+	set_streamer(_streamer);
+	prog_callbk = nullptr;
+	prog_data = nullptr;
+	connect_timeout = 300;
+}
+
+// コンストラクタ。Easyハンドルをcurl_easy_initせずにプールから借りる
+// 借りたハンドルはこのオブジェクトが破棄されるとプールに返される
+// pool: ハンドルを借りるプール
+curl_base_easy::curl_base_easy(const std::shared_ptr<curl_base_easy_pool> &pool)
+{
+	handle = pool->acquire();
+	init_header_callback();
+	prog_callbk = nullptr;
+	prog_data = nullptr;
+	connect_timeout = 300;
+}
+
+// コンストラクタ。Easyハンドルをcurl_easy_initせずにプールから借りる
+// streamer: curl_base_stream_objectを派生したオブジェクトのポインタ
+// pool: ハンドルを借りるプール
+curl_base_easy::curl_base_easy(const std::shared_ptr<curl_base_stream_object> &_streamer, const std::shared_ptr<curl_base_easy_pool> &pool)
+{
+	handle = pool->acquire();
+	init_header_callback();
 	set_streamer(_streamer);
 	prog_callbk = nullptr;
 	prog_data = nullptr;
@@ -80,24 +114,31 @@ curl_base_easy::curl_base_easy(curl_base_easy &&other) noexcept
 {
 	handle = std::move(other.handle);
 	streamer = std::move(other.streamer);
+	uploader = std::move(other.uploader);
 	mime = std::move(other.mime);
+	share = std::move(other.share);
 	url = std::move(other.url);
 	prog_callbk = other.prog_callbk;
 	prog_data = other.prog_data;
 	connect_timeout = other.connect_timeout;
+	init_header_callback();		// HEADERDATAを移動先のthisにし直す
 }
 
 // ムーブ代入演算子
 curl_base_easy & curl_base_easy::operator= (curl_base_easy &&other) noexcept
 {
 	if (this != &other) {
+		if(share && handle) clear_option(CURLOPT_SHARE);
 		handle = std::move(other.handle);
 		streamer = std::move(other.streamer);
+		uploader = std::move(other.uploader);
 		mime = std::move(other.mime);
+		share = std::move(other.share);
 		url = std::move(other.url);
 		prog_callbk = other.prog_callbk;
 		prog_data = other.prog_data;
 		connect_timeout = other.connect_timeout;
+		init_header_callback();		// HEADERDATAを移動先のthisにし直す
 	}
 	return *this;
 }
@@ -121,6 +162,20 @@ void curl_base_easy::set_streamer(const std::shared_ptr<curl_base_stream_object>
 	set_option(CURLOPT_WRITEDATA, streamer.get());
 }
 
+// 送信するbodyを読み出すアップロード元を設定
+// CURLOPT_READFUNCTIONとCURLOPT_SEEKFUNCTIONが設定される。PUTやPOSTにするのは呼び出し側で行うこと
+// perform中にやるとどうなるかは不定
+// _uploader: curl_base_upload_objectを派生したオブジェクトのポインタ。転送が終わるまでこのクラスで保持する
+void curl_base_easy::set_uploader(const std::shared_ptr<curl_base_upload_object> &_uploader)
+{
+	uploader = _uploader;
+	uploader->rewind();
+	curl_easy_setopt(handle.get(), CURLOPT_READFUNCTION, uploader->get_read_function());
+	set_option(CURLOPT_READDATA, static_cast<void *>(uploader.get()));
+	curl_easy_setopt(handle.get(), CURLOPT_SEEKFUNCTION, uploader->get_seek_function());
+	set_option(CURLOPT_SEEKDATA, static_cast<void *>(uploader.get()));
+}
+
 // エラーのセット。このクラスの中及び派生クラスでのみ使用
 // curl_code: Curlのエラーコード
 void curl_base_easy::set_error(const int curl_code) noexcept
@@ -148,6 +203,19 @@ bool curl_base_easy::set_mime(const std::shared_ptr<curl_base_mime> &_mime)
 	return true;
 }
 
+// shareをセットして、接続キャッシュ・DNSキャッシュ・TLSセッションなどを他のEasyハンドルと共有する
+// perform中にやるとどうなるかは不定
+// _share: 共有するcurl_base_share。std::make_shared<>したものを入れること。nullptrなら共有をやめる
+bool curl_base_easy::set_share(const std::shared_ptr<curl_base_share> &_share)
+{
+	CURLcode ret;
+	if(_share)	ret = set_option(CURLOPT_SHARE, static_cast<void *>(_share->get_shandle()));
+	else		ret = clear_option(CURLOPT_SHARE);
+	if(ret != CURLE_OK) return false;
+	share = _share;
+	return true;
+}
+
 // 派生クラス用
 // mimeをセットしてPOSTとする。元の_mimeは所有権を移動され空になるので注意
 // FormPostでPerformするときもこれを使う必要がある
@@ -211,6 +279,51 @@ void curl_base_easy::set_progress_function(bool onoff, curl_base_easy_progress_c
 }
 
 
+// ヘッダ受信用のコールバックをこのオブジェクトに向けて登録する
+// ハンドルを持っていない(ムーブされた後など)場合は何もしない
+void curl_base_easy::init_header_callback() noexcept
+{
+	if(!handle) return;
+	set_header_callback(_header_callback_func);
+	set_option(CURLOPT_HEADERDATA, static_cast<void *>(this));
+}
+
+// libcurlから呼ばれるヘッダ受信のエントリポイント。ヘッダ1行ごとに呼ばれる
+size_t curl_base_easy::_header_callback_func(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+	const auto realsize = size * nitems;
+	if(userdata == nullptr) return realsize;
+	return static_cast<curl_base_easy*>(userdata)->internal_header_callback(buffer, realsize);
+}
+
+// ヘッダを1行受信するたびに呼び出される
+// これを派生先でオーバライドすることもできる(その場合はこの関数も呼ぶこと)
+// ヘッダの終わり(空行)で、Content-Lengthが分かっていればストリームに伝えて領域を先に確保させる
+// 1xxやリダイレクトの応答のヘッダは本体ではないので伝えない
+// return:
+//   realsize = 処理継続
+//   それ以外 = 転送の中断
+size_t curl_base_easy::internal_header_callback(char *buffer, size_t realsize)
+{
+	const bool endofheader = (realsize == 2 && buffer[0] == '\r' && buffer[1] == '\n') || (realsize == 1 && buffer[0] == '\n');
+	if(!endofheader || !streamer) return realsize;
+
+	long code = 0;
+	get_info(CURLINFO_RESPONSE_CODE, code);
+	if(code < 200 || (code >= 300 && code < 400)) return realsize;
+
+	curl_off_t length = -1;
+	if(curl_easy_getinfo(handle.get(), CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) != CURLE_OK) return realsize;
+	if(length <= 0) return realsize;
+
+	try{
+		streamer->set_expected_size(static_cast<size_t>(length));
+	}catch(...){
+		// 確保できなかった場合は今まで通り受信しながら伸ばしていく
+	}
+	return realsize;
+}
+
 // set_debugdumpをTrueにして、performを行い、通信が発生するたびに呼び出されるデバッグ用のコールバック関数
 int curl_base_easy::_debug_callback_func(CURL *handle, curl_infotype type, char *data, size_t size, void *userptr)
 {
@@ -285,10 +398,21 @@ void curl_base_easy::set_verbose(bool onoff)
 // なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
 void curl_base_easy::perform()
 {
-	// 投げる
+	if (!try_perform()) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// Easyハンドルでファイル転送を開始。例外を投げない版
+// 転送の失敗はエラーとして返すだけで例外は投げない。リトライが多い場合はこちらを使うとよい
+// 失敗した場合はget_errorcode/get_errorstrにも同じものが入る
+//
+// return: 結果。失敗ならCURLcodeとメッセージが入る
+curl_easy_result curl_base_easy::try_perform()
+{
 	const CURLcode code = curl_easy_perform(handle.get());
 	if (code != CURLE_OK) {
 		set_error(code);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
 	}
+	return make_easy_result(code);
 }
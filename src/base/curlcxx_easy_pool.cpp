@@ -0,0 +1,121 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "curlcxx_easy_pool.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_base_easy_pool;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_easy_unique_handle;
+using libcurlcxx::_curl_easy_handle_deleter;
+
+// Easyハンドルの解放
+// プールから借りたハンドルでプールがまだ生きていればプールへ返す。それ以外はcurl_easy_cleanupする
+void _curl_easy_handle_deleter::operator()(CURL *_ceh) const
+{
+	if (_ceh == nullptr) return;  // nullptrのときは何もしない
+	auto p = pool.lock();
+	if (p) {
+		p->release(_ceh);
+		return;
+	}
+	curl_easy_cleanup(_ceh);
+}
+
+// curl_base_easy_pool : curl Easyハンドルの再利用プール
+
+// コンストラクタ
+// _max_idle: 返却されたハンドルを保持しておく最大数。これを超えて返却されたものはcurl_easy_cleanupする
+curl_base_easy_pool::curl_base_easy_pool(size_t _max_idle)
+	: max_idle(_max_idle), created(0), reused(0)
+{
+	idle.reserve(max_idle);
+}
+
+// デストラクタ
+// 待機中のハンドルをすべて解放する
+curl_base_easy_pool::~curl_base_easy_pool()
+{
+	shrink();
+}
+
+// ハンドルを1つ借りる
+// 空いているハンドルがあればそれを、なければcurl_easy_initしたものを返す
+// 返したハンドルは破棄されるときにこのプールに返却される
+//
+// なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
+curl_easy_unique_handle curl_base_easy_pool::acquire()
+{
+	CURL *p = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(lk);
+		if (!idle.empty()) {
+			p = idle.back();
+			idle.pop_back();
+		}
+	}
+	if (p != nullptr) {
+		reused.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		p = curl_easy_init();
+		if (p == nullptr) {
+			throw curl_base_exception("handle return null", __FCNAME, __LINE__);
+		}
+		created.fetch_add(1, std::memory_order_relaxed);
+	}
+	return curl_easy_unique_handle(p, _curl_easy_handle_deleter{weak_from_this()});
+}
+
+// ハンドルを返却する。通常はcurl_easy_unique_handleの破棄時に呼ばれるので直接呼ぶ必要はない
+// curl_easy_resetで設定を初期化してから保持する。接続キャッシュ・DNSキャッシュ・TLSセッションは残る
+// 保持数がmax_idleに達している場合はcurl_easy_cleanupする
+void curl_base_easy_pool::release(CURL *_ceh) noexcept
+{
+	if (_ceh == nullptr) return;
+	curl_easy_reset(_ceh);
+	{
+		std::lock_guard<std::mutex> lock(lk);
+		if (idle.size() < max_idle) {
+			idle.push_back(_ceh);
+			return;
+		}
+	}
+	curl_easy_cleanup(_ceh);
+}
+
+// 待機中のハンドルをすべて解放する
+// 借りられているハンドルには影響しない
+void curl_base_easy_pool::shrink() noexcept
+{
+	std::vector<CURL *> tmp;
+	{
+		std::lock_guard<std::mutex> lock(lk);
+		tmp.swap(idle);
+	}
+	for (auto p : tmp) {
+		curl_easy_cleanup(p);
+	}
+}
@@ -21,35 +21,144 @@
 // THE SOFTWARE.
 //
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "curlcxx_error.h"
-#include "curlcxx_utility.h"
 
 using libcurlcxx::curl_base_object;
 using libcurlcxx::curl_base_error;
 using libcurlcxx::curl_base_errqueue;
 using libcurlcxx::curl_base_exception;
-using libcurlcxx::format;
-
-// 以下2つはStaticであるのでここに実体を定義する必要がある
-libcurlcxx::curl_base_errqueue libcurlcxx::curl_base_exception::errlog;			// エラーログ（全共通）
-std::mutex libcurlcxx::curl_base_exception::errlog_lk;							// エラーログロック（全共通）
 
 using std::deque;
 using std::string;
 using std::string_view;
 
+// -----------------------------------------------------------------------------------------------------------------------
+// エラーログの置き場所
+// スレッドごとにリングバッファを1つ持ち、そのスレッドだけが書き込む。書き込みにはロックを使わない
+// 読み出し(get_errlog)は別スレッドから行うので、1件ごとにシーケンス番号(seqlock)を付けて
+// 書き込み途中のものを読んだ場合は捨てる
+//
+// リングバッファは終了したスレッドのものも残しておき、後から作られたスレッドが引き継いで使う
+// そのためリングバッファの数は同時に動いていたスレッドの最大数までしか増えない
+namespace
+{
+	// ログ1件分
+	struct _errlog_slot
+	{
+		std::atomic<uint32_t>	seq{0};			// 奇数なら書き込み中。0ならまだ書かれていない
+		curl_base_error			rec;
+	};
+
+	// スレッド1つ分のリングバッファ
+	struct _errlog_ring
+	{
+		_errlog_slot			slots[curl_base_exception::errlog_ring_size];
+		uint64_t				count = 0;				// これまでに積んだ件数。持ち主のスレッドだけが触る
+		std::atomic<bool>		in_use{false};			// 持ち主のスレッドがいるか
+	};
+
+	// すべてのリングバッファの一覧
+	// 終了時に他のスレッドがまだエラーを積んでいるかもしれないので、わざと解放しない
+	struct _errlog_registry
+	{
+		std::mutex									lk;		// ringsの追加と一覧の取得だけに使う
+		std::vector<std::unique_ptr<_errlog_ring>>	rings;
+		std::atomic<uint64_t>						cleared_at{0};		// clear_errlogした時刻。これより前のログは返さない
+	};
+
+	_errlog_registry &_get_errlog_registry()
+	{
+		static _errlog_registry *reg = new _errlog_registry();
+		return *reg;
+	}
+
+	// スレッドが終了したら、持っていたリングバッファを他のスレッドに譲る
+	// 譲った後に同じスレッドの終了処理(他のthread_localのデストラクタなど)で例外が投げられても、
+	// もう他のスレッドのものになったリングバッファに書かないよう、以降のログは捨てる
+	struct _errlog_owner
+	{
+		_errlog_ring	*ring = nullptr;
+		bool			released = false;		// 譲った後ならtrue
+		~_errlog_owner()
+		{
+			if(ring != nullptr) ring->in_use.store(false, std::memory_order_release);
+			ring = nullptr;
+			released = true;
+		}
+	};
+	thread_local _errlog_owner _errlog_this_thread;
+
+	// このスレッドのリングバッファを返す。はじめて呼ばれたときだけ一覧から空きを探すか新しく作る
+	// 作れなかった場合とスレッドの終了処理中はnullptr(ログは残らない)
+	_errlog_ring *_get_errlog_ring() noexcept
+	{
+		if(_errlog_this_thread.ring != nullptr) return _errlog_this_thread.ring;
+		if(_errlog_this_thread.released) return nullptr;
+		try{
+			_errlog_registry &reg = _get_errlog_registry();
+			std::scoped_lock lk{reg.lk};
+			for(auto &r : reg.rings){
+				bool expected = false;
+				if(r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)){
+					_errlog_this_thread.ring = r.get();
+					return r.get();
+				}
+			}
+			auto r = std::make_unique<_errlog_ring>();
+			r->in_use.store(true, std::memory_order_relaxed);
+			_errlog_this_thread.ring = r.get();
+			reg.rings.push_back(std::move(r));
+		}catch(...){
+			return nullptr;
+		}
+		return _errlog_this_thread.ring;
+	}
+
+	uint64_t _errlog_now() noexcept
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}  // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------
 // curl_base_error : curlの例外オブジェクト(1要素)のC++実装
 
+// 文字列を固定長の配列にコピーする。入りきらない分は切り捨てる
+void curl_base_error::copy_str(char *dst, size_t max, std::string_view src) noexcept
+{
+	const size_t len = std::min(max, src.size());
+	std::memcpy(dst, src.data(), len);
+	dst[len] = '\0';
+}
+
+// 空のコンストラクタ。リングバッファの初期化用
+curl_base_error::curl_base_error() noexcept
+{
+	message[0] = '\0';
+	funcname[0] = '\0';
+	funcline = 0;
+	errorcode = 0;
+	timestamp = 0;
+}
+
 // コンストラクタ
 // mess: エラーメッセージ詳細
 // func: エラーを起こした関数
 // line: エラーを起こした行番号
 curl_base_error::curl_base_error(std::string_view mess, std::string_view func, const int line) noexcept
 {
-	message = mess;
+	copy_str(message, message_max, mess);
 	errorcode = 0;
-	funcname = func;
+	copy_str(funcname, funcname_max, func);
 	funcline = line;
+	timestamp = _errlog_now();
 }
 
 // コンストラクタ
@@ -58,10 +167,11 @@ curl_base_error::curl_base_error(std::string_view mess, std::string_view func, c
 // line: エラーを起こした行番号
 curl_base_error::curl_base_error(const libcurlcxx::curl_base_object* obj, std::string_view func, const int line) noexcept
 {
-	message = obj->get_errorstr();
+	copy_str(message, message_max, obj->get_errorstr());
 	errorcode = obj->get_errorcode();
-	funcname = func;
+	copy_str(funcname, funcname_max, func);
 	funcline = line;
+	timestamp = _errlog_now();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------
@@ -72,13 +182,10 @@ curl_base_error::curl_base_error(const libcurlcxx::curl_base_object* obj, std::s
 // func: エラーを起こした関数
 // line: エラーを起こした行番号
 curl_base_exception::curl_base_exception(std::string_view mess, std::string_view func, const int line) noexcept
+	: err(mess, func, line)
 {
-	std::scoped_lock lk{errlog_lk};			// ScopedLockでなくていいんだけどとりあえず
-	curl_base_error e(mess, func, line);
-
-	errlog.push_front(e);
-	// 直近エラーの文字列化をする。what()でこれを返すためである
-	err_mes = libcurlcxx::format("error: %s,func %s line %d", e.get_message().c_str(), e.get_funcname().c_str(), e.get_funcline());
+	format_mes();
+	push_errlog(err);
 }
 
 // コンストラクタ(easyやmultiなどのcurlオブジェクト用)。これをthrowで投げること
@@ -86,58 +193,106 @@ curl_base_exception::curl_base_exception(std::string_view mess, std::string_view
 // func: エラーを起こした関数
 // line: エラーを起こした行番号
 curl_base_exception::curl_base_exception(const libcurlcxx::curl_base_object* obj, std::string_view func, const int line) noexcept
+	: err(obj, func, line)
 {
-	std::scoped_lock lk{errlog_lk};			// ScopedLockでなくていいんだけどとりあえず
-	curl_base_error e(obj, func, line);
-	errlog.push_front(e);
-	// 直近エラーの文字列化をする。what()でこれを返すためである
-	err_mes = libcurlcxx::format("error: %s, func %s line %d", e.get_message().c_str(), e.get_funcname().c_str(), e.get_funcline());
+	format_mes();
+	push_errlog(err);
 }
 
 // コピーコンストラクタ
+// エラーログはコピーしない
 curl_base_exception::curl_base_exception(const curl_base_exception &object) noexcept
+	: std::exception(object), err(object.err)
 {
-	errlog = object.get_errlog();
-	err_mes = object.get_errmes();
+	std::memcpy(err_mes, object.err_mes, sizeof(err_mes));
 }
 
 // ただの代入
-curl_base_exception& curl_base_exception::operator=(curl_base_exception const &object)
+curl_base_exception& curl_base_exception::operator=(curl_base_exception const &object) noexcept
 {
 	if (&object != this) {
-		errlog = object.get_errlog();
-		err_mes = object.get_errmes();
+		err = object.err;
+		std::memcpy(err_mes, object.err_mes, sizeof(err_mes));
 	}
 	return *this;
 }
 
+// このスレッドのリングバッファにエラーを積む
+// 持ち主のスレッドしか書かないのでロックは不要。読み出し側のためにシーケンス番号を奇数にしてから書き、偶数に戻す
+void curl_base_exception::push_errlog(const curl_base_error &e) noexcept
+{
+	_errlog_ring *ring = _get_errlog_ring();
+	if(ring == nullptr) return;
+
+	_errlog_slot &slot = ring->slots[ring->count % errlog_ring_size];
+	const uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+	slot.seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(static_cast<void *>(&slot.rec), &e, sizeof(curl_base_error));
+	slot.seq.store(seq + 2, std::memory_order_release);
+	ring->count++;
+}
+
 // エラーログ本体キューを外部から取得
+// すべてのスレッドのリングバッファを集めて、新しいものが先頭になるように並べる
+// 読んでいる最中に書き換えられたものは返さない
 curl_base_errqueue curl_base_exception::get_errlog()
 {
-	std::scoped_lock lk{errlog_lk};
-	curl_base_errqueue tmp = errlog;
-	return tmp;
+	_errlog_registry &reg = _get_errlog_registry();
+	std::vector<_errlog_ring *> rings;
+	{
+		std::scoped_lock lk{reg.lk};
+		rings.reserve(reg.rings.size());
+		for(auto &r : reg.rings) rings.push_back(r.get());
+	}
+	const uint64_t cleared_at = reg.cleared_at.load(std::memory_order_acquire);
+
+	std::vector<curl_base_error> recs;
+	recs.reserve(rings.size() * errlog_ring_size);
+	curl_base_error tmp;
+	for(_errlog_ring *ring : rings){
+		for(auto &slot : ring->slots){
+			const uint32_t seq1 = slot.seq.load(std::memory_order_acquire);
+			if(seq1 == 0 || (seq1 & 1) != 0) continue;
+			std::memcpy(static_cast<void *>(&tmp), &slot.rec, sizeof(curl_base_error));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(slot.seq.load(std::memory_order_relaxed) != seq1) continue;
+			if(tmp.get_timestamp() <= cleared_at) continue;
+			recs.push_back(tmp);
+		}
+	}
+	std::sort(recs.begin(), recs.end(), [](const curl_base_error &a, const curl_base_error &b) {
+		return a.get_timestamp() > b.get_timestamp();
+	});
+	return curl_base_errqueue(recs.begin(), recs.end());
 }
 
 // エラーログをSTDOUTに出力する
 // 最後に発生したエラーから表示される。デバッグ用として使用できる
 void curl_base_exception::print_errlog()
 {
-	std::scoped_lock lk{errlog_lk};
-	std::for_each(errlog.begin(), errlog.end(), [](const curl_base_error &value) {
-		std::cout << "ERROR: "<< value.get_message() <<" FUNCLINE: "<< value.get_funcline() << std::endl;
+	const curl_base_errqueue log = get_errlog();
+	std::for_each(log.begin(), log.end(), [](const curl_base_error &value) {
+		std::cout << "ERROR: "<< value.message_cstr() <<" FUNCLINE: "<< value.get_funcline() << std::endl;
 	});
 }
 
 // エラーログの全クリア
-void curl_base_exception::clear_errlog()
+// 他のスレッドのリングバッファには書き込めないので、今の時刻を覚えておいてそれより前のログを返さないようにする
+void curl_base_exception::clear_errlog() noexcept
+{
+	_get_errlog_registry().cleared_at.store(_errlog_now(), std::memory_order_release);
+}
+
+// what()で返す文字列を整形する。コンストラクタでだけ呼ぶ
+void curl_base_exception::format_mes() noexcept
 {
-	std::scoped_lock lk{errlog_lk};
-	errlog.clear();
+	std::snprintf(err_mes, sizeof(err_mes), "error: %s, func %s line %d", err.message_cstr(), err.funcname_cstr(), err.get_funcline());
 }
 
 // 直近のエラーメッセージ類の出力
+// 整形済みの文字列を返すだけなので、複数のスレッドから同時に呼んでもよい
 const char* curl_base_exception::what() const noexcept
 {
-	return err_mes.c_str();
+	return err_mes;
 }
@@ -0,0 +1,203 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "curlcxx_file_stream.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_base_mmap_filestream;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::writef::_check_callback_arg;
+
+// --------------------------------------------------
+// curl_base_mmap_filestream : mmapしたファイルに直接書き込むストリーム
+
+// ページサイズの倍数に切り上げる
+static size_t _round_page(size_t size)
+{
+	static const size_t pagesize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	if(size == 0) return pagesize;
+	return (size + pagesize - 1) / pagesize * pagesize;
+}
+
+// コンストラクタ
+// 書き込み先のファイルを作成する。既にある場合は中身を捨てる
+// _path: 書き込み先ファイルのパス
+// _window_size: 一度にmmapする大きさ。ページサイズの倍数に切り上げられる
+// _grow_step: Content-Lengthが分からない場合に、ファイルを伸ばす単位
+//
+// ファイルが作れなかったら例外を投げるのでtry-catchで囲むこと
+curl_base_mmap_filestream::curl_base_mmap_filestream(std::string_view _path, size_t _window_size, size_t _grow_step)
+	: path(_path), window_size(_round_page(_window_size)), grow_step(_grow_step == 0 ? DEFAULT_GROW_STEP : _grow_step),
+	  use_mmap(true), failed(false), window(nullptr), window_off(0), window_len(0), expected_end(0), file_size(0), written(0)
+{
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd < 0){
+		throw curl_base_exception(std::string("can not open ") + path + ": " + std::strerror(errno), __FCNAME, __LINE__);
+	}
+	set_write_callback(_callback_func);
+}
+
+// デストラクタ。まだ閉じていなければ閉じる
+curl_base_mmap_filestream::~curl_base_mmap_filestream()
+{
+	close();
+}
+
+// 受信サイズが分かったときに呼ばれる
+// これから書く分の領域をposix_fallocateでまとめて確保しておく。断片化を防ぎ、途中でディスクが足りなくなることもない
+// 確保できなかった場合は何もしない。窓をmmapするときにもう一度確保を試み、それも駄目ならpwriteで書く
+// 以降はこの終わりまでしか領域を確保せず、mmapもここまでにする
+void curl_base_mmap_filestream::set_expected_size(size_t size)
+{
+	if(fd < 0 || failed) return;
+	const size_t need = written + size;
+	expected_end = need;
+	if(need <= file_size) return;
+	if(posix_fallocate(fd, static_cast<off_t>(file_size), static_cast<off_t>(need - file_size)) == 0){
+		file_size = need;
+	}
+}
+
+// 何かサーバからデータが来るとこれがCurlから呼ばれる
+size_t curl_base_mmap_filestream::_callback_func(char *buffer, size_t size, size_t nitems, void *outstream)
+{
+	auto realsize = _check_callback_arg(buffer, size, nitems);
+	if(realsize == 0) return 0;
+	return static_cast<curl_base_mmap_filestream*>(outstream)->internal_write(buffer, realsize);
+}
+
+// データを書き込む
+// 窓の中ならそのままコピーし、窓の外に出たら窓を移動する
+// 失敗した場合は0を返してlibcurlに転送を中断させる(CURLE_WRITE_ERRORになる)
+size_t curl_base_mmap_filestream::internal_write(char *buffer, size_t realsize)
+{
+	if(fd < 0 || failed) return 0;
+
+	if(!use_mmap){
+		if(!write_pwrite(buffer, realsize)) return 0;
+		return realsize;
+	}
+
+	size_t left = realsize;
+	while(left != 0){
+		if(window == nullptr || written < window_off || written >= window_off + window_len){
+			if(!map_window(written)){
+				// mmapできないか領域が確保できないので以降はpwriteで書く。ディスクが一杯ならpwriteが失敗してCURLE_WRITE_ERRORになる
+				use_mmap = false;
+				if(!write_pwrite(buffer, left)) return 0;
+				return realsize;
+			}
+		}
+		const size_t n = std::min(left, window_off + window_len - written);
+		std::memcpy(window + (written - window_off), buffer, n);
+		written += n;
+		buffer += n;
+		left -= n;
+	}
+	return realsize;
+}
+
+// ファイルのサイズをsize以上にする。足りない場合はgrow_step単位で伸ばす
+// ただし受信サイズが分かっていてその終わりまでに収まる場合は、ちょうどsizeまでしか伸ばさない
+// ftruncateで伸ばすだけだとディスク上の領域が確保されない穴になり、ディスクが一杯のときにmmapした所へ書くとSIGBUSで落ちる
+// そのためposix_fallocateで実際に領域を確保する。確保できなかった場合はfalseを返すので、mmapせずにpwriteで書くこと
+bool curl_base_mmap_filestream::ensure_file_size(size_t size)
+{
+	if(size <= file_size) return true;
+	const size_t newsize = (size <= expected_end) ? size : (size + grow_step - 1) / grow_step * grow_step;
+	if(posix_fallocate(fd, static_cast<off_t>(file_size), static_cast<off_t>(newsize - file_size)) != 0){
+		return false;
+	}
+	file_size = newsize;
+	return true;
+}
+
+// posを含む窓をmmapする。前の窓はmunmapする
+// 窓の範囲のディスク領域を先にensure_file_sizeで確保しておく。確保できなければfalseを返す(呼び出し側はpwriteに切り替える)
+// 受信サイズが分かっている場合は、窓をその終わりまでに縮める。終わりを超えて書く場合は普段通りの窓にする
+bool curl_base_mmap_filestream::map_window(size_t pos)
+{
+	unmap_window();
+	const size_t off = pos / window_size * window_size;
+	size_t len = window_size;
+	if(pos < expected_end) len = std::min(len, expected_end - off);
+	if(!ensure_file_size(off + len)) return false;
+
+	void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(off));
+	if(p == MAP_FAILED) return false;
+	madvise(p, len, MADV_SEQUENTIAL);
+	window = static_cast<unsigned char *>(p);
+	window_off = off;
+	window_len = len;
+	return true;
+}
+
+// 現在の窓をmunmapする。書いた内容はページキャッシュに残り、カーネルが書き出す
+void curl_base_mmap_filestream::unmap_window() noexcept
+{
+	if(window == nullptr) return;
+	munmap(window, window_len);
+	window = nullptr;
+}
+
+// mmapを使わずにpwriteで書き込む
+bool curl_base_mmap_filestream::write_pwrite(const char *buffer, size_t size)
+{
+	while(size != 0){
+		ssize_t ret = pwrite(fd, buffer, size, static_cast<off_t>(written));
+		if(ret < 0){
+			if(errno == EINTR) continue;
+			failed = true;
+			return false;
+		}
+		written += static_cast<size_t>(ret);
+		buffer += ret;
+		size -= static_cast<size_t>(ret);
+	}
+	return true;
+}
+
+// 受信を終えてファイルを閉じる
+// 先に確保していた分はここで実際に書いたサイズに切り詰める
+// return:
+//   true : 正常に閉じた
+//   false : 書き込みか切り詰めに失敗した
+bool curl_base_mmap_filestream::close() noexcept
+{
+	if(fd < 0) return !failed;
+	unmap_window();
+	if(ftruncate(fd, static_cast<off_t>(written)) != 0) failed = true;
+	if(::close(fd) != 0) failed = true;
+	fd = -1;
+	return !failed;
+}
@@ -21,6 +21,9 @@
 // THE SOFTWARE.
 //
 
+#include <cstdio>
+#include <cstring>
+
 #include "curlcxx_mime.h"
 #include "curlcxx_error.h"
 
@@ -28,6 +31,9 @@
 
 using libcurlcxx::curl_base_easy;
 using libcurlcxx::curl_base_mime;
+using libcurlcxx::curl_base_mime_part;
+using libcurlcxx::curl_base_mime_reader;
+using libcurlcxx::curl_base_slist;
 using libcurlcxx::curl_base_exception;
 
 using std::string;
@@ -79,7 +85,7 @@ curl_base_mime & curl_base_mime::operator= (curl_base_mime &&other) noexcept
 // name: 名前
 void curl_base_mime::set_name_part(curl_mimepart *part, std::string_view name)
 {
-	CURLcode ret = curl_mime_name(part, name.data());
+	CURLcode ret = curl_mime_name(part, std::string(name).c_str());
 	if(ret != CURLE_OK){
 		throw curl_base_exception("error: curl_mime_name", __FCNAME, __LINE__);
 	}
@@ -101,7 +107,7 @@ curl_mimepart* curl_base_mime::create_part()
 // 失敗したら例外を返すので注意
 // name: 名前
 // str: なんらかの文字列
-void curl_base_mime::add_part(std::string_view name, std::string_view str)
+curl_base_mime_part curl_base_mime::add_part(std::string_view name, std::string_view str)
 {
 	curl_mimepart* h_part = create_part();
 	// お名前を設定
@@ -111,6 +117,7 @@ void curl_base_mime::add_part(std::string_view name, std::string_view str)
 	if(ret != CURLE_OK){
 		throw curl_base_exception("error: curl_mime_data", __FCNAME, __LINE__);
 	}
+	return curl_base_mime_part(h_part);
 }
 
 // 名前と何らかのデータ列のmime_partを追加する
@@ -118,7 +125,7 @@ void curl_base_mime::add_part(std::string_view name, std::string_view str)
 // name: 名前
 // data: データ列へのポインタ
 // size: データ列のByteサイズ
-void curl_base_mime::add_part(std::string_view name, const char* data, size_t size)
+curl_base_mime_part curl_base_mime::add_part(std::string_view name, const char* data, size_t size)
 {
 	curl_mimepart* h_part = create_part();
 	// お名前を設定
@@ -128,4 +135,167 @@ void curl_base_mime::add_part(std::string_view name, const char* data, size_t si
 	if(ret != CURLE_OK){
 		throw curl_base_exception("error: curl_mime_data", __FCNAME, __LINE__);
 	}
+	return curl_base_mime_part(h_part);
+}
+
+// 名前とファイルのmime_partを追加する
+// ファイルの中身はメモリに読み込まず、送信しながらlibcurlが少しずつ読む
+// ファイル名(パスを除いたもの)も自動で設定される。変えたい場合は戻り値のset_filenameを使う
+// 失敗したら例外を返すので注意
+// name: 名前
+// path: 送信するファイルのパス。performするまでに存在すればよい
+curl_base_mime_part curl_base_mime::add_file_part(std::string_view name, std::string_view path)
+{
+	curl_mimepart* h_part = create_part();
+	set_name_part(h_part, name);
+	CURLcode ret = curl_mime_filedata(h_part, std::string(path).c_str());
+	if(ret != CURLE_OK){
+		throw curl_base_exception("error: curl_mime_filedata " + std::string(path), __FCNAME, __LINE__);
+	}
+	return curl_base_mime_part(h_part);
+}
+
+// 名前と読み出しクラスのmime_partを追加する
+// 送信するときにreaderのreadが呼ばれ、必要な分だけ読み出される
+// 失敗したら例外を返すので注意
+// name: 名前
+// reader: curl_base_mime_readerを派生したオブジェクト。mimeが破棄されるまで保持される
+// size: 送信するバイト数。分からない場合は-1(chunkedで送られる)
+curl_base_mime_part curl_base_mime::add_reader_part(std::string_view name, const std::shared_ptr<curl_base_mime_reader> &reader, curl_off_t size)
+{
+	if(!reader){
+		throw curl_base_exception("error: reader is null", __FCNAME, __LINE__);
+	}
+	curl_mimepart* h_part = create_part();
+	set_name_part(h_part, name);
+	// libcurlにはshared_ptrのコピーを渡し、_free_callbackで解放してもらう
+	auto holder = new std::shared_ptr<curl_base_mime_reader>(reader);
+	CURLcode ret = curl_mime_data_cb(h_part, size, _read_callback, _seek_callback, _free_callback, holder);
+	if(ret != CURLE_OK){
+		delete holder;
+		throw curl_base_exception("error: curl_mime_data_cb", __FCNAME, __LINE__);
+	}
+	return curl_base_mime_part(h_part);
+}
+
+namespace
+{
+// 呼び出し元のバッファをコピーせずに送る読み出しクラス
+class _curl_mime_borrowed_reader : public curl_base_mime_reader
+{
+private:
+	const char		*data;
+	size_t			size;
+	size_t			pos;
+
+public:
+	_curl_mime_borrowed_reader(const char *_data, size_t _size) noexcept : data(_data), size(_size), pos(0){}
+
+	size_t read(char *buffer, size_t len)
+	{
+		const size_t n = std::min(len, size - pos);
+		std::memcpy(buffer, data + pos, n);
+		pos += n;
+		return n;
+	}
+	bool seek(curl_off_t offset, int origin)
+	{
+		curl_off_t base = 0;
+		if(origin == SEEK_CUR)		base = static_cast<curl_off_t>(pos);
+		else if(origin == SEEK_END)	base = static_cast<curl_off_t>(size);
+		const curl_off_t npos = base + offset;
+		if(npos < 0 || npos > static_cast<curl_off_t>(size)) return false;
+		pos = static_cast<size_t>(npos);
+		return true;
+	}
+};
+}  // namespace
+
+// 名前と何らかのデータ列のmime_partを追加する
+// add_partと違いデータはコピーされず、送信するときに直接読まれる
+// 失敗したら例外を返すので注意
+// name: 名前
+// data: データ列へのポインタ。performが終わるまで解放・変更してはいけない
+// size: データ列のByteサイズ
+curl_base_mime_part curl_base_mime::add_borrowed_part(std::string_view name, const char* data, size_t size)
+{
+	return add_reader_part(name, std::make_shared<_curl_mime_borrowed_reader>(data, size), static_cast<curl_off_t>(size));
+}
+
+// partのデータを読み出すときにlibcurlから呼ばれる
+size_t curl_base_mime::_read_callback(char *buffer, size_t size, size_t nitems, void *arg)
+{
+	auto &reader = *static_cast<std::shared_ptr<curl_base_mime_reader>*>(arg);
+	// 例外はlibcurlの中を通せないのでここで止める
+	try{
+		return reader->read(buffer, size * nitems);
+	}catch(...){
+		return CURL_READFUNC_ABORT;
+	}
+}
+
+// partを最初から送り直すときなどにlibcurlから呼ばれる
+int curl_base_mime::_seek_callback(void *arg, curl_off_t offset, int origin)
+{
+	auto &reader = *static_cast<std::shared_ptr<curl_base_mime_reader>*>(arg);
+	try{
+		return reader->seek(offset, origin) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_CANTSEEK;
+	}catch(...){
+		return CURL_SEEKFUNC_FAIL;
+	}
+}
+
+// mimeが破棄されるときにlibcurlから呼ばれる
+void curl_base_mime::_free_callback(void *arg)
+{
+	delete static_cast<std::shared_ptr<curl_base_mime_reader>*>(arg);
+}
+
+// -----------------------------------------------------------------------
+// curl_base_mime_part : 追加したpartの設定
+
+// Content-Typeを設定する
+// 失敗したら例外を返すので注意
+// type: "image/png"など
+curl_base_mime_part &curl_base_mime_part::set_type(std::string_view type)
+{
+	if(curl_mime_type(part, std::string(type).c_str()) != CURLE_OK){
+		throw curl_base_exception("error: curl_mime_type", __FCNAME, __LINE__);
+	}
+	return *this;
+}
+
+// Content-Dispositionのfilenameを設定する
+// 失敗したら例外を返すので注意
+// filename: 受け取った側に見せるファイル名
+curl_base_mime_part &curl_base_mime_part::set_filename(std::string_view filename)
+{
+	if(curl_mime_filename(part, std::string(filename).c_str()) != CURLE_OK){
+		throw curl_base_exception("error: curl_mime_filename", __FCNAME, __LINE__);
+	}
+	return *this;
+}
+
+// Content-Transfer-Encodingを設定する
+// 失敗したら例外を返すので注意
+// encoding: "base64" "quoted-printable" "binary" "8bit" "7bit"のどれか
+curl_base_mime_part &curl_base_mime_part::set_encoder(std::string_view encoding)
+{
+	if(curl_mime_encoder(part, std::string(encoding).c_str()) != CURLE_OK){
+		throw curl_base_exception("error: curl_mime_encoder", __FCNAME, __LINE__);
+	}
+	return *this;
+}
+
+// このpartだけに付けるヘッダを設定する
+// 失敗したら例外を返すので注意
+// headers: 付けるヘッダ。中身はmimeに引き取られ、headersは空になる
+curl_base_mime_part &curl_base_mime_part::set_headers(curl_base_slist &&headers)
+{
+	curl_slist *list = headers.release_slistptr();
+	if(curl_mime_headers(part, list, 1) != CURLE_OK){
+		curl_slist_free_all(list);
+		throw curl_base_exception("error: curl_mime_headers", __FCNAME, __LINE__);
+	}
+	return *this;
 }
@@ -28,14 +28,22 @@
 
 using libcurlcxx::curl_base_multi;
 using libcurlcxx::curl_base_multi_message;
+using libcurlcxx::curl_base_multi_done;
+using libcurlcxx::curl_base_multi_done_handler;
+using libcurlcxx::curl_base_multi_entry;
 using libcurlcxx::curl_multi_unique_handle;
 using libcurlcxx::curl_base_easy;
 using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_multi_result;
+using libcurlcxx::make_multi_result;
 
 using std::unique_ptr;
 using std::weak_ptr;
 using std::shared_ptr;
 
+// run/run_until_idleでpollが待つ最大時間(ミリ秒)。libcurlのタイムアウトがこれより短ければそちらを優先する
+#define CURLCXX_MULTI_RUN_WAIT_MS		(1000)
+
 // curl_base_multi_message: CURLMsg用のクラス
 
 // コンストラクタ
@@ -65,6 +73,8 @@ curl_base_multi_message::curl_base_multi_message(const CURLMsg *msg, const std::
 curl_base_multi::curl_base_multi()
 {
 	active_transfers = 0;
+	handler_entries = 0;
+	stop_requested = false;
 	CURLM *p = curl_multi_init();
 	if(p == nullptr){
 		throw curl_base_exception("handle return null", __FCNAME, __LINE__);
@@ -89,7 +99,10 @@ curl_base_multi::curl_base_multi(curl_base_multi &&other) noexcept
 {
 	_multi = std::move(other._multi);
 	handles = std::move(other.handles);
+	done_batch = std::move(other.done_batch);
 	active_transfers = other.active_transfers;
+	handler_entries = other.handler_entries;
+	stop_requested = other.stop_requested.load();
 }
 
 // ムーブコンストラクタ
@@ -98,7 +111,10 @@ curl_base_multi &curl_base_multi::operator=(curl_base_multi&& other) noexcept
 	if (this != &other) {
 		_multi = std::move(other._multi);
 		handles = std::move(other.handles);
+		done_batch = std::move(other.done_batch);
 		active_transfers = other.active_transfers;
+		handler_entries = other.handler_entries;
+		stop_requested = other.stop_requested.load();
 	}
 	return *this;
 }
@@ -118,20 +134,54 @@ void curl_base_multi::set_error(const int curl_code) noexcept
 // easy: 登録したいEasyオブジェクトを指定する
 void curl_base_multi::add(const std::shared_ptr<curl_base_easy> &easy)
 {
+	add(easy, nullptr);
+}
+
+// EasyハンドルをMultiへ登録する。転送が終わったときに呼ぶハンドラ付き
+// ハンドラはrun/run_until_idle/dispatch_doneの中から呼ばれ、呼ばれる前にmultiからは登録解除される
+// 注意：EasyハンドルのCURLOPT_PRIVATEはmulti側で使うので、登録中は使わないこと
+//
+// easy: 登録したいEasyオブジェクトを指定する
+// handler: 転送が終わったときに呼ぶハンドラ。nullptrならadd(easy)と同じ
+void curl_base_multi::add(const std::shared_ptr<curl_base_easy> &easy, curl_base_multi_done_handler handler)
+{
+	if (!try_add(easy, std::move(handler))) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// EasyハンドルをMultiへ登録する。例外を投げない版
+// easy: 登録したいEasyオブジェクトを指定する
+// return: 結果。登録済みのものを渡した場合はCURLM_ADDED_ALREADY
+curl_multi_result curl_base_multi::try_add(const std::shared_ptr<curl_base_easy> &easy)
+{
+	return try_add(easy, nullptr);
+}
+
+// EasyハンドルをMultiへ登録する。ハンドラ付き、例外を投げない版
+// easy: 登録したいEasyオブジェクトを指定する
+// handler: 転送が終わったときに呼ぶハンドラ。nullptrならtry_add(easy)と同じ
+// return: 結果。登録済みのものを渡した場合はCURLM_ADDED_ALREADY
+curl_multi_result curl_base_multi::try_add(const std::shared_ptr<curl_base_easy> &easy, curl_base_multi_done_handler handler)
+{
+	CURL *h = easy->get_chandle();
 	// 登録済みか見る。登録済みだったら駄目
-	auto it = handles.find(easy->get_chandle());
-	if (it != this->handles.end()){
-		// 見つかってしまった。まずいので例外を投げる
-		throw curl_base_exception("error: handle already registered", __FCNAME, __LINE__);
+	auto [it, inserted] = handles.try_emplace(h, curl_base_multi_entry{easy, std::move(handler)});
+	if (!inserted){
+		set_error(CURLM_ADDED_ALREADY);
+		return make_multi_result(CURLM_ADDED_ALREADY);
 	}
+	// マップの要素のアドレスは再ハッシュしても変わらないので、これを覚えさせておく
+	curl_easy_setopt(h, CURLOPT_PRIVATE, static_cast<void *>(&it->second));
 	// 実際に登録
-	const CURLMcode code = curl_multi_add_handle(_multi.get(), easy->get_chandle());
-	if (code == CURLM_OK) {
-		handles[easy->get_chandle()] = easy;
-	} else {
+	const CURLMcode code = curl_multi_add_handle(_multi.get(), h);
+	if (code != CURLM_OK) {
+		handles.erase(it);
 		set_error(code);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
+		return make_multi_result(code);
 	}
+	if (it->second.handler) handler_entries++;
+	return curl_multi_result();
 }
 
 // 指定したEasyハンドルをMultiから登録解除する
@@ -142,21 +192,39 @@ void curl_base_multi::add(const std::shared_ptr<curl_base_easy> &easy)
 // easy: 消したいEasyオブジェクトを指定する
 //
 void curl_base_multi::remove(const std::shared_ptr<curl_base_easy> &easy)
+{
+	if (!try_remove(easy)) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// 指定したEasyハンドルをMultiから登録解除する。例外を投げない版
+// easy: 消したいEasyオブジェクトを指定する。未登録のものは何もせず成功を返す
+// return: 結果
+curl_multi_result curl_base_multi::try_remove(const std::shared_ptr<curl_base_easy> &easy)
+{
+	return try_remove(easy->get_chandle());
+}
+
+// 登録解除処理の本体
+// h: 消したいEasyハンドル。未登録のものは何もせず成功を返す
+curl_multi_result curl_base_multi::try_remove(CURL *h)
 {
 	// 登録済みか見る。登録していないものは駄目
-	auto it = handles.find(easy->get_chandle());
+	auto it = handles.find(h);
 	if (it == this->handles.end()){
-		// 未登録ハンドル。例外は投げない
-		return;
+		// 未登録ハンドル。エラーにはしない
+		return curl_multi_result();
 	}
 	// 登録解除処理
 	const CURLMcode code = curl_multi_remove_handle(_multi.get(), it->first);
-	if (code == CURLM_OK) {
-		handles.erase(it->first);
-	} else {
+	if (code != CURLM_OK) {
 		set_error(code);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
+		return make_multi_result(code);
 	}
+	if (it->second.handler) handler_entries--;
+	handles.erase(it);
+	return curl_multi_result();
 }
 
 // メッセージ型を渡せるRemove。メッセージを受けてもう処理しない場合とかに適用できる
@@ -166,33 +234,31 @@ void curl_base_multi::remove(const std::shared_ptr<curl_base_easy> &easy)
 //      対応したEasyオブジェクトの登録を解除する
 void curl_base_multi::remove(const libcurlcxx::curl_base_multi_message &msg)
 {
-	// 登録済みか見る。登録していないものは駄目
-	auto it = handles.find(msg.get_easy()->get_chandle());
-	if (it == this->handles.end()){
-		// 未登録ハンドル。例外は投げない
-		return;
-	}
-	// 登録解除処理
-	const CURLMcode code = curl_multi_remove_handle(_multi.get(), it->first);
-	if (code == CURLM_OK) {
-		handles.erase(it->first);
-	} else {
-		set_error(code);
+	if (!try_remove(msg)) {
 		throw curl_base_exception(this, __FCNAME, __LINE__);
 	}
 }
 
+// メッセージ型を渡せるRemove。例外を投げない版
+// msg: get_next_message()で取得したメッセージを入れる。未登録のものは何もせず成功を返す
+// return: 結果
+curl_multi_result curl_base_multi::try_remove(const libcurlcxx::curl_base_multi_message &msg)
+{
+	return try_remove(msg.get_easy()->get_chandle());
+}
+
 // 登録済みのEasyハンドルをMultiからすべて登録解除する
 // 呼んだ段階でcurl_base_easyのオブジェクトがどこからも所有されていない場合は、この段階で適切に削除される
 // なので、使用には注意すること
 void curl_base_multi::clear()
 {
 	// ハンドルを順に探して登録解除
-	std::for_each(handles.begin(), handles.end(), [this](const std::pair<CURL*, std::shared_ptr<curl_base_easy>> &p) {
-		curl_multi_remove_handle(_multi.get(), p.second->get_chandle());
+	std::for_each(handles.begin(), handles.end(), [this](const std::pair<CURL* const, curl_base_multi_entry> &p) {
+		curl_multi_remove_handle(_multi.get(), p.first);
 	});
 	// マップも当然全消し
 	handles.clear();
+	handler_entries = 0;
 }
 
 
@@ -212,13 +278,68 @@ bool curl_base_multi::get_next_message(curl_base_multi_message &rmsg, int &msg_i
 	if (message->msg != CURLMSG_DONE) return false;		// 現状のCurlではCURLMSG_DONEしか意味がない
 
 	// 登録してあるはずなので、そのEasyクラスのポインタを返してメッセージを作る
-	auto it = handles.find(message->easy_handle);
-	if (it == this->handles.end()) return false;				// CURLのEASYハンドルとEasyオブジェクト結びついてない場合はおかしいので何もせず
+	const curl_base_multi_entry *entry = get_entry(message->easy_handle);
+	if (entry == nullptr) return false;				// CURLのEASYハンドルとEasyオブジェクト結びついてない場合はおかしいので何もせず
 
-	rmsg = curl_base_multi_message(message, it->second);		// 対応したメッセージを作って返す
+	rmsg = curl_base_multi_message(message, entry->easy);		// 対応したメッセージを作って返す
 	return true;
 }
 
+// Easyハンドルから登録時の情報を取り出す。CURLOPT_PRIVATEに入れてあるのでマップは引かない
+curl_base_multi_entry *curl_base_multi::get_entry(CURL *easy_handle) noexcept
+{
+	char *p = nullptr;
+	if (curl_easy_getinfo(easy_handle, CURLINFO_PRIVATE, &p) != CURLE_OK) return nullptr;
+	return reinterpret_cast<curl_base_multi_entry *>(p);
+}
+
+// 転送が終わったものを溜まっている分すべてまとめて取得する
+// get_next_messageを繰り返し呼ぶのと同じだが、メッセージごとのマップ検索やweak_ptrのlockをしない
+// 取得したものはmultiに登録されたままなので、必要ならremoveすること
+//
+// return: 転送が終わったものの並び。次にdrain_doneを呼ぶまで有効
+std::span<const curl_base_multi_done> curl_base_multi::drain_done()
+{
+	done_batch.clear();
+	int msgs_left = 0;
+	while (CURLMsg *message = curl_multi_info_read(_multi.get(), &msgs_left)) {
+		if (message->msg != CURLMSG_DONE) continue;		// 現状のCurlではCURLMSG_DONEしか意味がない
+		const curl_base_multi_entry *entry = get_entry(message->easy_handle);
+		if (entry == nullptr) continue;
+		done_batch.push_back(curl_base_multi_done{entry->easy.get(), message->data.result});
+	}
+	return done_batch;
+}
+
+// 転送が終わったもののハンドラを呼ぶ
+// ハンドラ付きでaddしたものは登録解除してからハンドラを呼ぶ。ハンドラの中でaddやremoveをしてもよい
+// ハンドラなしでaddしたものは何もせず登録されたままになる(メッセージは消費される)
+//
+// return: ハンドラを呼んだ数
+size_t curl_base_multi::dispatch_done()
+{
+	size_t count = 0;
+	int msgs_left = 0;
+	while (CURLMsg *message = curl_multi_info_read(_multi.get(), &msgs_left)) {
+		if (message->msg != CURLMSG_DONE) continue;
+		curl_base_multi_entry *entry = get_entry(message->easy_handle);
+		if (entry == nullptr || !entry->handler) continue;
+
+		// messageとentryは登録解除すると無効になるので先に取り出しておく
+		CURL *h = message->easy_handle;
+		const CURLcode code = message->data.result;
+		std::shared_ptr<curl_base_easy> easy = std::move(entry->easy);
+		curl_base_multi_done_handler handler = std::move(entry->handler);
+
+		curl_multi_remove_handle(_multi.get(), h);
+		handles.erase(h);
+		handler_entries--;
+		handler(easy, code);
+		count++;
+	}
+	return count;
+}
+
 // 取得処理の開始
 // easyと異なり、この関数を実行してもすぐに帰ってくる
 // 内部状況を更新するために、すべての受信が終わるまで定期的に呼ぶ必要がある
@@ -238,43 +359,159 @@ bool curl_base_multi::perform()
 	return true;
 }
 
+// 取得処理の開始。例外を投げない版
+// すでに取得処理を実行中(CURLM_CALL_MULTI_PERFORM)の場合はエラーではないので成功として返す
+// return: 結果
+curl_multi_result curl_base_multi::try_perform()
+{
+	const CURLMcode code = curl_multi_perform(_multi.get(), &active_transfers);
+	if (code == CURLM_CALL_MULTI_PERFORM) return curl_multi_result();
+	if (code != CURLM_OK) {
+		set_error(code);
+	}
+	return make_multi_result(code);
+}
+
 // 指定時間待つ関数
 void curl_base_multi::wait(struct curl_waitfd extra_fds[], const unsigned int extra_nfds, const int timeout_ms, int *numfds)
+{
+	if (!try_wait(extra_fds, extra_nfds, timeout_ms, numfds)) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// 指定時間待つ関数。例外を投げない版
+curl_multi_result curl_base_multi::try_wait(struct curl_waitfd extra_fds[], const unsigned int extra_nfds, const int timeout_ms, int *numfds)
 {
 	const CURLMcode code = curl_multi_wait(_multi.get(), extra_fds, extra_nfds, timeout_ms, numfds);
 	if (code != CURLM_OK) {
 		set_error(code);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
 	}
+	return make_multi_result(code);
 }
 
 // 指定時間待つ関数。waitと異なるのは別スレッドからwakeup()が呼ばれると復帰する
 void curl_base_multi::poll(struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms, int *numfds)
+{
+	if (!try_poll(extra_fds, extra_nfds, timeout_ms, numfds)) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// 指定時間待つ関数。例外を投げない版
+curl_multi_result curl_base_multi::try_poll(struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms, int *numfds)
 {
 	const CURLMcode code = curl_multi_poll(_multi.get(), extra_fds, extra_nfds, timeout_ms, numfds);
 	if (code != CURLM_OK) {
 		set_error(code);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
 	}
+	return make_multi_result(code);
 }
 
 // pollで待っているときに他のスレッドから呼び出すとpoll状態から抜ける
 // waitで待っている場合は全く影響を及ぼさないので注意
 void curl_base_multi::wakeup()
+{
+	if (!try_wakeup()) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// pollで待っているときに他のスレッドから呼び出すとpoll状態から抜ける。例外を投げない版
+// 待ち方を変える派生クラスはこちらをオーバライドする
+curl_multi_result curl_base_multi::try_wakeup()
 {
 	const CURLMcode code = curl_multi_wakeup(_multi.get());
 	if (code != CURLM_OK) {
 		set_error(code);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
 	}
+	return make_multi_result(code);
 }
 
 // perform後のタイムアウト値を設定
 void curl_base_multi::timeout(long *timeout)
+{
+	if (!try_timeout(timeout)) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// perform後のタイムアウト値を設定。例外を投げない版
+curl_multi_result curl_base_multi::try_timeout(long *timeout)
 {
 	const CURLMcode code = curl_multi_timeout(_multi.get(), timeout);
 	if (code != CURLM_OK) {
 		set_error(code);
+	}
+	return make_multi_result(code);
+}
+
+// ソケット単位で転送処理を進める(curl_multi_socket_action)
+// CURLMOPT_SOCKETFUNCTION/CURLMOPT_TIMERFUNCTIONを設定してイベント駆動で使う場合はperformではなくこちらを呼ぶ
+// performと異なり、準備ができたソケットの分だけ処理するので転送数が多くても負荷が増えない
+//
+// sockfd: 読み書き可能になったソケット。タイムアウト時はCURL_SOCKET_TIMEOUTを指定する
+// ev_bitmask: CURL_CSELECT_IN/CURL_CSELECT_OUT/CURL_CSELECT_ERRの組み合わせ。わからない場合は0でよい
+void curl_base_multi::socket_action(curl_socket_t sockfd, int ev_bitmask)
+{
+	if (!try_socket_action(sockfd, ev_bitmask)) {
 		throw curl_base_exception(this, __FCNAME, __LINE__);
 	}
 }
+
+// ソケット単位で転送処理を進める。例外を投げない版
+curl_multi_result curl_base_multi::try_socket_action(curl_socket_t sockfd, int ev_bitmask)
+{
+	const CURLMcode code = curl_multi_socket_action(_multi.get(), sockfd, ev_bitmask, &active_transfers);
+	if (code != CURLM_OK) {
+		set_error(code);
+	}
+	return make_multi_result(code);
+}
+
+// run/run_until_idleの1回分。次に何か起きるまで寝て待ってから転送を進める
+// 派生クラスで待ち方を変える場合はこれをオーバライドする
+// timeout_ms: 最大の待ち時間(ミリ秒)
+void curl_base_multi::run_step(int timeout_ms)
+{
+	// libcurlが次に処理をしたい時刻までpollで寝る。ビジーループにはしない
+	// addした直後はcurl_multi_timeoutが0を返すので待たずにperformする
+	long curl_timeout = -1;
+	timeout(&curl_timeout);
+	if (curl_timeout >= 0 && curl_timeout < timeout_ms) timeout_ms = static_cast<int>(curl_timeout);
+	if (timeout_ms > 0) poll(nullptr, 0, timeout_ms, nullptr);
+	perform();
+}
+
+// 転送中のものとハンドラ待ちのものがなくなるまで転送とハンドラの呼び出しを繰り返す
+// ハンドラ付きでaddしたものはここでハンドラが呼ばれる。ハンドラの中でaddしたものも終わるまで待つ
+//
+// なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
+void curl_base_multi::run_until_idle()
+{
+	if (handles.empty()) return;
+	do {
+		run_step(CURLCXX_MULTI_RUN_WAIT_MS);
+		dispatch_done();
+	} while (active_transfers > 0 || handler_entries > 0);
+}
+
+// stopが呼ばれるまで転送とハンドラの呼び出しを繰り返す
+// 転送がない間は寝て待つので、別スレッドからaddする場合はaddの後にwakeupを呼ぶこと
+//
+// なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
+void curl_base_multi::run()
+{
+	// stopが呼ばれたら一度だけ抜ける
+	while (!stop_requested.exchange(false)) {
+		run_step(CURLCXX_MULTI_RUN_WAIT_MS);
+		dispatch_done();
+	}
+}
+
+// runから抜けるようにする。ハンドラの中からでも、別のスレッドからでも呼んでよい
+void curl_base_multi::stop()
+{
+	stop_requested = true;
+	wakeup();
+}
@@ -0,0 +1,233 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+#include <cstdint>
+
+#include "curlcxx_error.h"
+#include "curlcxx_multi_epoll.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_base_multi_epoll;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_multi_result;
+
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+// epoll_waitで一度に受け取るイベント数
+#define CURLCXX_EPOLL_MAXEVENTS		(256)
+
+// -----------------------------------------------------------------------
+// curl_base_multi_epoll: curl_base_multiをepollで駆動するもの
+//
+// 使い方は以下の通り
+//
+// 1. curl_base_multi_epollを作る
+// 2. curl_base_multiと同じようにaddでEasyオブジェクトを登録
+// 3. run_onceをget_active_transfers()が0になるまで繰り返し呼ぶ
+//    run_onceはソケットの準備ができるかタイムアウトするまでブロッキングするので、ビジーループにはならない
+// 4. 転送が終わったものはget_next_messageで取得する
+//
+// see also:
+// https://curl.se/libcurl/c/curl_multi_socket_action.html
+// https://curl.se/libcurl/c/ephiperfifo.html
+//
+
+// コンストラクタ
+curl_base_multi_epoll::curl_base_multi_epoll() : curl_base_multi()
+{
+	timer_active = false;
+	events.resize(CURLCXX_EPOLL_MAXEVENTS);
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(epoll_fd < 0){
+		throw curl_base_exception("error: epoll_create1", __FCNAME, __LINE__);
+	}
+	wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(wakeup_fd < 0){
+		::close(epoll_fd);
+		throw curl_base_exception("error: eventfd", __FCNAME, __LINE__);
+	}
+	// wakeup用のeventfdも一緒に監視する
+	struct epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.fd = wakeup_fd;
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev) != 0){
+		::close(wakeup_fd);
+		::close(epoll_fd);
+		throw curl_base_exception("error: epoll_ctl", __FCNAME, __LINE__);
+	}
+
+	set_option(CURLMOPT_SOCKETFUNCTION, _socket_callback_func);
+	set_option(CURLMOPT_SOCKETDATA, static_cast<void *>(this));
+	set_option(CURLMOPT_TIMERFUNCTION, _timer_callback_func);
+	set_option(CURLMOPT_TIMERDATA, static_cast<void *>(this));
+}
+
+// デストラクタ
+curl_base_multi_epoll::~curl_base_multi_epoll() noexcept
+{
+	// 基底クラスのデストラクタでハンドルを外すとその際にコールバックが呼ばれてしまうので、ここで先に外しておく
+	clear();
+	set_option(CURLMOPT_SOCKETFUNCTION, static_cast<curl_socket_callback>(nullptr));
+	set_option(CURLMOPT_TIMERFUNCTION, static_cast<curl_multi_timer_callback>(nullptr));
+	::close(wakeup_fd);
+	::close(epoll_fd);
+}
+
+// libcurlから呼ばれるソケット監視のエントリポイント
+int curl_base_multi_epoll::_socket_callback_func(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp)
+{
+	(void)easy;		// warning避け
+	if(userp == nullptr) return 0;
+	return static_cast<curl_base_multi_epoll*>(userp)->internal_socket_callback(s, what, socketp);
+}
+
+// ソケットの監視内容が変わるたびに呼ばれる
+// what: CURL_POLL_IN/CURL_POLL_OUT/CURL_POLL_INOUT/CURL_POLL_REMOVE
+// socketp: curl_multi_assignで設定した値。nullptrならまだepollに登録していない
+int curl_base_multi_epoll::internal_socket_callback(curl_socket_t s, int what, void *socketp)
+{
+	if(what == CURL_POLL_REMOVE){
+		// ソケットはすでに閉じられている場合もあるので失敗は無視してよい
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s, nullptr);
+		return 0;
+	}
+
+	struct epoll_event ev = {};
+	ev.data.fd = s;
+	if(what & CURL_POLL_IN)		ev.events |= EPOLLIN;
+	if(what & CURL_POLL_OUT)	ev.events |= EPOLLOUT;
+
+	int op = (socketp == nullptr) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+	if(epoll_ctl(epoll_fd, op, s, &ev) != 0){
+		// 同じディスクリプタ番号が再利用された場合などはADDとMODを入れ替えてやり直す
+		if(errno == EEXIST)			op = EPOLL_CTL_MOD;
+		else if(errno == ENOENT)	op = EPOLL_CTL_ADD;
+		else						return -1;
+		if(epoll_ctl(epoll_fd, op, s, &ev) != 0) return -1;
+	}
+	// 登録済みの印をつけておく。次回からはMODになる
+	if(socketp == nullptr){
+		curl_multi_assign(_multi.get(), s, this);
+	}
+	return 0;
+}
+
+// libcurlから呼ばれるタイマー設定のエントリポイント
+int curl_base_multi_epoll::_timer_callback_func(CURLM *multi, long timeout_ms, void *userp)
+{
+	(void)multi;		// warning避け
+	if(userp == nullptr) return 0;
+	return static_cast<curl_base_multi_epoll*>(userp)->internal_timer_callback(timeout_ms);
+}
+
+// libcurlがタイムアウト処理を要求するたびに呼ばれる
+// ここではsocket_actionを呼ばず、期限だけを覚えておいてrun_onceで処理する
+// timeout_ms: -1ならタイマーの削除。0ならすぐにタイムアウト処理をする必要がある
+int curl_base_multi_epoll::internal_timer_callback(long timeout_ms)
+{
+	if(timeout_ms < 0){
+		timer_active = false;
+		return 0;
+	}
+	timer_active = true;
+	timer_deadline = steady_clock::now() + milliseconds(timeout_ms);
+	return 0;
+}
+
+// epoll_waitで待つ時間を計算する
+// timeout_ms: 呼び出し元が指定した最大待ち時間。-1なら無制限
+int curl_base_multi_epoll::next_timeout(int timeout_ms) const
+{
+	if(!timer_active) return timeout_ms;
+
+	const auto remain = std::chrono::ceil<milliseconds>(timer_deadline - steady_clock::now()).count();
+	const int timer_ms = (remain > 0) ? static_cast<int>(remain) : 0;
+	if(timeout_ms < 0) return timer_ms;
+	return std::min(timeout_ms, timer_ms);
+}
+
+// wakeup用eventfdに溜まったものを読み捨てる
+void curl_base_multi_epoll::drain_wakeup()
+{
+	uint64_t value;
+	while(::read(wakeup_fd, &value, sizeof(value)) > 0){}
+}
+
+// 準備ができたソケットかタイムアウトを待って転送処理を進める
+// ソケットの準備ができるか、libcurlの要求するタイムアウトかtimeout_msが経過するまでブロッキングする
+// 別スレッドからwakeup()が呼ばれた場合もすぐに戻ってくる
+//
+// なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
+// timeout_ms: 最大の待ち時間(ミリ秒)。-1ならlibcurlのタイマーかソケットの準備ができるまで待つ
+// return: 処理したイベントの数。0ならタイムアウトした
+int curl_base_multi_epoll::run_once(int timeout_ms)
+{
+	const int nfds = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), next_timeout(timeout_ms));
+	if(nfds < 0 && errno != EINTR){
+		throw curl_base_exception("error: epoll_wait", __FCNAME, __LINE__);
+	}
+
+	for(int i = 0; i < nfds; i++){
+		const int fd = events[i].data.fd;
+		if(fd == wakeup_fd){
+			drain_wakeup();
+			continue;
+		}
+		int ev_bitmask = 0;
+		if(events[i].events & EPOLLIN)					ev_bitmask |= CURL_CSELECT_IN;
+		if(events[i].events & EPOLLOUT)					ev_bitmask |= CURL_CSELECT_OUT;
+		if(events[i].events & (EPOLLERR | EPOLLHUP))	ev_bitmask |= CURL_CSELECT_ERR;
+		socket_action(fd, ev_bitmask);
+	}
+	// タイマーが満了していたらlibcurlに知らせる
+	if(timer_active && steady_clock::now() >= timer_deadline){
+		timer_active = false;
+		socket_action(CURL_SOCKET_TIMEOUT, 0);
+	}
+	return (nfds > 0) ? nfds : 0;
+}
+
+// run/run_until_idleの1回分。perform/pollの代わりにrun_onceで待つ
+void curl_base_multi_epoll::run_step(int timeout_ms)
+{
+	run_once(timeout_ms);
+}
+
+// run_onceで待っているときに他のスレッドから呼び出すとrun_onceから抜ける
+// wakeup()もこれを呼ぶ
+curl_multi_result curl_base_multi_epoll::try_wakeup()
+{
+	const uint64_t value = 1;
+	if(::write(wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN){
+		error_code = CURLM_INTERNAL_ERROR;
+		error_str = "error: eventfd write";
+		return curl_multi_result(CURLM_INTERNAL_ERROR, "error: eventfd write");
+	}
+	return curl_multi_result();
+}
@@ -0,0 +1,222 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CURLCXX_NDJSON_X86
+#endif
+
+#include "curlcxx_ndjson_stream.h"
+
+using libcurlcxx::curl_base_ndjson_stream;
+using libcurlcxx::writef::_check_callback_arg;
+
+namespace
+{
+	// 改行を探す実装の種類
+	enum class newline_kernel
+	{
+		memchr,
+		sse2,
+		avx2,
+	};
+
+	// [p, end)の改行ごとにon_line(レコードの先頭, 改行の位置)を呼ぶ
+	// return: 改行で終わっていない残りの先頭。on_lineがfalseを返した場合はnullptr
+
+	// SIMDが使えない環境用。libcのmemchrに任せる
+	template<class F> const char *split_memchr(const char *p, const char *end, F &&on_line)
+	{
+		const char *rec = p;
+		while(const void *r = std::memchr(p, '\n', end - p)){
+			const char *nl = static_cast<const char *>(r);
+			if(!on_line(rec, nl)) return nullptr;
+			rec = p = nl + 1;
+		}
+		return rec;
+	}
+
+	// 64バイト分のマスクのビットを下から順にたどる
+	template<class F> inline bool _walk_mask(const char *q, uint64_t mask, const char *&rec, F &&on_line)
+	{
+		while(mask != 0){
+			const char *nl = q + __builtin_ctzll(mask);
+			if(!on_line(rec, nl)) return false;
+			rec = nl + 1;
+			mask &= mask - 1;
+		}
+		return true;
+	}
+
+	// 64バイトに満たない最後の部分
+	template<class F> inline const char *_split_rest(const char *q, const char *end, const char *rec, F &&on_line)
+	{
+		for(; q < end; q++){
+			if(*q != '\n') continue;
+			if(!on_line(rec, q)) return nullptr;
+			rec = q + 1;
+		}
+		return rec;
+	}
+
+#ifdef CURLCXX_NDJSON_X86
+	// 16バイトずつ4回比較して、64バイト分の改行の位置を1つのマスクにまとめる
+	template<class F> const char *split_sse2(const char *p, const char *end, F &&on_line)
+	{
+		const __m128i nl = _mm_set1_epi8('\n');
+		const char *rec = p;
+		const char *q = p;
+		for(; end - q >= 64; q += 64){
+			uint64_t mask = 0;
+			for(int i = 0; i < 4; i++){
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + i * 16));
+				mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)))) << (i * 16);
+			}
+			if(!_walk_mask(q, mask, rec, on_line)) return nullptr;
+		}
+		return _split_rest(q, end, rec, on_line);
+	}
+
+	// 32バイトずつ2回比較して、64バイト分の改行の位置を1つのマスクにまとめる
+	template<class F> __attribute__((target("avx2")))
+	const char *split_avx2(const char *p, const char *end, F &&on_line)
+	{
+		const __m256i nl = _mm256_set1_epi8('\n');
+		const char *rec = p;
+		const char *q = p;
+		for(; end - q >= 64; q += 64){
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(q));
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(q + 32));
+			const uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, nl)))
+								| (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, nl)))) << 32);
+			if(!_walk_mask(q, mask, rec, on_line)) return nullptr;
+		}
+		return _split_rest(q, end, rec, on_line);
+	}
+#endif
+
+	// 起動時に一度だけCPUを調べて実装を選ぶ
+	newline_kernel select_kernel() noexcept
+	{
+#ifdef CURLCXX_NDJSON_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))	return newline_kernel::avx2;
+		if(__builtin_cpu_supports("sse2"))	return newline_kernel::sse2;
+#endif
+		return newline_kernel::memchr;
+	}
+	const newline_kernel _kernel = select_kernel();
+}  // namespace
+
+// -----------------------------------------------------------------------
+// curl_base_ndjson_stream : 改行区切りのJSONをレコードごとに切り出すストリーム
+
+// コンストラクタ
+// func: レコードが1つ揃うたびに呼ばれる関数
+curl_base_ndjson_stream::curl_base_ndjson_stream(record_callback func)
+	: callback(std::move(func)), record_count(0)
+{
+	set_write_callback(_callback_func);
+}
+
+// 改行を探すのに使われている実装の名前を返す
+const char *curl_base_ndjson_stream::get_kernel_name() noexcept
+{
+	switch(_kernel){
+	case newline_kernel::avx2:	return "avx2";
+	case newline_kernel::sse2:	return "sse2";
+	default:					return "memchr";
+	}
+}
+
+// 1レコードをコールバック関数に渡す
+bool curl_base_ndjson_stream::emit(std::string_view record)
+{
+	if(!record.empty() && record.back() == '\r') record.remove_suffix(1);
+	if(record.empty()) return true;
+	record_count++;
+	return callback ? callback(record) : true;
+}
+
+// 改行で終わっていない最後のレコードがあればコールバック関数に渡す
+// perform()が終わったあとに呼ぶこと
+// return: コールバック関数の戻り値。渡すものがなければtrue
+bool curl_base_ndjson_stream::flush()
+{
+	if(tail.empty()) return true;
+	const bool ret = emit(tail);
+	tail.clear();
+	return ret;
+}
+
+// 途中のレコードを捨てる。同じストリームで別のリクエストをする前に呼ぶ
+void curl_base_ndjson_stream::clear() noexcept
+{
+	tail.clear();
+}
+
+// 改行が見つかるたびに呼ばれる
+// rec: レコードの先頭  nl: 見つかった'\n'の位置
+// チャンクの最初のレコードだけは、前のチャンクから続いている場合がある
+bool curl_base_ndjson_stream::on_newline(const char *rec, const char *nl)
+{
+	if(tail.empty()) return emit(std::string_view(rec, nl - rec));
+	// clearは容量を残すので、次にまたいだときも確保し直さない
+	tail.append(rec, nl - rec);
+	const bool ret = emit(tail);
+	tail.clear();
+	return ret;
+}
+
+// 受信したデータをレコードに分ける
+size_t curl_base_ndjson_stream::internal_write(char *buffer, size_t realsize)
+{
+	const char *const end = buffer + realsize;
+	auto on_line = [this](const char *rec, const char *nl) { return on_newline(rec, nl); };
+
+	const char *rest;
+	switch(_kernel){
+#ifdef CURLCXX_NDJSON_X86
+	case newline_kernel::avx2:	rest = split_avx2(buffer, end, on_line);	break;
+	case newline_kernel::sse2:	rest = split_sse2(buffer, end, on_line);	break;
+#endif
+	default:					rest = split_memchr(buffer, end, on_line);	break;
+	}
+	if(rest == nullptr) return 0;
+
+	// レコードの途中でチャンクが終わった
+	tail.append(rest, end - rest);
+	return realsize;
+}
+
+// 何かサーバからデータが来るとこれがCurlから呼ばれる
+size_t curl_base_ndjson_stream::_callback_func(char *buffer, size_t size, size_t nitems, void *outstream)
+{
+	auto realsize = _check_callback_arg(buffer, size, nitems);
+	if(realsize == 0) return 0;
+	return static_cast<curl_base_ndjson_stream*>(outstream)->internal_write(buffer, realsize);
+}
@@ -0,0 +1,133 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "curlcxx_share.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_base_share;
+using libcurlcxx::curl_base_exception;
+
+// -----------------------------------------------------------------------
+// curl_base_share: curl_share をC++で実装したもの
+// 複数のEasyハンドルの間で接続キャッシュ・DNSキャッシュ・TLSセッションを共有する
+// shareハンドルを生で使用せずスマートポインタで包み、可能な限り生ポインタを使わないことによって安全に使用することを念頭においている
+//
+// see also:
+// https://curl.se/libcurl/c/libcurl-share.html
+//
+
+// コンストラクタ
+// share_default: trueならDNSキャッシュとTLSセッションを共有する設定にする
+//                falseなら何も共有しないので、shareで個別に設定すること
+// 接続キャッシュ(CURL_LOCK_DATA_CONNECT)はlibcurlの制限で、別々のスレッドで同時にperformするハンドル間では
+// 安全に共有できないため、デフォルトでは共有しない。1つのスレッドで順番に使う場合はshareで追加すること
+curl_base_share::curl_base_share(bool share_default)
+{
+	CURLSH *p = curl_share_init();
+	if(p == nullptr){
+		throw curl_base_exception("handle return null", __FCNAME, __LINE__);
+	}
+	handle.reset(p);
+
+	curl_share_setopt(p, CURLSHOPT_LOCKFUNC, _lock_callback_func);
+	curl_share_setopt(p, CURLSHOPT_UNLOCKFUNC, _unlock_callback_func);
+	curl_share_setopt(p, CURLSHOPT_USERDATA, this);
+
+	if(share_default){
+		share(CURL_LOCK_DATA_DNS);
+		share(CURL_LOCK_DATA_SSL_SESSION);
+	}
+}
+
+// デストラクタ
+// set_shareしたEasyオブジェクトはこのオブジェクトへの参照を持っているので、
+// ここに来るときにはどのEasyハンドルからも使われていない
+curl_base_share::~curl_base_share()
+{}
+
+// 指定したデータを共有するようにする
+// data: 共有するデータの種類。CURL_LOCK_DATA_DNS, CURL_LOCK_DATA_SSL_SESSION, CURL_LOCK_DATA_CONNECTなど
+// return:
+//   true : 設定成功
+//   false : 設定失敗(そのlibcurlが対応していないなど)。原因はget_errorstrで取得できる
+bool curl_base_share::share(curl_lock_data data)
+{
+	CURLSHcode ret = set_option(CURLSHOPT_SHARE, static_cast<long>(data));
+	if(ret != CURLSHE_OK){
+		set_error(ret);
+		return false;
+	}
+	return true;
+}
+
+// 指定したデータを共有しないようにする
+// data: 共有をやめるデータの種類
+bool curl_base_share::unshare(curl_lock_data data)
+{
+	CURLSHcode ret = set_option(CURLSHOPT_UNSHARE, static_cast<long>(data));
+	if(ret != CURLSHE_OK){
+		set_error(ret);
+		return false;
+	}
+	return true;
+}
+
+// エラーのセット。このクラスの中及び派生クラスでのみ使用
+// curl_code: CURLSHcode
+void curl_base_share::set_error(const int curl_code) noexcept
+{
+	error_code = curl_code;
+	error_str = curl_share_strerror((CURLSHcode)curl_code);
+}
+
+// libcurlから呼ばれるlockのエントリポイント
+// 読み込みだけのアクセス(CURL_LOCK_ACCESS_SHARED)なら共有ロック、それ以外は排他ロックを取る
+// unlockのコールバックにはcurl_lock_accessが渡されないので、排他ロックで取ったことをこのshareの中に覚えておく
+void curl_base_share::_lock_callback_func(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+	if(data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+	curl_base_share *p = static_cast<curl_base_share *>(userptr);
+	if(access == CURL_LOCK_ACCESS_SHARED){
+		p->locks[data].lock_shared();
+	}else{
+		p->locks[data].lock();
+		p->locked_exclusive[data] = true;
+	}
+}
+
+// libcurlから呼ばれるunlockのエントリポイント
+// 排他ロック中は他のスレッドがそのデータのロックを持てないので、locked_exclusiveが立っていれば自分が排他ロックで取ったものである
+void curl_base_share::_unlock_callback_func(CURL *handle, curl_lock_data data, void *userptr)
+{
+	if(data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+	curl_base_share *p = static_cast<curl_base_share *>(userptr);
+	if(p->locked_exclusive[data]){
+		p->locked_exclusive[data] = false;
+		p->locks[data].unlock();
+	}else{
+		p->locks[data].unlock_shared();
+	}
+}
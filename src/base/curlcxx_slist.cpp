@@ -27,6 +27,7 @@
 #include "classfname.h"
 
 using libcurlcxx::curl_base_slist;
+using libcurlcxx::curl_base_header_set;
 using libcurlcxx::curl_base_exception;
 
 using std::string_view;
@@ -84,3 +85,60 @@ void curl_base_slist::reset()
 {
 	_slist.reset();
 }
+
+// リストの最後のノードを返す。空ならnullptr
+// 共有のヘッダセットを後ろにつなぐためのもの
+curl_slist* curl_base_slist::get_lastptr() noexcept
+{
+	curl_slist *p = _slist.get();
+	if(p == nullptr) return nullptr;
+	while(p->next != nullptr) p = p->next;
+	return p;
+}
+
+// ----------------------------------------
+// curl_base_header_set: 複数のリクエストで共有する、変更できないヘッダのセット
+
+// コンストラクタ
+// lines: "Name: value"の形のヘッダ
+curl_base_header_set::curl_base_header_set(std::initializer_list<std::string_view> lines)
+	: head(nullptr), count(0)
+{
+	build(lines.begin(), lines.size());
+}
+
+// コンストラクタ
+// lines: "Name: value"の形のヘッダ
+curl_base_header_set::curl_base_header_set(const std::vector<std::string> &lines)
+	: head(nullptr), count(0)
+{
+	std::vector<std::string_view> views(lines.begin(), lines.end());
+	build(views.data(), views.size());
+}
+
+// 初期化リストから作ったヘッダセットを返す
+std::shared_ptr<const curl_base_header_set> curl_base_header_set::create(std::initializer_list<std::string_view> lines)
+{
+	return std::make_shared<const curl_base_header_set>(lines);
+}
+
+// 文字列を1つの領域に詰め、ノードの配列をつないでリストにする
+void curl_base_header_set::build(const std::string_view *lines, size_t n)
+{
+	if(n == 0) return;
+	size_t total = 0;
+	for(size_t i = 0; i < n; i++) total += lines[i].size() + 1;
+
+	arena = std::make_unique_for_overwrite<char[]>(total);
+	nodes = std::make_unique<curl_slist[]>(n);
+	char *p = arena.get();
+	for(size_t i = 0; i < n; i++){
+		std::copy(lines[i].begin(), lines[i].end(), p);
+		p[lines[i].size()] = '\0';
+		nodes[i].data = p;
+		nodes[i].next = (i + 1 < n) ? &nodes[i + 1] : nullptr;
+		p += lines[i].size() + 1;
+	}
+	head = nodes.get();
+	count = n;
+}
@@ -0,0 +1,170 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <charconv>
+
+#include "curlcxx_sse_stream.h"
+
+using libcurlcxx::curl_base_sse_stream;
+using libcurlcxx::curl_base_sse_event;
+using libcurlcxx::writef::_check_callback_arg;
+
+// -----------------------------------------------------------------------
+// curl_base_sse_stream : Server-Sent Eventsを受信しながら解析するストリーム
+
+// コンストラクタ
+// func: イベントが1つ揃うたびに呼ばれる関数
+curl_base_sse_stream::curl_base_sse_stream(event_callback func)
+	: callback(std::move(func)), retry(-1), event_count(0), pending_cr(false), first_line(true)
+{
+	set_write_callback(_callback_func);
+}
+
+// つなぎ直す前に、途中まで受信していた行やイベントを捨てる
+// 最後のイベントIDとretryは残す
+void curl_base_sse_stream::reset() noexcept
+{
+	line.clear();
+	data.clear();
+	event_type.clear();
+	id_buffer = last_event_id;
+	pending_cr = false;
+	first_line = true;
+}
+
+// つなぎ直すときに追加するヘッダを返す
+// return: "Last-Event-ID: <id>"。まだIDを受け取っていなければ空
+std::string curl_base_sse_stream::get_resume_header() const
+{
+	if(last_event_id.empty()) return std::string();
+	return "Last-Event-ID: " + last_event_id;
+}
+
+// 揃ったイベントをコールバック関数に渡す(空行が来たときに呼ばれる)
+bool curl_base_sse_stream::dispatch()
+{
+	last_event_id = id_buffer;
+	// dataがないイベントは捨てる
+	if(data.empty()){
+		event_type.clear();
+		return true;
+	}
+	data.pop_back();		// 最後の'\n'は含めない
+
+	curl_base_sse_event ev;
+	ev.event = event_type.empty() ? std::string_view("message") : std::string_view(event_type);
+	ev.data = data;
+	ev.id = last_event_id;
+	event_count++;
+	const bool ret = callback ? callback(ev) : true;
+
+	// clearは容量を残すので、次のイベントで確保し直さない
+	data.clear();
+	event_type.clear();
+	return ret;
+}
+
+// 1行を解釈する
+// l: 行末の改行を含まない1行
+bool curl_base_sse_stream::process_line(std::string_view l)
+{
+	if(first_line){
+		first_line = false;
+		if(l.starts_with("\xEF\xBB\xBF")) l.remove_prefix(3);
+	}
+	if(l.empty()) return dispatch();
+	if(l[0] == ':') return true;				// コメント
+
+	std::string_view field = l;
+	std::string_view value;
+	const auto colon = l.find(':');
+	if(colon != std::string_view::npos){
+		field = l.substr(0, colon);
+		value = l.substr(colon + 1);
+		if(!value.empty() && value[0] == ' ') value.remove_prefix(1);
+	}
+
+	if(field == "data"){
+		data.append(value);
+		data.push_back('\n');
+	}else if(field == "event"){
+		event_type.assign(value);
+	}else if(field == "id"){
+		if(value.find('\0') == std::string_view::npos) id_buffer.assign(value);
+	}else if(field == "retry"){
+		long ms;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), ms);
+		if(!value.empty() && ec == std::errc() && ptr == value.data() + value.size() && value[0] != '-') retry = ms;
+	}
+	// それ以外のフィールドは無視する
+	return true;
+}
+
+// 受信したデータを行に分けて解釈する
+// チャンク内で完結している行は受信バッファを直接見て、境目をまたいだ行だけをlineに貯める
+size_t curl_base_sse_stream::internal_write(char *buffer, size_t realsize)
+{
+	const char *p = buffer;
+	const char *const end = buffer + realsize;
+
+	// 前のチャンクがCRで終わっていた場合、CRLFのLFがこちらに来ている
+	if(pending_cr){
+		pending_cr = false;
+		if(*p == '\n') p++;
+	}
+	while(p < end){
+		const char *eol = p;
+		while(eol < end && *eol != '\n' && *eol != '\r') eol++;
+		if(eol == end){
+			// 行の途中でチャンクが終わった
+			line.append(p, end - p);
+			break;
+		}
+
+		bool ok;
+		if(line.empty()){
+			ok = process_line(std::string_view(p, eol - p));
+		}else{
+			line.append(p, eol - p);
+			ok = process_line(line);
+			line.clear();
+		}
+		if(!ok) return 0;
+
+		if(*eol == '\r'){
+			if(eol + 1 == end)			pending_cr = true;
+			else if(eol[1] == '\n')		eol++;
+		}
+		p = eol + 1;
+	}
+	return realsize;
+}
+
+// 何かサーバからデータが来るとこれがCurlから呼ばれる
+size_t curl_base_sse_stream::_callback_func(char *buffer, size_t size, size_t nitems, void *outstream)
+{
+	auto realsize = _check_callback_arg(buffer, size, nitems);
+	if(realsize == 0) return 0;
+	return static_cast<curl_base_sse_stream*>(outstream)->internal_write(buffer, realsize);
+}
@@ -0,0 +1,252 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+
+#include "curlcxx_upload.h"
+
+using libcurlcxx::curl_base_iovec_upload;
+using libcurlcxx::curl_base_generator_upload;
+using libcurlcxx::curl_base_chunked_upload;
+
+// -----------------------------------------------------------------------
+// curl_base_iovec_upload : 複数のバッファを順に並べて1つのbodyとして送る
+
+// コンストラクタ
+curl_base_iovec_upload::curl_base_iovec_upload()
+	: total(0), index(0), offset(0)
+{
+	set_read_callback(_read_func);
+	set_seek_callback(_seek_func);
+}
+
+// バッファを末尾に追加する。コピーしないのでperformが終わるまで保持すること
+// data: 送るデータへのポインタ
+// size: バイト数
+void curl_base_iovec_upload::append(const void *data, size_t size)
+{
+	if(size == 0) return;
+	segments.push_back({static_cast<const char *>(data), size});
+	total += size;
+}
+
+// バッファを末尾に追加する。コピーしないのでperformが終わるまで保持すること
+void curl_base_iovec_upload::append(std::string_view data)
+{
+	append(data.data(), data.size());
+}
+
+// 文字列を引き取って末尾に追加する
+void curl_base_iovec_upload::append(std::string &&data)
+{
+	if(data.empty()) return;
+	owned.push_back(std::move(data));
+	append(owned.back().data(), owned.back().size());
+}
+
+// 追加したバッファを全部取り除く
+void curl_base_iovec_upload::clear() noexcept
+{
+	segments.clear();
+	owned.clear();
+	total = 0;
+	index = 0;
+	offset = 0;
+}
+
+// バッファを順にbufferへ詰める
+size_t curl_base_iovec_upload::internal_read(char *buffer, size_t realsize)
+{
+	size_t done = 0;
+	while(done < realsize && index < segments.size()){
+		const segment &seg = segments[index];
+		const size_t n = std::min(realsize - done, seg.size - offset);
+		std::memcpy(buffer + done, seg.data + offset, n);
+		done += n;
+		offset += n;
+		if(offset == seg.size){
+			index++;
+			offset = 0;
+		}
+	}
+	return done;
+}
+
+// 読み出し位置を先頭からposバイト目にする
+bool curl_base_iovec_upload::internal_seek(curl_off_t pos)
+{
+	if(pos < 0 || pos > static_cast<curl_off_t>(total)) return false;
+	size_t left = static_cast<size_t>(pos);
+	index = 0;
+	offset = 0;
+	while(index < segments.size() && left >= segments[index].size){
+		left -= segments[index].size;
+		index++;
+	}
+	offset = left;
+	return true;
+}
+
+// 送るデータが必要になるとこれがCurlから呼ばれる
+size_t curl_base_iovec_upload::_read_func(char *buffer, size_t size, size_t nitems, void *instream)
+{
+	return static_cast<curl_base_iovec_upload*>(instream)->internal_read(buffer, size * nitems);
+}
+
+// 送り直すときなどにこれがCurlから呼ばれる
+int curl_base_iovec_upload::_seek_func(void *instream, curl_off_t offset, int origin)
+{
+	auto self = static_cast<curl_base_iovec_upload*>(instream);
+	curl_off_t base = 0;
+	if(origin == SEEK_END){
+		base = static_cast<curl_off_t>(self->total);
+	}else if(origin == SEEK_CUR){
+		for(size_t i = 0; i < self->index; i++) base += static_cast<curl_off_t>(self->segments[i].size);
+		base += static_cast<curl_off_t>(self->offset);
+	}
+	return self->internal_seek(base + offset) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
+// -----------------------------------------------------------------------
+// curl_base_generator_upload : 送るデータを関数で少しずつ作って渡す
+
+// コンストラクタ
+// gen: データを作る関数。bufferに最大sizeバイト書き込み、書いたバイト数を返す。終わりなら0、エラーならCURL_READFUNC_ABORT
+// _size: 全体のバイト数。分からない場合は-1
+// _rewind: 最初から作り直す関数。送り直しが必要になったときに呼ばれる。成功したらtrueを返すこと
+curl_base_generator_upload::curl_base_generator_upload(generator_func gen, curl_off_t _size, rewind_func _rewind)
+	: generator(std::move(gen)), rewinder(std::move(_rewind)), size(_size)
+{
+	set_read_callback(_read_func);
+	set_seek_callback(_seek_func);
+}
+
+// 送るデータが必要になるとこれがCurlから呼ばれる
+size_t curl_base_generator_upload::_read_func(char *buffer, size_t size, size_t nitems, void *instream)
+{
+	auto self = static_cast<curl_base_generator_upload*>(instream);
+	// 例外はlibcurlの中を通せないのでここで止める
+	try{
+		return self->generator(buffer, size * nitems);
+	}catch(...){
+		return CURL_READFUNC_ABORT;
+	}
+}
+
+// easyに設定されたときに呼ばれる。rewinderがあれば最初から作り直し、同じオブジェクトで何度も送れるようにする
+// rewinderがない場合は何もしないので、続きから作ることになる
+void curl_base_generator_upload::rewind()
+{
+	if(rewinder) rewinder();
+}
+
+// 送り直すときなどにこれがCurlから呼ばれる。先頭に戻す場合だけ対応する
+int curl_base_generator_upload::_seek_func(void *instream, curl_off_t offset, int origin)
+{
+	auto self = static_cast<curl_base_generator_upload*>(instream);
+	if(!self->rewinder || offset != 0 || origin != SEEK_SET) return CURL_SEEKFUNC_CANTSEEK;
+	try{
+		return self->rewinder() ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+	}catch(...){
+		return CURL_SEEKFUNC_FAIL;
+	}
+}
+
+// -----------------------------------------------------------------------
+// curl_base_chunked_upload : 長さの分からないデータを届いた分だけ送る
+
+// コンストラクタ
+curl_base_chunked_upload::curl_base_chunked_upload()
+	: front_offset(0), finished(false), aborted(false)
+{
+	set_read_callback(_read_func);
+}
+
+// 送るデータを積む。どのスレッドから呼んでもよい
+void curl_base_chunked_upload::push(std::string_view data)
+{
+	push(std::string(data));
+}
+
+// 送るデータを引き取って積む。どのスレッドから呼んでもよい
+void curl_base_chunked_upload::push(std::string &&data)
+{
+	if(data.empty()) return;
+	{
+		std::lock_guard<std::mutex> lock(lk);
+		queue.push_back(std::move(data));
+	}
+	cv.notify_one();
+}
+
+// もう送るデータがないことを伝える。積んだ分を送り終わると転送が終わる
+void curl_base_chunked_upload::finish()
+{
+	{
+		std::lock_guard<std::mutex> lock(lk);
+		finished = true;
+	}
+	cv.notify_one();
+}
+
+// 転送を中断する。performはCURLE_ABORTED_BY_CALLBACKで失敗する
+void curl_base_chunked_upload::abort()
+{
+	{
+		std::lock_guard<std::mutex> lock(lk);
+		aborted = true;
+	}
+	cv.notify_one();
+}
+
+// データが積まれるまで待ってからbufferへ詰める
+size_t curl_base_chunked_upload::internal_read(char *buffer, size_t realsize)
+{
+	std::unique_lock<std::mutex> lock(lk);
+	cv.wait(lock, [this]{ return aborted || finished || !queue.empty(); });
+	if(aborted) return CURL_READFUNC_ABORT;
+
+	size_t done = 0;
+	while(done < realsize && !queue.empty()){
+		const std::string &front = queue.front();
+		const size_t n = std::min(realsize - done, front.size() - front_offset);
+		std::memcpy(buffer + done, front.data() + front_offset, n);
+		done += n;
+		front_offset += n;
+		if(front_offset == front.size()){
+			queue.pop_front();
+			front_offset = 0;
+		}
+	}
+	// finishされていて積まれたものがなければ0を返して終わり
+	return done;
+}
+
+// 送るデータが必要になるとこれがCurlから呼ばれる
+size_t curl_base_chunked_upload::_read_func(char *buffer, size_t size, size_t nitems, void *instream)
+{
+	return static_cast<curl_base_chunked_upload*>(instream)->internal_read(buffer, size * nitems);
+}
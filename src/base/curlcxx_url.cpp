@@ -0,0 +1,238 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <charconv>
+#include "curlcxx_url.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_base_url_parts;
+using libcurlcxx::curl_base_url;
+using libcurlcxx::curl_base_exception;
+
+// -----------------------------------------------------------------------
+// curl_base_url_parts: RFC3986に従ってURLを成分ごとに切り分けたもの
+//
+// see also:
+// https://datatracker.ietf.org/doc/html/rfc3986#appendix-B
+//
+
+// urlのpos以降で、最初にstopsのどれかの文字が出てくる位置を返す。なければurlの長さ
+// stopsは数文字しかないのでstring_view::find_first_ofより自前で回す方が速い
+template <char... stops>
+static inline size_t _url_scan_until(std::string_view url, size_t pos) noexcept
+{
+	const size_t n = url.size();
+	while(pos < n){
+		const char c = url[pos];
+		if(((c == stops) || ...)) break;
+		pos++;
+	}
+	return pos;
+}
+
+// urlを成分ごとに切り分ける
+// "^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\?([^#]*))?(#(.*))?"と同じ切り分けを先頭から1回なめるだけで行う
+// url: 切り分けるURL。戻り値のstring_viewはこれを指す
+// ret: 切り分けた結果
+curl_base_url_parts curl_base_url_parts::parse(std::string_view url) noexcept
+{
+	curl_base_url_parts p;
+	const size_t n = url.size();
+	size_t pos = 0;
+
+	// scheme ":"より前に"/?#"が出てきたらschemeはない
+	size_t end = _url_scan_until<':', '/', '?', '#'>(url, 0);
+	if(end > 0 && end < n && url[end] == ':'){
+		p.scheme = url.substr(0, end);
+		p.has_scheme = true;
+		pos = end + 1;
+	}
+
+	// authority
+	if(n - pos >= 2 && url[pos] == '/' && url[pos + 1] == '/'){
+		end = _url_scan_until<'/', '?', '#'>(url, pos + 2);
+		p.authority = url.substr(pos + 2, end - (pos + 2));
+		p.has_authority = true;
+		pos = end;
+
+		// authorityをuserinfo@host:portに分ける
+		std::string_view hostport = p.authority;
+		const size_t at = hostport.rfind('@');
+		if(at != std::string_view::npos){
+			p.userinfo = hostport.substr(0, at);
+			hostport.remove_prefix(at + 1);
+		}
+		size_t colon = std::string_view::npos;
+		if(!hostport.empty() && hostport.front() == '['){
+			// IPv6アドレスは中に":"を含むので"]"の後ろだけを見る
+			const size_t close = hostport.find(']');
+			if(close != std::string_view::npos && close + 1 < hostport.size() && hostport[close + 1] == ':'){
+				colon = close + 1;
+			}
+		}else{
+			colon = hostport.rfind(':');
+		}
+		if(colon != std::string_view::npos){
+			p.host = hostport.substr(0, colon);
+			p.port = hostport.substr(colon + 1);
+		}else{
+			p.host = hostport;
+		}
+	}
+
+	// path
+	end = _url_scan_until<'?', '#'>(url, pos);
+	p.path = url.substr(pos, end - pos);
+	pos = end;
+
+	// query
+	if(pos < n && url[pos] == '?'){
+		end = _url_scan_until<'#'>(url, pos + 1);
+		p.query = url.substr(pos + 1, end - (pos + 1));
+		p.has_query = true;
+		pos = end;
+	}
+
+	// fragment
+	if(pos < n && url[pos] == '#'){
+		p.fragment = url.substr(pos + 1);
+		p.has_fragment = true;
+	}
+	return p;
+}
+
+// pathからディレクトリ部分を抜いたファイル名を返す
+// セパレータがない場合はpathをそのまま返す
+std::string_view curl_base_url_parts::filename() const noexcept
+{
+	const size_t found = path.find_last_of("/\\");
+	if(found != std::string_view::npos){
+		return path.substr(found + 1);
+	}
+	return path;
+}
+
+// portを数値で返す
+// ret: ポート番号。portがない、数値でない、範囲外の場合は-1
+int curl_base_url_parts::port_number() const noexcept
+{
+	int value = -1;
+	const char *last = port.data() + port.size();
+	auto [ptr, ec] = std::from_chars(port.data(), last, value);
+	if(ec != std::errc() || ptr != last || port.empty() || value < 0 || value > 65535) return -1;
+	return value;
+}
+
+// -----------------------------------------------------------------------
+// curl_base_url: libcurlのURL API(CURLU)をC++で実装したもの
+// CURLUハンドルを生で使用せずスマートポインタで包み、可能な限り生ポインタを使わないことによって安全に使用することを念頭においている
+//
+// see also:
+// https://curl.se/libcurl/c/libcurl-url.html
+//
+
+// コンストラクタ
+// 空のURLを作る。set_系で成分を設定していくこと
+curl_base_url::curl_base_url()
+{
+	CURLU *p = curl_url();
+	if(p == nullptr){
+		throw curl_base_exception("handle return null", __FCNAME, __LINE__);
+	}
+	handle.reset(p);
+}
+
+// コンストラクタ
+// url: 設定するURL。正しくないURLの場合は例外を投げる
+// flags: curl_url_setに渡すCURLU_系のフラグ。"example.com"のようにschemeを省くならCURLU_GUESS_SCHEMEなど
+curl_base_url::curl_base_url(std::string_view url, unsigned int flags) : curl_base_url()
+{
+	if(!set(CURLUPART_URL, url, flags)){
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// dupで作ったハンドルを受け取るコンストラクタ
+curl_base_url::curl_base_url(CURLU *_cuh)
+{
+	if(_cuh == nullptr){
+		throw curl_base_exception("handle return null", __FCNAME, __LINE__);
+	}
+	handle.reset(_cuh);
+}
+
+// URLを複製する
+// 共通のベースURLを1つ作っておき、リクエストごとに複製してクエリなどを足す場合に使う
+// 解析済みのハンドルをcurl_url_dupで複製するので、URL文字列から作り直すより速い
+// ret: 複製したURL
+curl_base_url curl_base_url::dup() const
+{
+	return curl_base_url(curl_url_dup(handle.get()));
+}
+
+// 成分を設定する
+// part: 設定する成分
+// value: 設定する値。空文字ならその成分を消す
+// flags: curl_url_setに渡すCURLU_系のフラグ
+// ret: 成功ならtrue。失敗ならfalseを返し、get_errorstr()で原因が取れる
+bool curl_base_url::set(CURLUPart part, std::string_view value, unsigned int flags)
+{
+	// curl_url_setは0終端の文字列しかとらないので、ここで一度コピーする
+	CURLUcode ret;
+	if(value.empty()){
+		ret = curl_url_set(handle.get(), part, nullptr, flags);
+	}else{
+		ret = curl_url_set(handle.get(), part, std::string(value).c_str(), flags);
+	}
+	if(ret != CURLUE_OK){
+		set_error(ret);
+		return false;
+	}
+	return true;
+}
+
+// 成分を取得する
+// part: 取得する成分
+// flags: curl_url_getに渡すCURLU_系のフラグ。デコードして欲しいならCURLU_URLDECODEなど
+// ret: 成分の値。ない場合は空文字
+std::string curl_base_url::get(CURLUPart part, unsigned int flags) const
+{
+	char *value = nullptr;
+	if(curl_url_get(handle.get(), part, &value, flags) != CURLUE_OK) return "";
+
+	std::unique_ptr<char, void(*)(char*)> _value_ptr(value, [](char *ptr)
+	{
+		curl_free(ptr);
+	});
+	return std::string(_value_ptr.get());
+}
+
+// エラーのセット。このクラスの中及び派生クラスでのみ使用
+// curl_code: CURLUcode
+void curl_base_url::set_error(const int curl_code) noexcept
+{
+	error_code = curl_code;
+	error_str = curl_url_strerror((CURLUcode)curl_code);
+}
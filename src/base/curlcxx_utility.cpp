@@ -22,6 +22,11 @@
 //
 
 #include <memory>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "curlcxx_utility.h"
 #include "curlcxx_error.h"
 #include "curlcxx_version.h"
@@ -52,36 +57,218 @@ time_t curl_base_utility::get_date(const std::string_view format)
 	return value;
 }
 
-// curl_easyを使ったURLescape
+// URLエンコードで変換しない文字(RFC3986のunreserved)の表
+// 英数字と"-._~"。curl_easy_escapeと同じ
+static constexpr struct _url_unreserved_table
+{
+	bool	v[256] = {};
+	constexpr _url_unreserved_table()
+	{
+		for(int c = '0'; c <= '9'; c++) v[c] = true;
+		for(int c = 'A'; c <= 'Z'; c++) v[c] = true;
+		for(int c = 'a'; c <= 'z'; c++) v[c] = true;
+		v[static_cast<unsigned char>('-')] = true;
+		v[static_cast<unsigned char>('.')] = true;
+		v[static_cast<unsigned char>('_')] = true;
+		v[static_cast<unsigned char>('~')] = true;
+	}
+} _url_unreserved;
+
+// 1文字をエンコードしてdstに書き込み、書き込んだバイト数を返す
+static inline size_t _url_escape_one(unsigned char c, char *dst, bool form) noexcept
+{
+	static constexpr char hex[] = "0123456789ABCDEF";
+	if(_url_unreserved.v[c]){
+		*dst = static_cast<char>(c);
+		return 1;
+	}
+	if(form && c == ' '){
+		*dst = '+';
+		return 1;
+	}
+	dst[0] = '%';
+	dst[1] = hex[c >> 4];
+	dst[2] = hex[c & 0x0f];
+	return 3;
+}
+
+// 16進数1文字を値にする。16進数でなければ-1
+static inline int _url_hex_value(char c) noexcept
+{
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+#if defined(__SSE2__)
+// 16バイトのうち、unreservedの文字の位置のビットが立ったマスクを返す
+// 0x80以上のバイトはsignedの比較では負になるので、どの範囲にも入らない
+static inline unsigned int _url_unreserved_mask16(__m128i v) noexcept
+{
+	auto in_range = [v](char lo, char hi) {
+		return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))), _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(hi + 1))));
+	};
+	__m128i m = _mm_or_si128(in_range('0', '9'), _mm_or_si128(in_range('A', 'Z'), in_range('a', 'z')));
+	m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('.'))));
+	m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), _mm_cmpeq_epi8(v, _mm_set1_epi8('~'))));
+	return static_cast<unsigned int>(_mm_movemask_epi8(m));
+}
+#endif
+
+// URLエンコードした後の正確なバイト数を返す
+// 複数の文字列を1つのバッファにまとめてエンコードする場合に、先に大きさを決めるために使う
+// src: 変換元
+// form: trueなら空白を"+"にする
+// ret: url_escape_toが書き込むバイト数
+size_t curl_base_utility::url_escaped_length(const std::string_view src, bool form) noexcept
+{
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(src.data());
+	const size_t n = src.size();
+	size_t i = 0;
+	size_t escaped = 0;			// "%XX"になる文字の数
+#if defined(__SSE2__)
+	for(; n - i >= 16; i += 16){
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		unsigned int mask = ~_url_unreserved_mask16(v) & 0xffff;
+		if(form) mask &= ~static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+		escaped += static_cast<size_t>(__builtin_popcount(mask));
+	}
+#endif
+	for(; i < n; i++){
+		if(!_url_unreserved.v[p[i]] && !(form && p[i] == ' ')) escaped++;
+	}
+	return n + escaped * 2;
+}
+
+// URLエンコードしてdstに書き込む
+// 16バイトずつunreservedかどうかを調べ、全部unreservedならそのまま16バイトまとめてコピーする
+// src: 変換元
+// dst: 書き込み先。url_escaped_length(src, form)バイト以上あること
+// form: trueなら空白を"+"にする
+// ret: 書き込んだバイト数
+size_t curl_base_utility::url_escape_to(const std::string_view src, char *dst, bool form) noexcept
+{
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(src.data());
+	const size_t n = src.size();
+	size_t i = 0;
+	size_t o = 0;
+#if defined(__SSE2__)
+	// 1文字は必ず1バイト以上になるので、srcの残りが16バイト以上あればdstも16バイト以上残っている
+	// そのため16バイトそのまま書いてもはみ出さない(正しくない部分はこの後で上書きされる)
+	while(n - i >= 16){
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		const unsigned int mask = _url_unreserved_mask16(v);
+		if(mask == 0xffff){
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + o), v);
+			i += 16;
+			o += 16;
+			continue;
+		}
+		// 先頭から続くunreservedの分だけ進めて、変換が必要な1文字を処理する
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + o), v);
+		const unsigned int run = static_cast<unsigned int>(__builtin_ctz(~mask));
+		i += run;
+		o += run;
+		o += _url_escape_one(p[i], dst + o, form);
+		i++;
+	}
+#endif
+	for(; i < n; i++){
+		o += _url_escape_one(p[i], dst + o, form);
+	}
+	return o;
+}
+
+// URLデコードしてdstに書き込む
+// "%XX"になっていない"%"はそのまま残す。curl_easy_unescapeと同じ
+// 16バイトずつ"%"(formなら"+"も)を探し、なければそのまま16バイトまとめてコピーする
+// src: 変換元
+// dst: 書き込み先。src.size()バイト以上あること
+// form: trueなら"+"を空白に戻す
+// ret: 書き込んだバイト数
+size_t curl_base_utility::url_unescape_to(const std::string_view src, char *dst, bool form) noexcept
+{
+	const char *p = src.data();
+	const size_t n = src.size();
+	size_t i = 0;
+	size_t o = 0;
+	while(i < n){
+#if defined(__SSE2__)
+		// 書き込み位置は読み込み位置より後ろにはならないので、16バイトそのまま書いてもはみ出さない
+		if(n - i >= 16){
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+			__m128i m = _mm_cmpeq_epi8(v, _mm_set1_epi8('%'));
+			if(form) m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+			const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(m));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + o), v);
+			if(mask == 0){
+				i += 16;
+				o += 16;
+				continue;
+			}
+			const unsigned int run = static_cast<unsigned int>(__builtin_ctz(mask));
+			i += run;
+			o += run;
+		}
+#endif
+		const char c = p[i];
+		if(c == '%' && n - i >= 3){
+			const int hi = _url_hex_value(p[i + 1]);
+			const int lo = _url_hex_value(p[i + 2]);
+			if(hi >= 0 && lo >= 0){
+				dst[o++] = static_cast<char>((hi << 4) | lo);
+				i += 3;
+				continue;
+			}
+		}
+		dst[o++] = (form && c == '+') ? ' ' : c;
+		i++;
+	}
+	return o;
+}
+
+// outの最後にURLエンコードした文字を足す
+// out: 足す先の文字列
+// src: 変換元
+// form: trueなら空白を"+"にする
+void curl_base_utility::url_escape_append(std::string &out, const std::string_view src, bool form)
+{
+	const size_t old = out.size();
+	out.resize(old + url_escape_bound(src.size()));
+	out.resize(old + url_escape_to(src, out.data() + old, form));
+}
+
+// outの最後にURLデコードした文字を足す
+// out: 足す先の文字列
+// src: 変換元
+// form: trueなら"+"を空白に戻す
+void curl_base_utility::url_unescape_append(std::string &out, const std::string_view src, bool form)
+{
+	const size_t old = out.size();
+	out.resize(old + src.size());
+	out.resize(old + url_unescape_to(src, out.data() + old, form));
+}
+
+// URLエンコード
+// 以前はcurl_easy_escapeを呼んでいたが、libcurlが確保した文字列をコピーし直すことになるので自前で変換する
 // url: url値
 // ret: 変換結果
 std::string curl_base_utility::url_escape(const std::string_view url)
 {
-	// unique ptr: <class,delfunc>
-	// curl easy escapeを使用。第一引数にnullを指定できる
-	std::unique_ptr<char, void(*)(char*)> _url_ptr(curl_easy_escape(nullptr, url.data(), static_cast<int>(url.length())), [](char *ptr)
-	{
-		curl_free(ptr);
-	});
-
-	if(_url_ptr == nullptr)	return "";
-	return std::string(_url_ptr.get());
+	std::string ret;
+	url_escape_append(ret, url);
+	return ret;
 }
 
-// curl_easyを使ったURL unescape
+// URLデコード
 // url: url値
 // ret: 変換結果
 std::string curl_base_utility::url_unescape(const std::string_view url)
 {
-	// unique ptr: <class,delfunc>
-	// curl easy unescapeを使用。第一引数にnullを指定できる
-	std::unique_ptr<char, void(*)(char*)> _url_ptr(curl_easy_escape(nullptr, url.data(), static_cast<int>(url.length())), [](char *ptr)
-	{
-		curl_free(ptr);
-	});
-
-	if(_url_ptr == nullptr)	return "";
-	return std::string(_url_ptr.get());
+	std::string ret;
+	url_unescape_append(ret, url);
+	return ret;
 }
 
 // 実行されているlibcurlのバージョン番号を得る
@@ -0,0 +1,176 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <algorithm>
+#include <chrono>
+
+#include "curlcxx_async_client.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_async_client;
+using libcurlcxx::curl_http_request;
+using libcurlcxx::curl_base_exception;
+
+// I/Oスレッドがpollで待つ最大時間(ミリ秒)。リクエストの投入はwakeupで知らされるのでこれは保険
+#define CURLCXX_ASYNC_POLL_MS		(1000)
+// ループでエラーが続いたときに待つ時間(ミリ秒)。続くたびに倍にしてCURLCXX_ASYNC_ERROR_WAIT_MAX_MSまで伸ばす
+#define CURLCXX_ASYNC_ERROR_WAIT_MS		(1)
+#define CURLCXX_ASYNC_ERROR_WAIT_MAX_MS	(1000)
+
+// curl_async_client : I/Oスレッドを持つ非同期クライアント
+//
+// 使い方は以下の通り
+//
+// 1. curl_async_clientを作る。この時点でI/Oスレッドが起動する
+// 2. std::make_shared<curl_http_request>()で作ったリクエストにURLなどを設定する
+// 3. async_performに渡す。どのスレッドから呼んでもよい
+//    prePerformはI/Oスレッド側で呼ぶので必要ない
+// 4. 戻り値のstd::futureで結果(CURLcode)を待つか、コールバックで完了を受け取る
+//
+// async_performしたリクエストは完了するまで触らないこと
+//
+
+// コンストラクタ
+curl_async_client::curl_async_client()
+{
+	stopping = false;
+	th = std::thread([this]() { io_main(); });
+}
+
+// デストラクタ
+// 実行中や受付済みのリクエストは中断され、CURLE_ABORTED_BY_CALLBACKで完了する
+curl_async_client::~curl_async_client()
+{
+	stopping = true;
+	multi.wakeup();
+	if(th.joinable()) th.join();
+}
+
+// リクエストを受け付けてI/Oスレッドを起こす
+void curl_async_client::enqueue(async_job &&job)
+{
+	queue.push(std::move(job));
+	// pollで寝ている場合は起こす。寝ていない場合は次のpollがすぐに戻ってくるので取りこぼしはない
+	multi.wakeup();
+}
+
+// リクエストを非同期で実行する。どのスレッドから呼んでもよい
+// req: 実行したいリクエスト。URLなどは設定済みであること
+// return: 転送結果のCURLcodeを受け取るfuture。登録に失敗した場合はfutureから例外が投げられる
+std::future<CURLcode> curl_async_client::async_perform(const std::shared_ptr<curl_http_request> &req)
+{
+	async_job job{req, nullptr, std::promise<CURLcode>(), true};
+	std::future<CURLcode> result = job.promise.get_future();
+	enqueue(std::move(job));
+	return result;
+}
+
+// リクエストを非同期で実行する。どのスレッドから呼んでもよい
+// req: 実行したいリクエスト。URLなどは設定済みであること
+// callback: 完了時にI/Oスレッドから呼ばれるコールバック関数。登録に失敗した場合はCURLE_FAILED_INITで呼ばれる
+void curl_async_client::async_perform(const std::shared_ptr<curl_http_request> &req, callback_type callback)
+{
+	enqueue(async_job{req, std::move(callback), std::promise<CURLcode>(), false});
+}
+
+// リクエストの完了処理
+void curl_async_client::finish_job(async_job &job, CURLcode code)
+{
+	if(job.use_promise){
+		job.promise.set_value(code);
+	}else if(job.callback){
+		// コールバックが例外を投げてもI/Oスレッドのループは止めない
+		try{
+			job.callback(job.req, code);
+		}catch(...){
+		}
+	}
+}
+
+// 受け付けたリクエストをmultiに登録する
+void curl_async_client::start_job(async_job &&job)
+{
+	try{
+		job.req->prePerform();
+		multi.add(job.req);
+	}catch (curl_base_exception &error){
+		if(job.use_promise){
+			job.promise.set_exception(std::current_exception());
+		}else{
+			finish_job(job, CURLE_FAILED_INIT);
+		}
+		return;
+	}
+	CURL *h = job.req->get_chandle();
+	running.emplace(h, std::move(job));
+}
+
+// 転送が終わったものを取り出して完了処理をする
+void curl_async_client::drain_done()
+{
+	int msgs_left = 0;
+	curl_base_multi_message mes;
+	while(multi.get_next_message(mes, msgs_left)){
+		auto it = running.find(mes.get_easy()->get_chandle());
+		if(it == running.end()) continue;
+
+		async_job job = std::move(it->second);
+		running.erase(it);
+		// removeに失敗してもジョブは完了させる。そうしないとfutureやコールバックが帰ってこなくなる
+		multi.try_remove(job.req);
+		finish_job(job, mes.get_code());
+	}
+}
+
+// I/Oスレッド本体
+void curl_async_client::io_main()
+{
+	int error_wait_ms = 0;		// エラーが続いている間の待ち時間。0ならエラーは続いていない
+
+	while(!stopping.load()){
+		try{
+			queue.consume_all([this](async_job &&job) { start_job(std::move(job)); });
+			multi.perform();
+			drain_done();
+			// ソケットの準備ができるか、libcurlのタイムアウトかwakeupまで寝る
+			multi.poll(nullptr, 0, CURLCXX_ASYNC_POLL_MS, nullptr);
+			error_wait_ms = 0;
+		}catch (curl_base_exception &error){
+			// エラーはエラーログに残っているので、ループは止めずに続ける
+			// ただしperformなどが失敗し続けると空回りになるので、続くたびに待つ時間を伸ばす
+			error_wait_ms = (error_wait_ms == 0) ? CURLCXX_ASYNC_ERROR_WAIT_MS : std::min(error_wait_ms * 2, CURLCXX_ASYNC_ERROR_WAIT_MAX_MS);
+			std::this_thread::sleep_for(std::chrono::milliseconds(error_wait_ms));
+			continue;
+		}
+	}
+
+	// 残っているものはすべて中断する
+	for(auto &p : running){
+		multi.try_remove(p.second.req);
+		finish_job(p.second, CURLE_ABORTED_BY_CALLBACK);
+	}
+	running.clear();
+	queue.consume_all([](async_job &&job) { finish_job(job, CURLE_ABORTED_BY_CALLBACK); });
+}
@@ -0,0 +1,126 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <vector>
+
+#include "curlcxx_coro.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_task;
+using libcurlcxx::curl_coro_loop;
+using libcurlcxx::curl_http_awaiter;
+using libcurlcxx::curl_http_request;
+using libcurlcxx::curl_base_easy;
+
+// curl_coro_loop : コルーチンからco_awaitで転送完了を待てるようにしたもの
+//
+// 使い方は以下の通り
+//
+// 1. curl_coro_loopを作る
+// 2. curl_taskを返すコルーチンを書き、その中でco_await req.async_perform(loop)として転送する
+// 3. コルーチンを呼び出す。最初のco_awaitまで実行されて戻ってくる
+// 4. loop.run_tasks()を呼ぶ。転送が終わるたびにそれを待っていたコルーチンが再開され、待っているものがなくなると戻ってくる
+//
+// コルーチンの再開はrun_tasksを呼んだスレッド上で直接行われる。スレッドをまたぐことはない
+// async_performしたリクエストは、完了するまでコルーチン側で生かしておくこと(コルーチンのローカル変数にしておけばよい)
+//
+
+// コルーチンで処理されなかった例外の一時置き場
+// コルーチンを再開したところ(run_tasksの中)で投げ直す
+static thread_local std::exception_ptr _task_exception;
+
+// 溜まっている例外があれば投げ直す
+static void _rethrow_task_exception()
+{
+	if(!_task_exception) return;
+	std::exception_ptr e = _task_exception;
+	_task_exception = nullptr;
+	std::rethrow_exception(e);
+}
+
+// コルーチン内で例外が処理されなかったときに呼ばれる
+void curl_task::promise_type::unhandled_exception() noexcept
+{
+	_task_exception = std::current_exception();
+}
+
+// コンストラクタ
+curl_coro_loop::curl_coro_loop() : curl_base_multi_epoll()
+{
+}
+
+// デストラクタ
+// まだ完了を待っているコルーチンがあれば、転送を中断してコルーチンも破棄する
+curl_coro_loop::~curl_coro_loop() noexcept
+{
+	std::vector<std::coroutine_handle<>> pending;
+	pending.reserve(waiters.size());
+	for(auto &p : waiters){
+		pending.push_back(p.second->waiter);
+	}
+	waiters.clear();
+	// コルーチンを破棄するとリクエストも消えるので、その前にmultiから外しておく
+	clear();
+	for(auto h : pending){
+		h.destroy();
+	}
+}
+
+// 転送を開始して、完了時に再開するコルーチンを登録する。curl_http_awaiterから呼ばれる
+// 失敗したら例外を投げる。その場合はco_awaitしたところに例外が返る
+void curl_coro_loop::start(curl_http_awaiter *awaiter)
+{
+	curl_http_request &req = awaiter->req;
+	req.prePerform();
+	// リクエストはコルーチン側が持っているので、multiには所有権を持たせない
+	// 転送が終わったらハンドラの中でそれを待っていたコルーチンを再開する
+	add(std::shared_ptr<curl_base_easy>(std::shared_ptr<curl_base_easy>(), &req),
+		[this, awaiter](const std::shared_ptr<curl_base_easy> &easy, CURLcode code) {
+			waiters.erase(easy->get_chandle());
+			awaiter->result = code;
+			awaiter->waiter.resume();
+			_rethrow_task_exception();
+		});
+	waiters[req.get_chandle()] = awaiter;
+}
+
+// 完了を待っているコルーチンがなくなるまで転送を進める
+// コルーチン内で処理されなかった例外はここから投げ直される
+// stopされるまで回り続けるcurl_base_multi::runとは別物なので注意
+void curl_coro_loop::run_tasks()
+{
+	_rethrow_task_exception();
+	run_until_idle();
+}
+
+// このリクエストをloopで転送し、co_awaitで完了を待てるようにする
+// co_awaitの結果は転送結果のCURLcodeとなる。HTTPのレスポンスコードはget_responceCode()で見ること
+// 再開はloop.run_tasks()を呼んだスレッドで行われる
+//
+// loop: 転送に使うループ
+curl_http_awaiter curl_http_request::async_perform(curl_coro_loop &loop)
+{
+	return curl_http_awaiter(loop, *this);
+}
@@ -0,0 +1,151 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "curlcxx_http_header.h"
+
+using libcurlcxx::curl_http_response_header;
+
+// ヘッダの1行がこれを超えるものは記録しない(オフセットをuint32_tで持つため)
+#define CURLCXX_HTTP_HEADER_ARENA_MAX		(0x7fffffffU)
+
+// 前後の空白(スペース・タブ・改行)を取り除く
+static std::string_view _trim(std::string_view s) noexcept
+{
+	while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+	while(!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r' || s.back() == '\n')) s.remove_suffix(1);
+	return s;
+}
+
+// ASCIIの英大文字だけを小文字にする
+static inline unsigned char _lower(unsigned char c) noexcept
+{
+	return (c >= 'A' && c <= 'Z') ? (c | 0x20) : c;
+}
+
+// コンストラクタ
+curl_http_response_header::curl_http_response_header()
+	: status_len(0), complete(false)
+{}
+
+// ヘッダ名のハッシュ値を返す。大文字小文字は同じ値になる(FNV-1a)
+uint32_t curl_http_response_header::hash_name(std::string_view name) noexcept
+{
+	uint32_t h = 2166136261U;
+	for(unsigned char c : name){
+		h ^= _lower(c);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+// ヘッダ名を大文字小文字を区別せずに比較する
+bool curl_http_response_header::equal_name(std::string_view a, std::string_view b) noexcept
+{
+	if(a.size() != b.size()) return false;
+	for(size_t i = 0; i < a.size(); i++){
+		if(_lower(a[i]) != _lower(b[i])) return false;
+	}
+	return true;
+}
+
+// 受信したヘッダを1行渡して記録する。CURLOPT_HEADERFUNCTIONで受けたものをそのまま渡せばよい
+// ステータス行(HTTP/...)が来たら新しいレスポンスとみなして、それまでの内容は捨てる
+// 継続行(行頭が空白のもの。RFC 9112で廃止)と、:のない行は無視する
+// buffer: ヘッダ1行。改行を含んでいてもよい
+// size: bufferのバイト数
+void curl_http_response_header::feed(const char *buffer, size_t size)
+{
+	std::string_view line(buffer, size);
+	while(!line.empty() && (line.back() == '\r' || line.back() == '\n')) line.remove_suffix(1);
+
+	// 空行はヘッダの終わり
+	if(line.empty()){
+		complete = true;
+		return;
+	}
+	if(arena.size() + line.size() > CURLCXX_HTTP_HEADER_ARENA_MAX) return;
+
+	// 新しいレスポンスの始まり
+	if(line.starts_with("HTTP/")){
+		clear();
+		arena.append(line);
+		status_len = static_cast<uint32_t>(line.size());
+		return;
+	}
+	if(line.front() == ' ' || line.front() == '\t') return;
+
+	const auto colon = line.find(':');
+	if(colon == std::string_view::npos) return;
+
+	// 生データを一度だけarenaに追記して、名前と値はその中の位置で持つ
+	const size_t base = arena.size();
+	arena.append(line);
+	const std::string_view stored(arena.data() + base, line.size());
+	const std::string_view name = _trim(stored.substr(0, colon));
+	const std::string_view value = _trim(stored.substr(colon + 1));
+
+	entry e;
+	e.hash = hash_name(name);
+	e.name_off = static_cast<uint32_t>(name.data() - arena.data());
+	e.name_len = static_cast<uint32_t>(name.size());
+	e.value_off = static_cast<uint32_t>(value.data() - arena.data());
+	e.value_len = static_cast<uint32_t>(value.size());
+	entries.push_back(e);
+}
+
+// 記録した内容を捨てる。確保済みのバッファはそのまま次に使う
+void curl_http_response_header::clear() noexcept
+{
+	arena.clear();
+	entries.clear();
+	status_len = 0;
+	complete = false;
+}
+
+// 指定した名前のヘッダを探す。同じ名前が複数ある場合は最初のもの
+// name: ヘッダ名。大文字小文字は区別しない
+// value: 見つかった場合はその値が入る
+// return:
+//   true : 見つかった
+//   false : 見つからなかった
+bool curl_http_response_header::find(std::string_view name, std::string_view &value) const noexcept
+{
+	const uint32_t h = hash_name(name);
+	for(const auto &e : entries){
+		if(e.hash == h && equal_name(view(e.name_off, e.name_len), name)){
+			value = view(e.value_off, e.value_len);
+			return true;
+		}
+	}
+	return false;
+}
+
+// 指定した名前のヘッダの値を返す。見つからない場合は空を返す
+// name: ヘッダ名。大文字小文字は区別しない
+std::string_view curl_http_response_header::get(std::string_view name) const noexcept
+{
+	std::string_view value;
+	find(name, value);
+	return value;
+}
@@ -0,0 +1,129 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "curlcxx_http_param.h"
+#include "curlcxx_utility.h"
+
+using libcurlcxx::curl_http_param_list;
+using libcurlcxx::curl_http_request_param;
+using libcurlcxx::curl_base_utility;
+
+// -----------------------------------------------------------------------
+// curl_http_param_list: GETのクエリやPOSTのフォームに使うパラメータを登録順に持つクラス
+//
+
+// コンストラクタ
+// params: {{"name", "value"}, ...}の形で最初に登録するパラメータ
+curl_http_param_list::curl_http_param_list(std::initializer_list<std::pair<std::string_view, std::string_view>> params)
+{
+	size_t bytes = 0;
+	for(const auto &p : params) bytes += p.first.size() + p.second.size();
+	reserve(params.size(), bytes);
+	for(const auto &p : params) add(p.first, p.second);
+}
+
+// コンストラクタ
+// 今までのcurl_http_request_paramから作る。並びはmapの順(名前順)になる
+curl_http_param_list::curl_http_param_list(const curl_http_request_param &params)
+{
+	size_t bytes = 0;
+	for(const auto &p : params) bytes += p.first.size() + p.second.size();
+	reserve(params.size(), bytes);
+	for(const auto &p : params) add(p.first, p.second);
+}
+
+// パラメータを最後に追加する
+// 同じ名前を何度追加してもよい(a=1&a=2のようになる)
+// name: 名前
+// value: 値。コピーして持つので、呼び出し後に元の文字列を破棄してもよい
+void curl_http_param_list::add(std::string_view name, std::string_view value)
+{
+	entry e;
+	e.name_off = static_cast<uint32_t>(arena.size());
+	e.name_len = static_cast<uint32_t>(name.size());
+	arena.append(name);
+	e.value_off = static_cast<uint32_t>(arena.size());
+	e.value_len = static_cast<uint32_t>(value.size());
+	arena.append(value);
+	// "="の分を足しておく
+	e.query_len = static_cast<uint32_t>(curl_base_utility::url_escaped_length(name, false) + 1 + curl_base_utility::url_escaped_length(value, false));
+	e.form_len = static_cast<uint32_t>(curl_base_utility::url_escaped_length(name, true) + 1 + curl_base_utility::url_escaped_length(value, true));
+	entries.push_back(e);
+}
+
+// 先にバッファを確保しておく
+// count: パラメータの数
+// bytes: 名前と値の長さの合計
+void curl_http_param_list::reserve(size_t count, size_t bytes)
+{
+	entries.reserve(count);
+	arena.reserve(bytes);
+}
+
+// すべてのパラメータを消す。バッファの容量はそのまま残す
+void curl_http_param_list::clear() noexcept
+{
+	entries.clear();
+	arena.clear();
+}
+
+// エンコードした後の正確なバイト数を返す
+// form: trueならフォーム形式(空白が"+")、falseならクエリ形式(空白が"%20")
+// ret: encode_toが書き込むバイト数
+size_t curl_http_param_list::encoded_size(bool form) const noexcept
+{
+	if(entries.empty()) return 0;
+	size_t total = entries.size() - 1;		// "&"の分
+	for(const auto &e : entries){
+		total += form ? e.form_len : e.query_len;
+	}
+	return total;
+}
+
+// "name=value&name=value..."の形にエンコードしてdstに書き込む
+// dst: 書き込み先。encoded_size(form)バイト以上あること
+// form: trueならフォーム形式(空白が"+")、falseならクエリ形式(空白が"%20")
+// ret: 書き込んだバイト数
+size_t curl_http_param_list::encode_to(char *dst, bool form) const noexcept
+{
+	size_t o = 0;
+	for(size_t i = 0; i < entries.size(); i++){
+		const entry &e = entries[i];
+		if(i != 0) dst[o++] = '&';
+		o += curl_base_utility::url_escape_to(view(e.name_off, e.name_len), dst + o, form);
+		dst[o++] = '=';
+		o += curl_base_utility::url_escape_to(view(e.value_off, e.value_len), dst + o, form);
+	}
+	return o;
+}
+
+// outの最後にエンコードした文字を足す
+// 足す前に正確な大きさで1回だけ広げる
+// out: 足す先の文字列
+// form: trueならフォーム形式(空白が"+")、falseならクエリ形式(空白が"%20")
+void curl_http_param_list::encode_append(std::string &out, bool form) const
+{
+	const size_t old = out.size();
+	out.resize(old + encoded_size(form));
+	encode_to(out.data() + old, form);
+}
@@ -31,11 +31,14 @@
 
 using libcurlcxx::curl_base_easy;
 using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_easy_result;
+using libcurlcxx::make_easy_result;
 using libcurlcxx::curl_base_mime;
 using libcurlcxx::curl_base_utility;
 
 using libcurlcxx::curl_http_request;
 using libcurlcxx::curl_http_request_param;
+using libcurlcxx::curl_http_param_list;
 
 using std::string;
 using std::ostringstream;
@@ -60,11 +63,18 @@ using std::ostringstream;
 curl_http_request::curl_http_request()
 {
 	proxyport = 0;
+	opts_applied = false;
+	proxy_dirty = false;
+	header_dirty = false;
+	linked_tail = nullptr;
 }
 
 // デストラクタ
 curl_http_request::~curl_http_request()
-{}
+{
+	// http_headerを解放するときに共有のヘッダセットまで解放しないように外しておく
+	unlinkHeaderSet();
+}
 
 // コンストラクタ。通常はこれを使用する
 // streamer: curl_base_stream_objectを派生したオブジェクトのポインタ
@@ -74,6 +84,36 @@ curl_http_request::curl_http_request(const std::shared_ptr<curl_base_stream_obje
 		: curl_base_easy(_streamer)
 {
 	proxyport = 0;
+	opts_applied = false;
+	proxy_dirty = false;
+	header_dirty = false;
+	linked_tail = nullptr;
+}
+
+// コンストラクタ。Easyハンドルをプールから借りる
+// ストリームを後から生成する場合やMultiの際などに使う
+// pool: ハンドルを借りるプール。このオブジェクトが破棄されるとハンドルはプールに返される
+curl_http_request::curl_http_request(const std::shared_ptr<curl_base_easy_pool> &pool)
+		: curl_base_easy(pool)
+{
+	proxyport = 0;
+	opts_applied = false;
+	proxy_dirty = false;
+	header_dirty = false;
+	linked_tail = nullptr;
+}
+
+// コンストラクタ。Easyハンドルをプールから借りる
+// streamer: curl_base_stream_objectを派生したオブジェクトのポインタ
+// pool: ハンドルを借りるプール。このオブジェクトが破棄されるとハンドルはプールに返される
+curl_http_request::curl_http_request(const std::shared_ptr<curl_base_stream_object> &_streamer, const std::shared_ptr<curl_base_easy_pool> &pool)
+		: curl_base_easy(_streamer, pool)
+{
+	proxyport = 0;
+	opts_applied = false;
+	proxy_dirty = false;
+	header_dirty = false;
+	linked_tail = nullptr;
 }
 
 // ムーブコンストラクタ
@@ -81,28 +121,52 @@ curl_http_request::curl_http_request(curl_http_request &&other) noexcept
 {
 	handle = std::move(other.handle);
 	streamer = std::move(other.streamer);
+	uploader = std::move(other.uploader);
 	mime = std::move(other.mime);
+	share = std::move(other.share);
 	url = std::move(other.url);
 	proxyurl = std::move(other.proxyurl);
 	proxyuser = std::move(other.proxyuser);
 	proxypass = std::move(other.proxypass);
 	proxyport = other.proxyport;
 	http_header = std::move(other.http_header);
+	header_set = std::move(other.header_set);
+	linked_tail = other.linked_tail;
+	other.linked_tail = nullptr;
+	response_header = std::move(other.response_header);
+	post_body = std::move(other.post_body);
+	opts_applied = other.opts_applied;
+	proxy_dirty = other.proxy_dirty;
+	header_dirty = other.header_dirty;
+	init_header_callback();		// HEADERDATAを移動先のthisにし直す
 }
 
 // ムーブ代入演算子
 curl_http_request & curl_http_request::operator= (curl_http_request &&other) noexcept
 {
 	if (this != &other) {
+		if(share && handle) clear_option(CURLOPT_SHARE);
 		handle = std::move(other.handle);
 		streamer = std::move(other.streamer);
+		uploader = std::move(other.uploader);
 		mime = std::move(other.mime);
+		share = std::move(other.share);
 		url = std::move(other.url);
 		proxyurl = std::move(other.proxyurl);
 		proxyuser = std::move(other.proxyuser);
 		proxypass = std::move(other.proxypass);
 		proxyport = other.proxyport;
+		unlinkHeaderSet();			// 古いhttp_headerが解放される前に外す
 		http_header = std::move(other.http_header);
+		header_set = std::move(other.header_set);
+		linked_tail = other.linked_tail;
+		other.linked_tail = nullptr;
+		response_header = std::move(other.response_header);
+		post_body = std::move(other.post_body);
+		opts_applied = other.opts_applied;
+		proxy_dirty = other.proxy_dirty;
+		header_dirty = other.header_dirty;
+		init_header_callback();		// HEADERDATAを移動先のthisにし直す
 	}
 	return *this;
 }
@@ -121,26 +185,21 @@ void curl_http_request::setInternalProxy()
 	if(proxyport != 0)			set_option(CURLOPT_PROXYPORT, proxyport);
 	if(!proxyuser.empty())		set_option(CURLOPT_PROXYUSERNAME, proxyuser);
 	if(!proxypass.empty())		set_option(CURLOPT_PROXYPASSWORD, proxypass);
+
+	proxy_dirty = false;
 }
 
-// HTTP用getパラメータでURLとともに設定する文字列をcurl_http_request_paramから構築して文字列型で返す
-std::string curl_http_request::build_get_param(const curl_http_request_param& params)
+// ヘッダを1行受信するたびにlibcurlから呼ばれる
+// レスポンスヘッダに記録してから、基底クラスの処理(Content-Lengthをストリームに伝える)を行う
+size_t curl_http_request::internal_header_callback(char *buffer, size_t realsize)
 {
-    if (params.empty()) return "";
-
-    std::ostringstream oss;
-	// URLエンコードをしながら=&が使われる型に変換する
-    for (auto p = params.begin(); p != params.end(); ++p) {
-        oss << curl_base_utility::url_escape(p->first) << "=" << curl_base_utility::url_escape(p->second);
-        if (std::next(p) != params.end()) {
-            oss << "&";
-        }
-    }
-    return oss.str();
+	response_header.feed(buffer, realsize);
+	return curl_base_easy::internal_header_callback(buffer, realsize);
 }
 
 // HTTP用POSTパラメータでPOSTするときに投げるMIME情報をcurl_http_request_paramから構築し内部的にセットする
 // 注意：前に設定してあったMime情報は削除される
+// multipartで送る必要がないならcurl_http_param_list版のRequestSetupPostの方が送るバイト数が少ない
 bool curl_http_request::build_post_param(const curl_http_request_param& params)
 {
     if (params.empty()) return false;
@@ -161,23 +220,67 @@ bool curl_http_request::build_post_param(const curl_http_request_param& params)
 // data: ヘッダ文字列
 void curl_http_request::appendHeader(std::string_view data)
 {
+	unlinkHeaderSet();
 	http_header.append(data);
+	header_dirty = true;
 }
 
 // appendHeaderでセットしたヘッダ設定をすべてなかったことにする
+// setHeaderSetで設定した共有のヘッダセットはそのまま残る
 void curl_http_request::removeHeader()
 {
+	unlinkHeaderSet();
 	http_header.reset();
+	header_dirty = true;
+}
+
+// 複数のリクエストで共有するヘッダセットを設定する
+// appendHeaderで追加したヘッダはこのセットの前に付く。セットの中身はコピーされない
+// 同じ名前のヘッダがある場合はlibcurlは両方送るので、リクエストごとに変えたいヘッダはセットに入れないこと
+// set: 共有のヘッダセット。nullptrで外す
+void curl_http_request::setHeaderSet(const std::shared_ptr<const curl_base_header_set> &set)
+{
+	unlinkHeaderSet();
+	header_set = set;
+	header_dirty = true;
+}
+
+// http_headerの最後のノードからheader_setへのつなぎを外す
+// http_headerに追加・解放する前に必ず呼ぶこと(curl_slist_append/free_allがheader_setのノードまでたどってしまう)
+void curl_http_request::unlinkHeaderSet() noexcept
+{
+	if(linked_tail == nullptr) return;
+	linked_tail->next = nullptr;
+	linked_tail = nullptr;
 }
 
 
 // Multi：Easyのperform前に呼び出す関数
 // perform前の必要な設定を行う
 // このクラスのperformを呼び出すときには特に必要がないが、multiを使用する場合はmulti.addする前に必要
+// 同じオブジェクトで2回目以降に呼ばれた場合は、変更があった設定だけをセットし直す
 void curl_http_request::prePerform()
 {
 	// ProxYセット
-	setInternalProxy();
+	if(!opts_applied || proxy_dirty){
+		setInternalProxy();
+	}
+	// ヘッダを実際にセット
+	// removeHeaderで消した場合も解放済みのリストを参照しないようにnullptrにしておく
+	// 共有のヘッダセットがある場合は、http_headerの最後のノードの後ろにつないで1つのリストにする
+	if(header_dirty){
+		unlinkHeaderSet();
+		const curl_slist *shared = header_set ? header_set->get_slistptr() : nullptr;
+		if(!http_header.isempty() && shared != nullptr){
+			linked_tail = http_header.get_lastptr();
+			linked_tail->next = const_cast<curl_slist *>(shared);
+		}
+		if(!http_header.isempty())		set_option(CURLOPT_HTTPHEADER, http_header.get_slistptr());
+		else if(shared != nullptr)		set_option(CURLOPT_HTTPHEADER, shared);
+		else							clear_option(CURLOPT_HTTPHEADER);
+		header_dirty = false;
+	}
+	if(opts_applied) return;
 
 	// HTTP 2 over TLS (HTTPS) のみを試し、ダメな場合はHTTP1.1で通信
 	// こうしないと多重化の恩恵が受けられない
@@ -195,10 +298,7 @@ void curl_http_request::prePerform()
 	std::string_view _empty("");
 	set_option(CURLOPT_ACCEPT_ENCODING, _empty.data());
 #endif
-	// ヘッダを実際にセット
-	if(!http_header.isempty()){
-		set_option(CURLOPT_HTTPHEADER, http_header.get_slistptr());
-	}
+	opts_applied = true;
 }
 
 // URLをGetRequestで投げる準備をする
@@ -223,11 +323,27 @@ bool curl_http_request::RequestSetupGet(std::string_view url)
 //   false : 設定失敗 performしてはいけない
 bool curl_http_request::RequestSetupGet(std::string_view url, const curl_http_request_param& params)
 {
-	std::string xurl(url);
-	if(!params.empty()){
-		xurl += '?';
-		xurl += build_get_param(params);
-	}
+	return RequestSetupGet(url, curl_http_param_list(params));
+}
+
+// URLをGetRequestで投げる準備をする(パラメータつき)
+// URLのあとの?は自動で設定される。パラメータは登録順に並ぶ
+// URLの長さは先に正確にわかるので、URL文字列の確保は1回だけで済む
+//
+// URL: Get を投げるURL
+// params: Getを投げる際のパラメータ
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupGet(std::string_view url, const curl_http_param_list& params)
+{
+	if(params.empty()) return RequestSetupGet(url);
+
+	std::string xurl;
+	xurl.reserve(url.size() + 1 + params.encoded_size());
+	xurl += url;
+	xurl += '?';
+	params.encode_append(xurl);
 	return RequestSetupGet(xurl);
 }
 
@@ -260,6 +376,22 @@ bool curl_http_request::RequestSetupPost(std::string_view url, const curl_http_r
 	return build_post_param(params);
 }
 
+// URLをPostRequestで投げる準備をする
+// パラメータをapplication/x-www-form-urlencodedの"a=1&b=2"の形のボディにして送る
+// multipartの区切りやパートごとのヘッダが付かないので、文字列だけのフォームならこちらの方が送るバイト数が少ない
+// ボディは正確な大きさで1回だけ確保し、コピーせずにlibcurlに渡す
+//
+// URL: Post を投げるURL
+// params: Postを投げる際のパラメータ
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupPost(std::string_view url, const curl_http_param_list& params)
+{
+	// Content-Typeはlibcurlのデフォルト(application/x-www-form-urlencoded)になる
+	return RequestSetupPost(url, params.to_form());
+}
+
 // URLをPostRequestで投げる準備をする
 // 一つしか文字列のパラメータしかない場合や、JSONをそのまま投げる場合に使うと楽
 //
@@ -272,7 +404,133 @@ bool curl_http_request::RequestSetupPost(std::string_view url, std::string_view
 {
 	if(!set_url(url)) return false;
 	// 文字列はlibcurl内部へコピーするようにする
-	set_option(CURLOPT_COPYPOSTFIELDS, strdata);
+	// サイズを先に設定しないと、前回のPOSTのサイズやstrlenでコピーされてしまう
+	curl_easy_setopt(handle.get(), CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(strdata.size()));
+	set_option(CURLOPT_COPYPOSTFIELDS, strdata.empty() ? "" : strdata.data());
+	post_body.reset();
+	return true;
+}
+
+// URLをPostRequestで投げる準備をする
+// 文字列リテラルを渡した場合にstd::string&&版と曖昧にならないようにするためのもの。libcurl内部へコピーされる
+bool curl_http_request::RequestSetupPost(std::string_view url, const char *strdata)
+{
+	return RequestSetupPost(url, std::string_view(strdata ? strdata : ""));
+}
+
+// URLをPostRequestで投げる準備をする
+// 文字列をこのクラスが引き取り、コピーせずにそのままlibcurlに渡す。大きなJSONを投げる場合はこちらを使うとよい
+// RequestSetupPost(url, std::move(str)) や RequestSetupPost(url, 文字列を返す関数()) のように使う
+//
+// URL: Post を投げるURL
+// strdata: Postを投げる際のデータ。次にRequestSetupPostするかこのオブジェクトが破棄されるまで保持される
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupPost(std::string_view url, std::string &&strdata)
+{
+	if(!set_url(url)) return false;
+	auto owner = std::make_shared<const std::string>(std::move(strdata));
+	const void *data = owner->data();
+	const size_t size = owner->size();
+	return setInternalPostBody(std::move(owner), data, size);
+}
+
+// URLをPostRequestで投げる準備をする
+// バイト列をこのクラスが引き取り、コピーせずにそのままlibcurlに渡す
+//
+// URL: Post を投げるURL
+// data: Postを投げる際のデータ。次にRequestSetupPostするかこのオブジェクトが破棄されるまで保持される
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupPost(std::string_view url, std::vector<uint8_t> &&data)
+{
+	if(!set_url(url)) return false;
+	auto owner = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+	const void *ptr = owner->data();
+	const size_t size = owner->size();
+	return setInternalPostBody(std::move(owner), ptr, size);
+}
+
+// URLをPostRequestで投げる準備をする
+// 同じデータを何度も(複数のリクエストから)投げる場合に使う。データは共有されコピーされない
+//
+// URL: Post を投げるURL
+// data: Postを投げる際のデータ。中身は転送が終わるまで変更しないこと
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupPost(std::string_view url, const std::shared_ptr<const std::string> &data)
+{
+	if(!data || !set_url(url)) return false;
+	return setInternalPostBody(std::shared_ptr<const void>(data), data->data(), data->size());
+}
+
+// URLをPostRequestで投げる準備をする
+// 同じバイト列を何度も(複数のリクエストから)投げる場合に使う。データは共有されコピーされない
+//
+// URL: Post を投げるURL
+// data: Postを投げる際のデータ。中身は転送が終わるまで変更しないこと
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupPost(std::string_view url, const std::shared_ptr<const std::vector<uint8_t>> &data)
+{
+	if(!data || !set_url(url)) return false;
+	return setInternalPostBody(std::shared_ptr<const void>(data), data->data(), data->size());
+}
+
+// URLをPostRequestで投げる準備をする
+// bodyをuploaderから少しずつ読み出して送る。複数のバッファをつなげずに送る場合や、大きなデータを作りながら送る場合に使う
+// uploaderのサイズが分からない(-1)場合はchunkedで送られる
+//
+// URL: Post を投げるURL
+// uploader: curl_base_upload_objectを派生したオブジェクト。転送が終わるまで保持される
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupPost(std::string_view url, const std::shared_ptr<curl_base_upload_object> &uploader)
+{
+	if(!uploader || !set_url(url)) return false;
+	set_uploader(uploader);
+	set_option(CURLOPT_UPLOAD, 0L);
+	set_option(CURLOPT_POST, 1L);
+	// POSTFIELDSが残っているとそちらが送られるので消す
+	clear_option(CURLOPT_POSTFIELDS);
+	post_body.reset();
+	curl_easy_setopt(handle.get(), CURLOPT_POSTFIELDSIZE_LARGE, uploader->get_size());
+	return true;
+}
+
+// URLをPutRequestで投げる準備をする
+// bodyをuploaderから少しずつ読み出して送る。サイズが分からない(-1)場合はchunkedで送られる
+//
+// URL: Put を投げるURL
+// uploader: curl_base_upload_objectを派生したオブジェクト。転送が終わるまで保持される
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_http_request::RequestSetupPut(std::string_view url, const std::shared_ptr<curl_base_upload_object> &uploader)
+{
+	if(!uploader || !set_url(url)) return false;
+	set_uploader(uploader);
+	set_option(CURLOPT_UPLOAD, 1L);
+	curl_easy_setopt(handle.get(), CURLOPT_INFILESIZE_LARGE, uploader->get_size());
+	return true;
+}
+
+// POSTするデータをコピーせずにlibcurlに渡す。内部用
+// owner: dataの持ち主。転送が終わるまでこのクラスで保持する
+// data, size: 送るデータ
+bool curl_http_request::setInternalPostBody(std::shared_ptr<const void> &&owner, const void *data, size_t size)
+{
+	// 空のvectorはnullptrを返すが、POSTFIELDSにnullptrを渡すとREADFUNCTIONから読もうとするので空文字列にする
+	if(size == 0) data = "";
+	if(curl_easy_setopt(handle.get(), CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(size)) != CURLE_OK) return false;
+	if(set_option(CURLOPT_POSTFIELDS, static_cast<const char *>(data)) != CURLE_OK) return false;
+	// 前のデータはlibcurlが新しいポインタに切り替えてから手放す
+	post_body = std::move(owner);
 	return true;
 }
 
@@ -282,7 +540,18 @@ bool curl_http_request::RequestSetupPost(std::string_view url, std::string_view
 //
 // なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
 void curl_http_request::perform()
+{
+	if (!try_perform()) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// ファイル転送を開始。例外を投げない版
+// 転送の失敗はエラーとして返すだけで例外は投げない
+//
+// return: 結果。失敗ならCURLcodeとメッセージが入る
+curl_easy_result curl_http_request::try_perform()
 {
 	prePerform();
-	curl_base_easy::perform();
+	return curl_base_easy::try_perform();
 }
@@ -0,0 +1,283 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "curlcxx_multi_pool.h"
+#include "curlcxx_error.h"
+#include "curlcxx_url.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_multi_pool;
+using libcurlcxx::curl_http_request;
+using libcurlcxx::curl_base_multi_message;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_base_url_parts;
+
+// 暇なループが盗めるリクエストがないか見に行く間隔(ミリ秒)
+#define CURLCXX_POOL_IDLE_WAIT_MS		(100)
+// ループでエラーが続いたときに待つ時間(ミリ秒)。続くたびに倍にしてCURLCXX_POOL_ERROR_WAIT_MAX_MSまで伸ばす
+#define CURLCXX_POOL_ERROR_WAIT_MS		(1)
+#define CURLCXX_POOL_ERROR_WAIT_MAX_MS	(1000)
+
+// curl_multi_pool : curl_base_multi_epollのループをスレッドごとに持つプール
+//
+// 使い方は以下の通り
+//
+// 1. curl_multi_poolを作る。ループ数を省略した場合はCPUのコア数になる
+// 2. std::make_shared<curl_http_request>()で作ったリクエストにURLなどを設定する
+// 3. submitでリクエストと完了時のコールバックを渡す。submitはどのスレッドから呼んでもよい
+//    prePerformはプール側で呼ぶので必要ない
+// 4. 完了するとリクエストを実行したループのスレッドからコールバックが呼ばれる
+// 5. すべての完了を待ちたい場合はwaitを呼ぶ
+//
+// submitしたリクエストは完了するまで触らないこと
+//
+
+// コンストラクタ
+// nloops: ループ(スレッド)の数。0ならstd::thread::hardware_concurrency()
+// max_transfers_per_loop: 1ループあたりの同時転送数の上限。これを超えたものは順番待ちとなり、暇なループに盗まれることがある
+curl_multi_pool::curl_multi_pool(size_t nloops, size_t max_transfers_per_loop)
+{
+	if(nloops == 0) nloops = std::max(1u, std::thread::hardware_concurrency());
+	max_transfers = std::max<size_t>(1, max_transfers_per_loop);
+	stopping = false;
+	outstanding = 0;
+
+	workers.reserve(nloops);
+	for(size_t i = 0; i < nloops; i++){
+		workers.emplace_back(std::make_unique<pool_worker>());
+	}
+	// 盗みに行く際にworkersを全部見るので、すべて作り終わってからスレッドを起動する
+	for(auto &w : workers){
+		pool_worker *pw = w.get();
+		pw->th = std::thread([this, pw]() { worker_main(*pw); });
+	}
+}
+
+// デストラクタ
+// 実行中や順番待ちのリクエストは中断され、CURLE_ABORTED_BY_CALLBACKでコールバックが呼ばれる
+curl_multi_pool::~curl_multi_pool()
+{
+	stopping = true;
+	for(auto &w : workers){
+		w->multi.wakeup();
+	}
+	for(auto &w : workers){
+		if(w->th.joinable()) w->th.join();
+	}
+}
+
+// リクエストを担当するループを決める
+// 同じホストは必ず同じループになるようにする
+size_t curl_multi_pool::select_worker(const std::shared_ptr<curl_http_request> &req) const
+{
+	// 投入ごとに呼ばれるので、ホスト名を文字列に切り出さずにURLの中を直接ハッシュする
+	const std::string url = req->get_url();
+	const std::string_view host = curl_base_url_parts::parse(url).host;
+	return std::hash<std::string_view>{}(host) % workers.size();
+}
+
+// リクエストをプールに投入する
+// どのスレッドから呼んでもよい
+//
+// req: 実行したいリクエスト。URLなどは設定済みであること
+// callback: 完了時に呼ばれるコールバック関数。不要ならnullptrでよい
+void curl_multi_pool::submit(const std::shared_ptr<curl_http_request> &req, callback_type callback)
+{
+	{
+		std::scoped_lock lk{done_lk};
+		outstanding++;
+	}
+	pool_worker &w = *workers[select_worker(req)];
+	{
+		std::scoped_lock lk{w.lk};
+		w.pending.push_back(pool_job{req, std::move(callback)});
+	}
+	w.multi.wakeup();
+
+	// 担当ループが実行枠を使い切っている場合は暇なループを起こして盗んでもらう
+	if(w.nrunning.load() < max_transfers) return;
+	for(auto &other : workers){
+		if(other.get() != &w && other->idle.load()){
+			other->multi.wakeup();
+			break;
+		}
+	}
+}
+
+// submitしたリクエストがすべて完了するまで待つ
+void curl_multi_pool::wait()
+{
+	std::unique_lock lk{done_lk};
+	done_cv.wait(lk, [this]() { return outstanding == 0; });
+}
+
+// リクエストの完了処理
+void curl_multi_pool::finish_job(pool_job &job, CURLcode code)
+{
+	// コールバックが例外を投げても、waitが帰ってこなくならないよう数は必ず減らす
+	try{
+		if(job.callback) job.callback(job.req, code);
+	}catch(...){
+	}
+	job.req.reset();
+
+	std::scoped_lock lk{done_lk};
+	if(--outstanding == 0) done_cv.notify_all();
+}
+
+// 順番待ちのリクエストを実行枠の分だけmultiに登録する
+void curl_multi_pool::fill_worker(pool_worker &w)
+{
+	std::vector<pool_job> jobs;
+	{
+		std::scoped_lock lk{w.lk};
+		while(w.running.size() + jobs.size() < max_transfers && !w.pending.empty()){
+			jobs.emplace_back(std::move(w.pending.front()));
+			w.pending.pop_front();
+		}
+	}
+	for(auto &job : jobs){
+		try{
+			job.req->prePerform();
+			w.multi.add(job.req);
+		}catch (curl_base_exception &error){
+			// 登録できなかったものはここで完了扱いにする
+			finish_job(job, CURLE_FAILED_INIT);
+			continue;
+		}
+		CURL *h = job.req->get_chandle();
+		w.running.emplace(h, std::move(job));
+	}
+	w.nrunning = w.running.size();
+}
+
+// 一番順番待ちの多いループからリクエストを盗む
+// return: true=何か盗めた false=盗めるものがなかった
+bool curl_multi_pool::steal_work(pool_worker &w)
+{
+	pool_worker *victim = nullptr;
+	size_t most = 0;
+	for(auto &other : workers){
+		if(other.get() == &w) continue;
+		std::scoped_lock lk{other->lk};
+		if(other->pending.size() > most){
+			most = other->pending.size();
+			victim = other.get();
+		}
+	}
+	if(victim == nullptr) return false;
+
+	// 後ろから半分(ただし実行枠まで)を盗む。先頭は持ち主がすぐ使うので触らない
+	std::vector<pool_job> jobs;
+	{
+		std::scoped_lock lk{victim->lk};
+		size_t count = std::min(max_transfers, (victim->pending.size() + 1) / 2);
+		while(count-- > 0 && !victim->pending.empty()){
+			jobs.emplace_back(std::move(victim->pending.back()));
+			victim->pending.pop_back();
+		}
+	}
+	if(jobs.empty()) return false;
+	{
+		std::scoped_lock lk{w.lk};
+		for(auto &job : jobs){
+			w.pending.push_back(std::move(job));
+		}
+	}
+	fill_worker(w);
+	return true;
+}
+
+// 転送が終わったものを取り出して完了処理をする
+void curl_multi_pool::drain_worker(pool_worker &w)
+{
+	int msgs_left = 0;
+	curl_base_multi_message mes;
+	while(w.multi.get_next_message(mes, msgs_left)){
+		auto it = w.running.find(mes.get_easy()->get_chandle());
+		if(it == w.running.end()) continue;
+
+		pool_job job = std::move(it->second);
+		w.running.erase(it);
+		// removeに失敗してもジョブは完了させる。そうしないとfutureやwaitが帰ってこなくなる
+		w.multi.try_remove(job.req);
+		finish_job(job, mes.get_code());
+	}
+	w.nrunning = w.running.size();
+}
+
+// 破棄時に実行中と順番待ちのリクエストをすべて中断する
+void curl_multi_pool::abort_worker(pool_worker &w)
+{
+	for(auto &p : w.running){
+		w.multi.try_remove(p.second.req);
+		finish_job(p.second, CURLE_ABORTED_BY_CALLBACK);
+	}
+	w.running.clear();
+	w.nrunning = 0;
+
+	std::deque<pool_job> jobs;
+	{
+		std::scoped_lock lk{w.lk};
+		jobs.swap(w.pending);
+	}
+	for(auto &job : jobs){
+		finish_job(job, CURLE_ABORTED_BY_CALLBACK);
+	}
+}
+
+// ループ本体。スレッドごとに1つ動く
+void curl_multi_pool::worker_main(pool_worker &w)
+{
+	int error_wait_ms = 0;		// エラーが続いている間の待ち時間。0ならエラーは続いていない
+
+	while(!stopping.load()){
+		try{
+			fill_worker(w);
+			if(w.running.empty() && !steal_work(w)){
+				// 何もすることがないので、submitされるかwakeupされるまで寝る
+				w.idle = true;
+				w.multi.run_once(CURLCXX_POOL_IDLE_WAIT_MS);
+				w.idle = false;
+				error_wait_ms = 0;
+				continue;
+			}
+			w.multi.run_once(-1);
+			drain_worker(w);
+			error_wait_ms = 0;
+		}catch (curl_base_exception &error){
+			// エラーはエラーログに残っているので、ループは止めずに続ける
+			// ただしepoll_waitなどが失敗し続けると空回りになるので、続くたびに待つ時間を伸ばす
+			w.idle = false;
+			error_wait_ms = (error_wait_ms == 0) ? CURLCXX_POOL_ERROR_WAIT_MS : std::min(error_wait_ms * 2, CURLCXX_POOL_ERROR_WAIT_MAX_MS);
+			std::this_thread::sleep_for(std::chrono::milliseconds(error_wait_ms));
+			continue;
+		}
+	}
+	abort_worker(w);
+}
@@ -0,0 +1,446 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <charconv>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "curlcxx_resumable_download.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_resumable_download;
+using libcurlcxx::curl_base_stream_object;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_http_request;
+using libcurlcxx::writef::_check_callback_arg;
+
+// チェックポイントファイルの1行目
+static constexpr std::string_view _checkpoint_magic("libcurlcxx-checkpoint 1");
+// FNV-1a 64bitの初期値
+static constexpr uint64_t _fnv_offset = 14695981039346656037ULL;
+
+// Content-Range: bytes <start>-<end>/<total> を読む。totalが"*"(不明)の場合は0にする
+// return: false = 形式が違う
+static bool _parse_content_range(std::string_view value, size_t &start, size_t &total)
+{
+	constexpr std::string_view unit("bytes ");
+	if(!value.starts_with(unit)) return false;
+	const char *p = value.data() + unit.size();
+	const char *last = value.data() + value.size();
+	size_t end = 0;
+
+	auto r = std::from_chars(p, last, start);
+	if(r.ec != std::errc() || r.ptr == last || *r.ptr != '-') return false;
+	r = std::from_chars(r.ptr + 1, last, end);
+	if(r.ec != std::errc() || r.ptr == last || *r.ptr != '/' || end < start) return false;
+	p = r.ptr + 1;
+	if(last - p == 1 && *p == '*'){
+		total = 0;
+		return true;
+	}
+	r = std::from_chars(p, last, total);
+	return r.ec == std::errc() && r.ptr == last && end < total;
+}
+
+// 受信したデータを保存先ファイルの続きの位置にpwriteするストリーム
+// 最初のデータが来たときにレスポンスコードを見て、200なら最初から書き直す
+class curl_resumable_download::resume_stream : public curl_base_stream_object
+{
+private:
+	curl_resumable_download		&owner;
+
+	size_t internal_write(char *buffer, size_t realsize)
+	{
+		if(!checked && !begin()) return 0;
+
+		checkpoint &ck = owner.ck;
+		size_t left = realsize;
+		const char *p = buffer;
+		while(left != 0){
+			ssize_t ret = pwrite(owner.fd, p, left, static_cast<off_t>(ck.done));
+			if(ret < 0){
+				if(errno == EINTR) continue;
+				io_error = true;
+				return 0;
+			}
+			if(owner.use_hash) ck.hash = hash_update(ck.hash, p, static_cast<size_t>(ret));
+			ck.done += static_cast<size_t>(ret);
+			owner.unsaved += static_cast<size_t>(ret);
+			p += ret;
+			left -= static_cast<size_t>(ret);
+		}
+		if(owner.unsaved >= owner.checkpoint_bytes || std::chrono::steady_clock::now() - owner.last_saved >= owner.checkpoint_interval){
+			owner.save_checkpoint();
+		}
+		if(owner.progress) owner.progress(ck.done, ck.total);
+		return realsize;
+	}
+	static size_t _callback_func(char *buffer, size_t size, size_t nitems, void *outstream)
+	{
+		auto realsize = _check_callback_arg(buffer, size, nitems);
+		if(realsize == 0) return 0;
+		return static_cast<resume_stream*>(outstream)->internal_write(buffer, realsize);
+	}
+
+public:
+	curl_http_request	*req;				// このストリームを使っているリクエスト
+	bool				checked;			// レスポンスコードを確認したか
+	bool				io_error;			// 書き込みに失敗したか
+	bool				bad_response;		// 200と206以外が返ってきたか
+
+	explicit resume_stream(curl_resumable_download &_owner)
+		: owner(_owner), req(nullptr), checked(false), io_error(false), bad_response(false)
+	{
+		set_write_callback(_callback_func);
+	}
+	virtual ~resume_stream(){}
+
+	// bodyの受信を始める前にレスポンスを確認する
+	// 206なら続きから、200ならサーバのファイルが変わったか続きを返せないので最初から書き直す
+	// return: false = 書いてはいけないレスポンスだった
+	bool begin()
+	{
+		checked = true;
+		checkpoint &ck = owner.ck;
+		const long code = req->get_responceCode();
+		size_t range_start = 0;
+		size_t range_total = 0;
+		if(code == 206){
+			// 頼んだ位置から返ってきたかをContent-Rangeで確かめる。違う位置からのものを続きに書くとファイルが壊れる
+			const bool parsed = _parse_content_range(req->get_HeaderValue("Content-Range"), range_start, range_total);
+			if(!parsed || (range_start != ck.done && range_start != 0)){
+				// 使えないので途中までの分を捨て、この転送は中断する。次はRangeなしで最初から取る
+				restart_from_zero();
+				return false;
+			}
+			if(range_start != ck.done){
+				// 最初から返ってきたので、200と同じく最初から書き直す
+				if(!restart_from_zero()) return false;
+			}
+		}else if(code == 200){
+			if(!restart_from_zero()) return false;
+		}else{
+			bad_response = true;
+			return false;
+		}
+		// 次に続きから取るときのために、今回のレスポンスのETagかLast-Modifiedを覚えておく(弱いETagはIf-Rangeに使えない)
+		const std::string_view etag = req->get_HeaderValue("ETag");
+		if(!etag.empty() && !etag.starts_with("W/"))	ck.validator = etag;
+		else											ck.validator = req->get_HeaderValue("Last-Modified");
+
+		if(code == 206){
+			ck.total = range_total;
+		}else{
+			const curl_off_t length = req->get_ContentLength();
+			ck.total = (length > 0) ? static_cast<size_t>(length) : 0;
+		}
+		ck.has_hash = owner.use_hash;
+		return true;
+	}
+
+	// 途中までの分を捨てて、最初から書き直せるようにする
+	bool restart_from_zero()
+	{
+		checkpoint &ck = owner.ck;
+		ck.done = 0;
+		ck.total = 0;
+		ck.hash = _fnv_offset;
+		owner.resumed_from = 0;
+		if(ftruncate(owner.fd, 0) != 0){
+			io_error = true;
+			return false;
+		}
+		return true;
+	}
+};
+
+// -----------------------------------------------------------------------
+// curl_resumable_download : 途中で切れても続きからダウンロードし直せるダウンロード
+
+// コンストラクタ
+curl_resumable_download::curl_resumable_download()
+	: checkpoint_bytes(16 * 1024 * 1024), checkpoint_interval(2000), use_hash(false),
+	  max_retries(3), retry_wait(1000), fd(-1), resumed_from(0), unsaved(0)
+{
+	ck.total = 0;
+	ck.done = 0;
+	ck.hash = _fnv_offset;
+	ck.has_hash = false;
+}
+
+// デストラクタ
+curl_resumable_download::~curl_resumable_download()
+{
+	close_file();
+}
+
+// FNV-1a 64bitのハッシュ値を更新する
+uint64_t curl_resumable_download::hash_update(uint64_t h, const char *buffer, size_t size) noexcept
+{
+	for(size_t i = 0; i < size; i++){
+		h ^= static_cast<unsigned char>(buffer[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// 保存先ファイルを閉じる
+void curl_resumable_download::close_file() noexcept
+{
+	if(fd < 0) return;
+	::close(fd);
+	fd = -1;
+}
+
+// チェックポイントファイルを読む
+// url: これからダウンロードするURL。チェックポイントのURLと違う場合は使わない
+// return:
+//   true : 読めた。ckに内容が入る
+//   false : ない、壊れている、URLが違う
+bool curl_resumable_download::load_checkpoint(std::string_view url)
+{
+	std::ifstream ifs(ckpt_path);
+	if(!ifs.is_open()) return false;
+
+	std::string line;
+	if(!std::getline(ifs, line) || line != _checkpoint_magic) return false;
+
+	checkpoint tmp;
+	tmp.total = 0;
+	tmp.done = 0;
+	tmp.hash = _fnv_offset;
+	tmp.has_hash = false;
+	// key value の形。valueは行末まで(Last-Modifiedは空白を含むので)
+	while(std::getline(ifs, line)){
+		const auto sp = line.find(' ');
+		if(sp == std::string::npos) continue;
+		const std::string_view key(line.data(), sp);
+		const std::string value = line.substr(sp + 1);
+		if(key == "url")				tmp.url = value;
+		else if(key == "validator")		tmp.validator = value;
+		else if(key == "total")			tmp.total = std::strtoull(value.c_str(), nullptr, 10);
+		else if(key == "done")			tmp.done = std::strtoull(value.c_str(), nullptr, 10);
+		else if(key == "hash"){
+			tmp.hash = std::strtoull(value.c_str(), nullptr, 16);
+			tmp.has_hash = true;
+		}
+	}
+	if(tmp.url != url) return false;
+	ck = std::move(tmp);
+	return true;
+}
+
+// チェックポイントファイルを書く
+// 先にfdatasyncしてから書くので、チェックポイントにある範囲は必ずディスクに書かれている
+// 書きかけで落ちても壊れないよう、一時ファイルに書いてからrenameする
+bool curl_resumable_download::save_checkpoint()
+{
+	unsaved = 0;
+	last_saved = std::chrono::steady_clock::now();
+	if(fd < 0 || fdatasync(fd) != 0) return false;
+
+	const std::string tmppath = ckpt_path + ".tmp";
+	{
+		std::ofstream ofs(tmppath, std::ios::out | std::ios::trunc);
+		if(!ofs.is_open()) return false;
+		ofs << _checkpoint_magic << "\n";
+		ofs << "url " << ck.url << "\n";
+		ofs << "validator " << ck.validator << "\n";
+		ofs << "total " << ck.total << "\n";
+		ofs << "done " << ck.done << "\n";
+		if(ck.has_hash){
+			char hex[17];
+			std::snprintf(hex, sizeof(hex), "%016" PRIx64, ck.hash);
+			ofs << "hash " << hex << "\n";
+		}
+		ofs.flush();
+		if(ofs.fail()) return false;
+	}
+	return std::rename(tmppath.c_str(), ckpt_path.c_str()) == 0;
+}
+
+// 保存先ファイルの[0, done)を読み直して、チェックポイントのハッシュ値と一致するか調べる
+bool curl_resumable_download::verify_partial()
+{
+	if(!ck.has_hash) return false;
+	std::vector<char> buf(1024 * 1024);
+	uint64_t h = _fnv_offset;
+	size_t pos = 0;
+	while(pos < ck.done){
+		const size_t n = std::min(buf.size(), ck.done - pos);
+		ssize_t ret = pread(fd, buf.data(), n, static_cast<off_t>(pos));
+		if(ret < 0 && errno == EINTR) continue;
+		if(ret <= 0) return false;
+		h = hash_update(h, buf.data(), static_cast<size_t>(ret));
+		pos += static_cast<size_t>(ret);
+	}
+	return h == ck.hash;
+}
+
+// 1回分の転送。続きがあればRangeとIf-Rangeを付ける
+// return:
+//   true : 最後まで受信した
+//   false : 途中で切れた(取り直せる)
+// 取り直しても意味がないエラーは例外を投げる
+bool curl_resumable_download::attempt()
+{
+	if(ck.done > 0 && ck.validator.empty()){
+		// ETagもLast-Modifiedもないので、続きが同じファイルのものか確かめられない。途中までの分は捨てて最初から取り直す
+		ck.total = 0;
+		ck.done = 0;
+		ck.hash = _fnv_offset;
+		resumed_from = 0;
+		if(ftruncate(fd, 0) != 0){
+			throw curl_base_exception("can not truncate " + path + ": " + std::strerror(errno), __FCNAME, __LINE__);
+		}
+	}
+
+	auto st = std::make_shared<resume_stream>(*this);
+	curl_http_request req(st);
+	st->req = &req;
+	for(const auto &h : headers) req.appendHeader(h);
+	req.RequestSetupGet(ck.url);
+	if(ck.done > 0){
+		// CURLOPT_RESUME_FROM_LARGEだとIf-Rangeが外れて200が返ってきたときにlibcurlがエラーにしてしまうので、CURLOPT_RANGEを使う
+		const std::string range = std::to_string(ck.done) + "-";
+		curl_easy_setopt(req.get_chandle(), CURLOPT_RANGE, range.c_str());
+		req.appendHeader("If-Range: " + ck.validator);
+	}
+
+	bool transfer_ok = true;
+	try{
+		req.perform();
+	}catch(curl_base_exception &){
+		transfer_ok = false;
+	}
+	const long code = req.get_responceCode();
+
+	if(st->io_error){
+		save_checkpoint();
+		throw curl_base_exception("file write error " + path, __FCNAME, __LINE__);
+	}
+	// 前回最後まで受信してチェックポイントを消す前に終わっていた場合
+	if(code == 416 && ck.total != 0 && ck.done == ck.total) return true;
+	if(st->bad_response || (transfer_ok && code != 200 && code != 206)){
+		// まだ何も受信していなければ、空のファイルを残さない
+		if(ck.done == 0){
+			std::remove(path.c_str());
+			std::remove(ckpt_path.c_str());
+		}else{
+			save_checkpoint();
+		}
+		throw curl_base_exception("http code error " + std::to_string(code), __FCNAME, __LINE__);
+	}
+	// bodyが空の200
+	if(transfer_ok && !st->checked){
+		if(code == 206) return true;
+		ck.done = 0;
+		ck.total = 0;
+		ck.hash = _fnv_offset;
+		return true;
+	}
+	if(!transfer_ok || (ck.total != 0 && ck.done != ck.total)){
+		save_checkpoint();
+		return false;
+	}
+	return true;
+}
+
+// 指定したURLをダウンロードして_pathに保存する
+// _path + ".ckpt"に前回のチェックポイントがあれば続きから取る
+// 転送が終わるまで帰ってこない。ブロッキングする
+// url: ダウンロードするURL
+// _path: 保存先のファイル
+//
+// なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
+// 取り直しても最後まで受信できなかった場合も例外を投げるが、チェックポイントは残るので後でもう一度呼べば続きから取れる
+void curl_resumable_download::download(std::string_view url, std::string_view _path)
+{
+	close_file();
+	path = _path;
+	ckpt_path = path + ".ckpt";
+	resumed_from = 0;
+
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0){
+		throw curl_base_exception("can not open " + path + ": " + std::strerror(errno), __FCNAME, __LINE__);
+	}
+
+	// チェックポイントが使えるか。検証できない途中のファイルは捨てる
+	bool resume = load_checkpoint(url) && ck.done > 0 && !ck.validator.empty();
+	if(resume){
+		struct stat sb;
+		resume = (fstat(fd, &sb) == 0 && static_cast<size_t>(sb.st_size) >= ck.done);
+	}
+	if(resume && use_hash) resume = verify_partial();
+	if(resume){
+		resumed_from = ck.done;
+	}else{
+		ck.url = url;
+		ck.validator.clear();
+		ck.total = 0;
+		ck.done = 0;
+		ck.hash = _fnv_offset;
+		ck.has_hash = use_hash;
+		if(ftruncate(fd, 0) != 0){
+			close_file();
+			throw curl_base_exception("can not truncate " + path + ": " + std::strerror(errno), __FCNAME, __LINE__);
+		}
+	}
+	unsaved = 0;
+	last_saved = std::chrono::steady_clock::now();
+
+	for(int i = 0; ; i++){
+		bool done;
+		try{
+			done = attempt();
+		}catch(...){
+			close_file();
+			throw;
+		}
+		if(done) break;
+		if(i >= max_retries){
+			close_file();
+			throw curl_base_exception("download interrupted at " + std::to_string(ck.done) + " bytes. call download again to resume", __FCNAME, __LINE__);
+		}
+		std::this_thread::sleep_for(retry_wait);
+	}
+
+	// 前のファイルの方が長かった場合に備えて、受信したサイズに切り詰める
+	const bool ok = (ftruncate(fd, static_cast<off_t>(ck.done)) == 0);
+	close_file();
+	std::remove(ckpt_path.c_str());
+	if(!ok){
+		throw curl_base_exception("can not truncate " + path + ": " + std::strerror(errno), __FCNAME, __LINE__);
+	}
+}
@@ -0,0 +1,389 @@
+// The MIT License (MIT)
+//
+// Copyright (c) <2023> chromabox <chromarockjp@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "curlcxx_segmented_download.h"
+#include "curlcxx_file_stream.h"
+#include "curlcxx_error.h"
+
+#include "classfname.h"
+
+using libcurlcxx::curl_segmented_download;
+using libcurlcxx::curl_base_easy;
+using libcurlcxx::curl_base_stream_object;
+using libcurlcxx::curl_base_stringstream;
+using libcurlcxx::curl_base_mmap_filestream;
+using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_http_request;
+using libcurlcxx::writef::_check_callback_arg;
+
+// 転送中のループでpollが待つ最大時間(ミリ秒)
+#define CURLCXX_SEGMENT_POLL_MS			(200)
+// 区間ごとのスループットを測って区間数を調整する間隔(秒)
+#define CURLCXX_SEGMENT_ADAPT_SEC		(0.5)
+// 全体のスループットがこの割合以上伸びていれば区間を増やす
+#define CURLCXX_SEGMENT_GROW_RATIO		(1.1)
+
+// 区間1つ分の受信データを、出力ファイルのその区間の位置にpwriteするストリーム
+// 区間が分割されて終わりが縮んだ場合は、終わりに達したところで0を返して転送を打ち切る
+class curl_segmented_download::segment_stream : public curl_base_stream_object
+{
+private:
+	segment		*seg;			// 書き込む区間
+	int			fd;				// 出力ファイル
+	size_t		&downloaded;	// 全体のダウンロード済みバイト数
+	bool		checked;		// レスポンスコードを確認したか
+
+	size_t internal_write(char *buffer, size_t realsize)
+	{
+		// 206以外(Rangeを無視した200やエラーページ)をファイルに書いてはいけない
+		if(!checked){
+			checked = true;
+			if(seg->req->get_responceCode() != 206){
+				seg->bad_response = true;
+				return 0;
+			}
+		}
+		const size_t n = std::min(realsize, seg->end > seg->pos ? seg->end - seg->pos : 0);
+		size_t left = n;
+		while(left != 0){
+			ssize_t ret = pwrite(fd, buffer, left, static_cast<off_t>(seg->pos));
+			if(ret < 0){
+				if(errno == EINTR) continue;
+				seg->io_error = true;
+				return 0;
+			}
+			seg->pos += static_cast<size_t>(ret);
+			seg->tick_bytes += static_cast<size_t>(ret);
+			downloaded += static_cast<size_t>(ret);
+			buffer += ret;
+			left -= static_cast<size_t>(ret);
+		}
+		// 区間の終わりに達したのでこれ以上はいらない
+		if(n < realsize) return 0;
+		return realsize;
+	}
+	static size_t _callback_func(char *buffer, size_t size, size_t nitems, void *outstream)
+	{
+		auto realsize = _check_callback_arg(buffer, size, nitems);
+		if(realsize == 0) return 0;
+		return static_cast<segment_stream*>(outstream)->internal_write(buffer, realsize);
+	}
+
+public:
+	segment_stream(segment *_seg, int _fd, size_t &_downloaded)
+		: seg(_seg), fd(_fd), downloaded(_downloaded), checked(false)
+	{
+		set_write_callback(_callback_func);
+	}
+	virtual ~segment_stream(){}
+};
+
+// -----------------------------------------------------------------------
+// curl_segmented_download : 1つのファイルを複数のRangeリクエストで並列にダウンロードする
+
+// コンストラクタ
+// _max_segments: 同時に転送する区間の最大数
+// _initial_segments: 最初に分ける区間の数。あとはスループットを見ながらmax_segmentsまで増やす
+// _min_segment_size: これより小さい区間には分けない
+curl_segmented_download::curl_segmented_download(size_t _max_segments, size_t _initial_segments, size_t _min_segment_size)
+	: max_segments(std::max<size_t>(_max_segments, 1)),
+	  initial_segments(std::clamp<size_t>(_initial_segments, 1, std::max<size_t>(_max_segments, 1))),
+	  min_segment_size(std::max<size_t>(_min_segment_size, 1)), max_retries(3),
+	  fd(-1), total(0), downloaded(0), active(0), target(0), peak(0), last_rate(0)
+{}
+
+// デストラクタ
+curl_segmented_download::~curl_segmented_download()
+{
+	// 区間はストリームから参照されているので、先に転送をすべて外しておく
+	multi.clear();
+	if(fd >= 0) ::close(fd);
+}
+
+// HEADでサイズとRange対応を調べる
+// return:
+//   true : Rangeで分けてダウンロードできる
+//   false : 1本でダウンロードする
+bool curl_segmented_download::probe(std::string_view _url)
+{
+	curl_http_request req(std::make_shared<curl_base_stringstream>());
+	for(const auto &h : headers) req.appendHeader(h);
+	req.RequestSetupGet(_url);
+	req.set_option(CURLOPT_NOBODY, 1L);
+	req.perform();
+
+	// リダイレクトされた場合は、各区間でリダイレクトし直さないように最終的なURLを使う
+	std::string effective;
+	req.get_info(CURLINFO_EFFECTIVE_URL, effective);
+	url = effective.empty() ? std::string(_url) : effective;
+
+	if(req.get_responceCode() != 200) return false;
+	const curl_off_t length = req.get_ContentLength();
+	if(length <= 0) return false;
+	total = static_cast<size_t>(length);
+	if(req.get_HeaderValue("Accept-Ranges").find("bytes") == std::string_view::npos) return false;
+
+	// 途中でファイルが変わったら206ではなく200が返ってくるようにする(弱いETagはIf-Rangeに使えない)
+	std::string_view etag = req.get_HeaderValue("ETag");
+	if(!etag.empty() && !etag.starts_with("W/"))	if_range = etag;
+	else											if_range = req.get_HeaderValue("Last-Modified");
+	return true;
+}
+
+// 指定したURLをダウンロードしてpathに保存する
+// 転送が終わるまで帰ってこない。ブロッキングする
+// _url: ダウンロードするURL
+// path: 保存先のファイル。既にある場合は上書きする
+//
+// なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
+void curl_segmented_download::download(std::string_view _url, std::string_view path)
+{
+	segments.clear();
+	if_range.clear();
+	error.clear();
+	total = 0;
+	downloaded = 0;
+	active = 0;
+	peak = 0;
+	last_rate = 0;
+
+	if(probe(_url))	download_ranged(path);
+	else			download_single(path);
+}
+
+// Range非対応やサイズ不明の場合。1本のリクエストで直接ファイルに書く
+void curl_segmented_download::download_single(std::string_view path)
+{
+	auto fstream = std::make_shared<curl_base_mmap_filestream>(path);
+	curl_http_request req(fstream);
+	for(const auto &h : headers) req.appendHeader(h);
+	req.RequestSetupGet(url);
+	peak = 1;
+	req.perform();
+
+	const long code = req.get_responceCode();
+	const bool closed = fstream->close();
+	if(code < 200 || code >= 300){
+		// エラーページをファイルとして残さない
+		::unlink(fstream->get_path().c_str());
+		throw curl_base_exception("http code error " + std::to_string(code), __FCNAME, __LINE__);
+	}
+	if(!closed){
+		throw curl_base_exception("file write error " + fstream->get_path(), __FCNAME, __LINE__);
+	}
+	total = downloaded = fstream->size();
+}
+
+// Rangeリクエストに分けてダウンロードする
+void curl_segmented_download::download_ranged(std::string_view path)
+{
+	const std::string spath(path);
+	fd = ::open(spath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd < 0){
+		throw curl_base_exception("can not open " + spath + ": " + std::strerror(errno), __FCNAME, __LINE__);
+	}
+	// 先に全体を確保しておく。対応していない場合はftruncateで伸ばすだけ
+	if(posix_fallocate(fd, 0, static_cast<off_t>(total)) != 0 && ftruncate(fd, static_cast<off_t>(total)) != 0){
+		const std::string mess = "can not allocate " + spath + ": " + std::strerror(errno);
+		::close(fd);
+		fd = -1;
+		throw curl_base_exception(mess, __FCNAME, __LINE__);
+	}
+
+	try{
+		// 最初は均等に分ける
+		const size_t n = std::clamp<size_t>(total / min_segment_size, 1, initial_segments);
+		const size_t step = total / n;
+		for(size_t i = 0; i < n; i++){
+			auto seg = std::make_unique<segment>();
+			seg->pos = i * step;
+			seg->end = (i + 1 == n) ? total : (i + 1) * step;
+			segments.push_back(std::move(seg));
+		}
+		target = n;
+		for(auto &seg : segments) start_segment(seg.get());
+
+		auto last = std::chrono::steady_clock::now();
+		while(active > 0 && error.empty()){
+			long curl_timeout = -1;
+			int wait_ms = CURLCXX_SEGMENT_POLL_MS;
+			multi.timeout(&curl_timeout);
+			if(curl_timeout >= 0 && curl_timeout < wait_ms) wait_ms = static_cast<int>(curl_timeout);
+			if(wait_ms > 0) multi.poll(nullptr, 0, wait_ms, nullptr);
+			multi.perform();
+			multi.dispatch_done();
+
+			const auto now = std::chrono::steady_clock::now();
+			const double dt = std::chrono::duration<double>(now - last).count();
+			if(dt >= CURLCXX_SEGMENT_ADAPT_SEC && error.empty()){
+				adapt(dt);
+				last = now;
+			}
+		}
+	}catch(...){
+		multi.clear();
+		::close(fd);
+		fd = -1;
+		throw;
+	}
+	multi.clear();
+	const bool closed = (::close(fd) == 0);
+	fd = -1;
+
+	if(!error.empty()){
+		throw curl_base_exception(error, __FCNAME, __LINE__);
+	}
+	if(!closed || downloaded != total){
+		throw curl_base_exception("file write error " + spath, __FCNAME, __LINE__);
+	}
+	if(progress) progress(downloaded, total, 0);
+}
+
+// 区間の[pos, end)をRangeリクエストで取りにいく
+void curl_segmented_download::start_segment(segment *seg)
+{
+	auto req = std::make_shared<curl_http_request>(std::make_shared<segment_stream>(seg, fd, downloaded));
+	for(const auto &h : headers) req->appendHeader(h);
+	if(!if_range.empty()) req->appendHeader("If-Range: " + if_range);
+	req->RequestSetupGet(url);
+	const std::string range = std::to_string(seg->pos) + "-" + std::to_string(seg->end - 1);
+	req->set_option(CURLOPT_RANGE, range);
+	req->prePerform();
+
+	seg->start = seg->pos;
+	seg->req = req;
+	seg->tick_bytes = 0;
+	seg->io_error = false;
+	seg->bad_response = false;
+	active++;
+	peak = std::max(peak, active);
+	multi.add(req, [this, seg](const std::shared_ptr<curl_base_easy> &, CURLcode code) {
+		on_segment_done(seg, code);
+	});
+}
+
+// 区間の転送が終わったときに呼ばれる
+// 最後まで取れていれば空いた分だけ他の区間を分けて始め、途中で切れていれば続きから取り直す
+void curl_segmented_download::on_segment_done(segment *seg, CURLcode code)
+{
+	active--;
+	seg->req.reset();
+	if(!error.empty()) return;
+
+	if(seg->io_error){
+		fail("file write error");
+		return;
+	}
+	if(seg->bad_response){
+		fail("server did not return 206 Partial Content");
+		return;
+	}
+	if(seg->pos >= seg->end){
+		// 分割されて途中で打ち切った場合もここに来る
+		while(active < target && split_slowest()){}
+		return;
+	}
+	// 途中で切れたので続きから
+	// 何かデータを受信できていれば、回数は数えない
+	if(seg->pos == seg->start && ++seg->retries > max_retries){
+		fail(std::string("segment download failed: ") + curl_easy_strerror(code));
+		return;
+	}
+	start_segment(seg);
+}
+
+// 転送中の区間のうち、残り時間が一番長いものを半分に分けて、後ろ半分を新しい区間として始める
+// return:
+//   true : 分けた
+//   false : 分けられる区間がなかった(どれもmin_segment_sizeの2倍より小さい)
+bool curl_segmented_download::split_slowest()
+{
+	// 始まったばかりでまだ速度が測れていない区間は、測れている区間の平均の速さとみなす
+	double sum = 0;
+	size_t count = 0;
+	for(auto &seg : segments){
+		if(seg->req && seg->rate > 0){
+			sum += seg->rate;
+			count++;
+		}
+	}
+	const double avg = (count != 0) ? sum / count : 1.0;
+
+	segment *best = nullptr;
+	double best_eta = -1;
+	for(auto &seg : segments){
+		if(!seg->req || seg->end <= seg->pos) continue;
+		const size_t remaining = seg->end - seg->pos;
+		if(remaining < min_segment_size * 2) continue;
+		const double eta = static_cast<double>(remaining) / (seg->rate > 0 ? seg->rate : avg);
+		if(eta > best_eta){
+			best_eta = eta;
+			best = seg.get();
+		}
+	}
+	if(best == nullptr) return false;
+
+	auto seg = std::make_unique<segment>();
+	seg->pos = best->pos + (best->end - best->pos) / 2;
+	seg->end = best->end;
+	best->end = seg->pos;		// 元の区間はここで打ち切られる
+	segment *p = seg.get();
+	segments.push_back(std::move(seg));
+	start_segment(p);
+	return true;
+}
+
+// 区間ごとの受信速度を更新し、全体の受信速度が伸びていれば同時転送数を増やす
+// dt: 前回からの経過秒数
+void curl_segmented_download::adapt(double dt)
+{
+	double rate = 0;
+	for(auto &seg : segments){
+		const double r = static_cast<double>(seg->tick_bytes) / dt;
+		seg->tick_bytes = 0;
+		if(!seg->req) continue;
+		seg->rate = (seg->rate == 0) ? r : (seg->rate + r) / 2;
+		rate += r;
+	}
+	// 前回増やしたときより十分速くなっていれば、まだ回線に余裕があるとみなしてもう1本増やす
+	if(target < max_segments && rate > last_rate * CURLCXX_SEGMENT_GROW_RATIO){
+		last_rate = rate;
+		target++;
+	}
+	while(active < target && split_slowest()){}
+
+	if(progress) progress(downloaded, total, active);
+}
+
+// 失敗を記録する。ループはこれを見て残りの転送を打ち切る
+void curl_segmented_download::fail(std::string_view mess)
+{
+	if(error.empty()) error = mess;
+}
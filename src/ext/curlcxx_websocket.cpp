@@ -21,6 +21,8 @@
 // THE SOFTWARE.
 //
 
+#include <cerrno>
+#include <poll.h>
 
 #include "curlcxx_websocket.h"
 #include "curlcxx_mime.h"
@@ -31,11 +33,14 @@
 
 using libcurlcxx::curl_base_easy;
 using libcurlcxx::curl_base_exception;
+using libcurlcxx::curl_easy_result;
+using libcurlcxx::make_easy_result;
 using libcurlcxx::curl_base_mime;
 using libcurlcxx::curl_base_utility;
 
 using libcurlcxx::curl_websocket;
 using libcurlcxx::curl_http_request_param;
+using libcurlcxx::curl_http_param_list;
 
 using std::string;
 using std::ostringstream;
@@ -52,6 +57,7 @@ using std::ostringstream;
 // 3. performで接続の実行。接続が成功or失敗したらひとまず帰ってくる
 // 4. 結果のHTTPコードをget_responceCode()で受け取る
 // 5. is_recvedで受信データがあるか確認。場合によっては5でループするようにすればいい
+//    ループする場合はwait_recvedを使うと、データが来るまでソケットを待って寝るのでCPUを使わない
 // 6. 結果をrecv_binaryなどで受け取る
 //
 // このクラスはHttpReqクラスとは異なっていて、performを呼び出して接続を開始した場合はPerformからすぐに帰ってくる
@@ -79,7 +85,7 @@ curl_websocket::~curl_websocket() noexcept
 // コンストラクタ。通常はこれを使用する
 // url: 対象URLを指定。URLはws:// または wss:// で始めること
 curl_websocket::curl_websocket(std::string_view url)
-		: curl_base_easy()
+		: curl_websocket()
 {
 	RequestSetupGet(url);
 }
@@ -88,7 +94,7 @@ curl_websocket::curl_websocket(std::string_view url)
 // url: 対象URLを指定。URLはws:// または wss:// で始めること
 // params: 設定したいGetパラメータがある場合は指定する
 curl_websocket::curl_websocket(std::string_view url, const curl_http_request_param& params)
-		: curl_base_easy()
+		: curl_websocket()
 {
 	RequestSetupGet(url, params);
 }
@@ -99,25 +105,32 @@ curl_websocket::curl_websocket(curl_websocket &&other) noexcept
 {
 	handle = std::move(other.handle);
 	streamer = std::move(other.streamer);
+	uploader = std::move(other.uploader);
 	mime = std::move(other.mime);
+	share = std::move(other.share);
 	url = std::move(other.url);
 	http_header = std::move(other.http_header);
 	isconnected = std::move(other.isconnected);
 	sendrecv_debug = std::move(other.sendrecv_debug);
 	internal_rbufsize = std::move(other.internal_rbufsize);
+	init_header_callback();		// HEADERDATAを移動先のthisにし直す
 }
 
 curl_websocket& curl_websocket::operator= (curl_websocket &&other) noexcept
 {
 	if (this != &other) {
+		if(share && handle) clear_option(CURLOPT_SHARE);
 		handle = std::move(other.handle);
 		streamer = std::move(other.streamer);
+		uploader = std::move(other.uploader);
 		mime = std::move(other.mime);
+		share = std::move(other.share);
 		url = std::move(other.url);
 		http_header = std::move(other.http_header);
 		isconnected = std::move(other.isconnected);
 		sendrecv_debug = std::move(other.sendrecv_debug);
 		internal_rbufsize = std::move(other.internal_rbufsize);
+		init_header_callback();		// HEADERDATAを移動先のthisにし直す
 	}
 	return *this;
 }
@@ -132,22 +145,6 @@ void curl_websocket::close()
 	curl_ws_send(handle.get(), "", 0, &sent, 0, CURLWS_CLOSE);
 }
 
-// HTTP用getパラメータでURLとともに設定する文字列をcurl_http_request_paramから構築して文字列型で返す
-std::string curl_websocket::build_get_param(const curl_http_request_param& params)
-{
-    if (params.empty()) return "";
-
-    std::ostringstream oss;
-	// URLエンコードをしながら=&が使われる型に変換する
-    for (auto p = params.begin(); p != params.end(); ++p) {
-        oss << curl_base_utility::url_escape(p->first) << "=" << curl_base_utility::url_escape(p->second);
-        if (std::next(p) != params.end()) {
-            oss << "&";
-        }
-    }
-    return oss.str();
-}
-
 // Performする際のHttpヘッダを設定する
 // ヘッダの設定はprePerformかperformが呼び出される前に終わらせておくこと
 // data: ヘッダ文字列
@@ -185,11 +182,26 @@ bool curl_websocket::RequestSetupGet(std::string_view url)
 //   false : 設定失敗 performしてはいけない
 bool curl_websocket::RequestSetupGet(std::string_view url, const curl_http_request_param& params)
 {
-	std::string xurl(url);
-	if(!params.empty()){
-		xurl += '?';
-		xurl += build_get_param(params);
-	}
+	return RequestSetupGet(url, curl_http_param_list(params));
+}
+
+// URLをGetRequestで投げる準備をする(パラメータつき)
+// URLのあとの?は自動で設定される。パラメータは登録順に並ぶ
+//
+// url: 対象URLを指定。URLはws:// または wss:// で始めること
+// params: Getを投げる際のパラメータ
+// return:
+//   true : 設定成功 performしても良い
+//   false : 設定失敗 performしてはいけない
+bool curl_websocket::RequestSetupGet(std::string_view url, const curl_http_param_list& params)
+{
+	if(params.empty()) return RequestSetupGet(url);
+
+	std::string xurl;
+	xurl.reserve(url.size() + 1 + params.encoded_size());
+	xurl += url;
+	xurl += '?';
+	params.encode_append(xurl);
 	return RequestSetupGet(xurl);
 }
 
@@ -231,6 +243,18 @@ void curl_websocket::prePerform()
 //
 // なにかエラーがでたら例外を投げるのでtry-catchで囲むこと
 void curl_websocket::perform()
+{
+	if (!try_perform()) {
+		throw curl_base_exception(this, __FCNAME, __LINE__);
+	}
+}
+
+// 接続の開始。例外を投げない版
+// 接続できなかった場合はエラーとして返すだけで例外は投げない。再接続を繰り返す場合はこちらを使うとよい
+//
+// return: 結果。失敗ならCURLcodeとメッセージが入る
+//         サーバがWebSocketに切り替えなかった(101以外が返ってきた)場合はCURLE_UNSUPPORTED_PROTOCOL
+curl_easy_result curl_websocket::try_perform()
 {
 	// すでに接続が成立していた場合は閉じる
 	if(isConnection()){
@@ -238,20 +262,20 @@ void curl_websocket::perform()
 	}
 
 	prePerform();
-	// 投げる
 	const CURLcode code = curl_easy_perform(handle.get());
 	if (code != CURLE_OK) {
 		set_error(code);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
+		return make_easy_result(code);
 	}
 	// HTTPコードを取得。101 Switching ProtocolsならWebsocketに切り替わったのでOK
 	long httpcode = 0;
 	get_info(CURLINFO_RESPONSE_CODE, httpcode);
 	if(httpcode != 101){
 		set_error(CURLE_UNSUPPORTED_PROTOCOL);
-		throw curl_base_exception(this, __FCNAME, __LINE__);
+		return make_easy_result(CURLE_UNSUPPORTED_PROTOCOL);
 	}
 	isconnected = true;
+	return curl_easy_result();
 }
 
 
@@ -300,81 +324,178 @@ CURLcode curl_websocket::recv_meta(bool &istext, curl_off_t &byteleft)
 	return res;
 }
 
-// データをバイナリとみなして、std::vector<uint8_t>で受け取る
-// TEXTかBINARYかどうかの判定は一切行っていないため、それが知りたい場合は前もってrecv_metaを実行すること
-// rvecはこの中ではクリアしないので、続け様に受け取ることも可能
-bool curl_websocket::recv_binary(std::vector<uint8_t> &rvec)
+// 接続しているソケットが読み込み可能になるまで待つ
+// ソケットはCURLINFO_ACTIVESOCKETで取得し、pollで待つ
+//
+// deadline: 待つ期限。nullptrなら読み込み可能になるまで待つ
+// return:
+// CURLE_OK: 読み込み可能になった(切断やエラーの場合も含む。curl_ws_recvで確認すること)
+// CURLE_OPERATION_TIMEDOUT: 期限までに読み込み可能にならなかった
+// その他: ソケットが取得できないなどのエラー
+CURLcode curl_websocket::wait_readable(const std::chrono::steady_clock::time_point *deadline)
+{
+	curl_socket_t sock = CURL_SOCKET_BAD;
+	const CURLcode res = curl_easy_getinfo(handle.get(), CURLINFO_ACTIVESOCKET, &sock);
+	if(res != CURLE_OK) return res;
+	if(sock == CURL_SOCKET_BAD) return CURLE_GOT_NOTHING;
+
+	while(1){
+		int wait_ms = -1;
+		if(deadline != nullptr){
+			const auto left = std::chrono::ceil<std::chrono::milliseconds>(*deadline - std::chrono::steady_clock::now());
+			if(left.count() <= 0) return CURLE_OPERATION_TIMEDOUT;
+			wait_ms = static_cast<int>(left.count());
+		}
+		struct pollfd pfd = {};
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+		const int n = ::poll(&pfd, 1, wait_ms);
+		if(n > 0) return CURLE_OK;
+		if(n == 0) return CURLE_OPERATION_TIMEDOUT;
+		if(errno != EINTR) return CURLE_RECV_ERROR;
+	}
+}
+
+// 1つのフレームを最後まで受信する
+// curl_ws_recvがCURLE_AGAINを返したらソケットが読み込み可能になるまで寝て待つ。空回りはしない
+//
+// append: 受信したデータを渡す関数。void(const char *data, size_t size)の形
+// timeout_ms: 最大の待ち時間(ミリ秒)。-1ならフレームを最後まで受信するまで待つ
+// return: 結果。時間切れならCURLE_OPERATION_TIMEDOUT
+template<typename F>
+curl_easy_result curl_websocket::recv_frame(F &&append, int timeout_ms)
 {
-	std::vector<uint8_t> buffer(internal_rbufsize);
+	std::vector<char> buffer(internal_rbufsize);
+	std::chrono::steady_clock::time_point deadline;
+	if(timeout_ms >= 0) deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
 
 	while(1){
 		const struct curl_ws_frame *meta;
 		size_t recved;
 
 		CURLcode cres = recv_raw(buffer, recved, &meta);
-		// AGAIN時はブレークせずもう一度
-		if(cres == CURLE_AGAIN) continue;
+		if(cres == CURLE_AGAIN){
+			// まだ届いていないので、ソケットにデータが来るまで待ってからもう一度
+			cres = wait_readable(timeout_ms >= 0 ? &deadline : nullptr);
+			if(cres != CURLE_OK){
+				if(cres != CURLE_OPERATION_TIMEDOUT) set_error(cres);
+				return make_easy_result(cres);
+			}
+			continue;
+		}
 
 		// Appendを実行
 		if(recved > 0){
-			const auto oldsize = rvec.size();
-			rvec.resize(oldsize + recved);
-			std::copy_n(buffer.data(), recved, std::next(rvec.begin(), oldsize));
+			append(buffer.data(), recved);
 		}
 
 		if(cres != CURLE_OK){
 			// エラー
-			return false;
+			set_error(cres);
+			return make_easy_result(cres);
 		}
 		// 次に続く受信がなければ完了
 		if(meta->bytesleft == 0){
 			break;
 		}
 	}
-	return true;
+	return curl_easy_result();
+}
+
+// データをバイナリとみなして、std::vector<uint8_t>で受け取る
+// TEXTかBINARYかどうかの判定は一切行っていないため、それが知りたい場合は前もってrecv_metaを実行すること
+// rvecはこの中ではクリアしないので、続け様に受け取ることも可能
+// フレームを最後まで受信するまで帰ってこない。データを待っている間はCPUを使わない
+bool curl_websocket::recv_binary(std::vector<uint8_t> &rvec)
+{
+	return recv_binary(rvec, -1).has_value();
+}
+
+// データをバイナリとみなして、std::vector<uint8_t>で受け取る。タイムアウト付き
+// rvecはこの中ではクリアしない
+// 時間切れの場合はそれまでに受信した分がrvecに入っている。もう一度呼べば続きから受信する
+//
+// timeout_ms: 最大の待ち時間(ミリ秒)。-1ならフレームを最後まで受信するまで待つ
+// return: 結果。時間切れならCURLE_OPERATION_TIMEDOUT
+curl_easy_result curl_websocket::recv_binary(std::vector<uint8_t> &rvec, int timeout_ms)
+{
+	return recv_frame([&rvec](const char *data, size_t size) {
+		const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+		rvec.insert(rvec.end(), p, p + size);
+	}, timeout_ms);
 }
 
 // データをテキストとみなして、std::stringstreamで受け取る
 // TEXTかBINARYかどうかの判定は一切行っていないため、それが知りたい場合は前もってrecv_metaを実行すること
+// フレームを最後まで受信するまで帰ってこない。データを待っている間はCPUを使わない
 bool curl_websocket::recv_text(std::stringstream &rtextstr)
 {
-	std::vector<char> buffer(internal_rbufsize);
+	return recv_text(rtextstr, -1).has_value();
+}
 
-	while(1){
-		const struct curl_ws_frame *meta;
-		size_t recved;
+// データをテキストとみなして、std::stringstreamで受け取る。タイムアウト付き
+// 時間切れの場合はそれまでに受信した分がrtextstrに入っている。もう一度呼べば続きから受信する
+//
+// timeout_ms: 最大の待ち時間(ミリ秒)。-1ならフレームを最後まで受信するまで待つ
+// return: 結果。時間切れならCURLE_OPERATION_TIMEDOUT
+curl_easy_result curl_websocket::recv_text(std::stringstream &rtextstr, int timeout_ms)
+{
+	return recv_frame([&rtextstr](const char *data, size_t size) {
+		rtextstr.write(data, static_cast<std::streamsize>(size));
+	}, timeout_ms);
+}
 
-		CURLcode cres = recv_raw(buffer, recved, &meta);
-		// AGAIN時はブレークせずもう一度
-		if(cres == CURLE_AGAIN) continue;
+// データをテキストとみなして、std::stringで受け取る。タイムアウト付き
+// rtextはこの中ではクリアしない。時間切れの場合はそれまでに受信した分が入っている。もう一度呼べば続きから受信する
+//
+// timeout_ms: 最大の待ち時間(ミリ秒)。-1ならフレームを最後まで受信するまで待つ
+// return: 結果。時間切れならCURLE_OPERATION_TIMEDOUT
+curl_easy_result curl_websocket::recv_text(std::string &rtext, int timeout_ms)
+{
+	return recv_frame([&rtext](const char *data, size_t size) {
+		rtext.append(data, size);
+	}, timeout_ms);
+}
 
-		// Appendを実行
-		if(recved > 0){
-			rtextstr.write(buffer.data(), recved);
-		}
+// 何か受信するまで待つ
+// is_recvedと同じだが、何も受信していなければソケットにデータが来るまで最大timeout_msだけ寝て待つ
+// 受信待ちのループでis_recvedの代わりに使えば、何も来ていない間はCPUを使わない
+//
+// istext: 受信したデータにテキストフラグが立っているかどうか
+// iserr: エラー、もしくは切断が発生した場合はtrue
+// timeout_ms: 最大の待ち時間(ミリ秒)。-1なら何か受信するまで待つ
+//
+// return:
+//    true = 何かデータを受け取った。recv_xxxで受取可能
+//    false = 時間切れかエラー。エラーはiserrを見ること。iserrがfalseな場合は時間切れ
+bool curl_websocket::wait_recved(bool &istext, bool &iserr, int timeout_ms)
+{
+	std::chrono::steady_clock::time_point deadline;
+	if(timeout_ms >= 0) deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
 
-		if(cres != CURLE_OK){
-			// エラー
+	while(1){
+		if(is_recved(istext, iserr)) return true;
+		if(iserr) return false;
+
+		const CURLcode res = wait_readable(timeout_ms >= 0 ? &deadline : nullptr);
+		if(res == CURLE_OPERATION_TIMEDOUT) return false;
+		if(res != CURLE_OK){
+			set_error(res);
+			iserr = true;
 			return false;
 		}
-		// 次に続く受信がなければ完了
-		if(meta->bytesleft == 0){
-			break;
-		}
 	}
-	return true;
 }
 
 // データをテキストとみなして、std::stringで受け取る
 // TEXTかBINARYかどうかの判定は一切行っていないため、それが知りたい場合は前もってrecv_metaを実行すること
 bool curl_websocket::recv_text(std::string &rtext)
 {
-	std::stringstream strm;
-
 	rtext.clear();
-	if(!recv_text(strm)) return false;
-	rtext = strm.str();
-
+	if(!recv_text(rtext, -1)){
+		rtext.clear();
+		return false;
+	}
 	return true;
 }
 